@@ -0,0 +1,674 @@
+#include <string.h>
+#include "allocator.h"
+
+// smallest buddy node, every block is ALLOCATOR_MIN_SIZE << maxOrder bytes
+#define ALLOCATOR_MIN_SIZE 256
+#define ALLOCATOR_BLOCK_SIZE (64ull * 1024 * 1024)
+// without VK_EXT_memory_budget, leave this much of each heap to the rest of the system
+#define ALLOCATOR_FALLBACK_BUDGET 0.8
+
+typedef struct MemoryBlock {
+    VkDeviceMemory memory;
+    VkDeviceSize size;
+    uint32_t maxOrder;
+    // buddy tree in heap order, each node holds order+1 of the largest free node
+    // beneath it (itself included), 0 when nothing below is free
+    uint8_t *longest;
+    void *mapped;
+    VkDeviceSize used;
+    VkDeviceSize requested;
+    Allocation **allocations;
+    uint32_t allocationCount;
+    uint32_t allocationCapacity;
+} MemoryBlock;
+
+typedef struct MemoryPool {
+    MemoryBlock **blocks;
+    uint32_t blockCount;
+    uint32_t blockCapacity;
+} MemoryPool;
+
+bool memoryBudgetEnabled = false;
+
+static VkPhysicalDeviceMemoryProperties memProperties;
+static VkDeviceSize blockSizes[VK_MAX_MEMORY_HEAPS];
+static MemoryPool pools[VK_MAX_MEMORY_TYPES][ALLOCATION_KIND_COUNT];
+static VkDeviceSize heapAllocated[VK_MAX_MEMORY_HEAPS];
+static uint32_t deviceMemoryCount;
+static uint32_t maxDeviceMemoryCount;
+static uint32_t dedicatedCount;
+static VkDeviceSize dedicatedBytes;
+
+static uint32_t order_for(VkDeviceSize size) {
+    uint32_t order = 0;
+    while (((VkDeviceSize) ALLOCATOR_MIN_SIZE << order) < size) {
+        order++;
+    }
+    return order;
+}
+
+static void heap_budget(uint32_t heap, VkDeviceSize *budget, VkDeviceSize *usage) {
+    if (memoryBudgetEnabled) {
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT
+        };
+        VkPhysicalDeviceMemoryProperties2 properties2 = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2,
+            .pNext = &budgetProperties
+        };
+        vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &properties2);
+        *budget = budgetProperties.heapBudget[heap];
+        *usage = budgetProperties.heapUsage[heap];
+    } else {
+        *budget = (VkDeviceSize) (memProperties.memoryHeaps[heap].size * ALLOCATOR_FALLBACK_BUDGET);
+        *usage = heapAllocated[heap];
+    }
+}
+
+static VkResult allocate_device_memory(uint32_t memoryType, VkDeviceSize size, const void *pNext, VkDeviceMemory *memory) {
+    uint32_t heap = memProperties.memoryTypes[memoryType].heapIndex;
+    VkDeviceSize budget, usage;
+    heap_budget(heap, &budget, &usage);
+    if (usage + size > budget) {
+        return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+    }
+    if (deviceMemoryCount >= maxDeviceMemoryCount) {
+        return VK_ERROR_TOO_MANY_OBJECTS;
+    }
+
+    VkMemoryAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .pNext = pNext,
+        .allocationSize = size,
+        .memoryTypeIndex = memoryType
+    };
+    VkResult result = vkAllocateMemory(device, &allocInfo, NULL, memory);
+    if (result == VK_SUCCESS) {
+        heapAllocated[heap] += size;
+        deviceMemoryCount++;
+    }
+    return result;
+}
+
+static void free_device_memory(uint32_t memoryType, VkDeviceSize size, VkDeviceMemory memory) {
+    vkFreeMemory(device, memory, NULL);
+    heapAllocated[memProperties.memoryTypes[memoryType].heapIndex] -= size;
+    deviceMemoryCount--;
+}
+
+static bool host_visible(uint32_t memoryType) {
+    return (memProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+}
+
+static void block_update(MemoryBlock *block, uint32_t node, uint32_t nodeOrder) {
+    uint8_t left = block->longest[2 * node + 1];
+    uint8_t right = block->longest[2 * node + 2];
+    // both children entirely free (order nodeOrder - 1, stored as nodeOrder) merge back into this node
+    if (left == nodeOrder && right == nodeOrder) {
+        block->longest[node] = (uint8_t) (nodeOrder + 1);
+    } else {
+        block->longest[node] = left > right ? left : right;
+    }
+}
+
+static bool block_alloc(MemoryBlock *block, uint32_t order, VkDeviceSize *offset) {
+    if (order > block->maxOrder || block->longest[0] < order + 1) {
+        return false;
+    }
+
+    uint32_t node = 0;
+    uint32_t nodeOrder = block->maxOrder;
+    while (nodeOrder != order) {
+        uint32_t left = 2 * node + 1;
+        uint32_t right = left + 1;
+        uint8_t l = block->longest[left];
+        uint8_t r = block->longest[right];
+        // best fit, descend into the child whose largest free run is the smaller one that still fits
+        if (l >= order + 1 && (r < order + 1 || l <= r)) {
+            node = left;
+        } else {
+            node = right;
+        }
+        nodeOrder--;
+    }
+
+    block->longest[node] = 0;
+    uint32_t depth = block->maxOrder - order;
+    *offset = ((VkDeviceSize) (node + 1 - (1u << depth)) * ALLOCATOR_MIN_SIZE) << order;
+
+    while (node != 0) {
+        node = (node - 1) / 2;
+        nodeOrder++;
+        block_update(block, node, nodeOrder);
+    }
+    return true;
+}
+
+static void block_free(MemoryBlock *block, VkDeviceSize offset, uint32_t order) {
+    uint32_t depth = block->maxOrder - order;
+    uint32_t node = (1u << depth) - 1 + (uint32_t) ((offset / ALLOCATOR_MIN_SIZE) >> order);
+    uint32_t nodeOrder = order;
+    block->longest[node] = (uint8_t) (order + 1);
+
+    while (node != 0) {
+        node = (node - 1) / 2;
+        nodeOrder++;
+        block_update(block, node, nodeOrder);
+    }
+}
+
+static void block_track(MemoryBlock *block, Allocation *allocation) {
+    if (block->allocationCount == block->allocationCapacity) {
+        block->allocationCapacity = block->allocationCapacity ? block->allocationCapacity * 2 : 16;
+        block->allocations = realloc(block->allocations, sizeof(Allocation *) * block->allocationCapacity);
+    }
+    block->allocations[block->allocationCount++] = allocation;
+    block->used += (VkDeviceSize) ALLOCATOR_MIN_SIZE << allocation->order;
+    block->requested += allocation->size;
+}
+
+static void block_untrack(MemoryBlock *block, Allocation *allocation) {
+    for (uint32_t i = 0; i < block->allocationCount; i++) {
+        if (block->allocations[i] == allocation) {
+            block->allocations[i] = block->allocations[--block->allocationCount];
+            break;
+        }
+    }
+    block->used -= (VkDeviceSize) ALLOCATOR_MIN_SIZE << allocation->order;
+    block->requested -= allocation->size;
+}
+
+static MemoryBlock *block_create(uint32_t memoryType) {
+    VkDeviceSize size = blockSizes[memProperties.memoryTypes[memoryType].heapIndex];
+    VkDeviceMemory memory;
+    if (allocate_device_memory(memoryType, size, NULL, &memory) != VK_SUCCESS) {
+        return NULL;
+    }
+
+    MemoryBlock *block = calloc(1, sizeof(MemoryBlock));
+    block->memory = memory;
+    block->size = size;
+    block->maxOrder = order_for(size);
+
+    uint32_t nodeCount = (2u << block->maxOrder) - 1;
+    block->longest = malloc(nodeCount);
+    for (uint32_t depth = 0; depth <= block->maxOrder; depth++) {
+        memset(&block->longest[(1u << depth) - 1], (int) (block->maxOrder - depth + 1), 1u << depth);
+    }
+
+    if (host_visible(memoryType)) {
+        VK(vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &block->mapped));
+    }
+    return block;
+}
+
+static void block_destroy(MemoryBlock *block, uint32_t memoryType) {
+    if (block->mapped != NULL) {
+        vkUnmapMemory(device, block->memory);
+    }
+    free_device_memory(memoryType, block->size, block->memory);
+    free(block->longest);
+    free(block->allocations);
+    free(block);
+}
+
+static void pool_add(MemoryPool *pool, MemoryBlock *block) {
+    if (pool->blockCount == pool->blockCapacity) {
+        pool->blockCapacity = pool->blockCapacity ? pool->blockCapacity * 2 : 4;
+        pool->blocks = realloc(pool->blocks, sizeof(MemoryBlock *) * pool->blockCapacity);
+    }
+    pool->blocks[pool->blockCount++] = block;
+}
+
+static void pool_remove(MemoryPool *pool, uint32_t index) {
+    pool->blocks[index] = pool->blocks[--pool->blockCount];
+}
+
+void allocator_init(void) {
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+    maxDeviceMemoryCount = deviceProperties.limits.maxMemoryAllocationCount;
+
+    // small heaps (integrated GPUs, BAR windows) get proportionally smaller blocks
+    for (uint32_t i = 0; i < memProperties.memoryHeapCount; i++) {
+        VkDeviceSize size = ALLOCATOR_BLOCK_SIZE;
+        while (size > (VkDeviceSize) ALLOCATOR_MIN_SIZE * 1024 && size > memProperties.memoryHeaps[i].size / 8) {
+            size /= 2;
+        }
+        blockSizes[i] = size;
+    }
+}
+
+void allocator_destroy(void) {
+    for (uint32_t type = 0; type < VK_MAX_MEMORY_TYPES; type++) {
+        for (uint32_t kind = 0; kind < ALLOCATION_KIND_COUNT; kind++) {
+            MemoryPool *pool = &pools[type][kind];
+            for (uint32_t i = 0; i < pool->blockCount; i++) {
+                if (pool->blocks[i]->allocationCount > 0) {
+                    fprintf(stderr, "leaked %u allocations in memory type %u\n", pool->blocks[i]->allocationCount, type);
+                }
+                block_destroy(pool->blocks[i], type);
+            }
+            free(pool->blocks);
+            pool->blocks = NULL;
+            pool->blockCount = 0;
+            pool->blockCapacity = 0;
+        }
+    }
+}
+
+static Allocation *alloc_dedicated(uint32_t memoryType, const VkMemoryRequirements *requirements,
+    AllocationKind kind, VkBuffer buffer, VkImage image) {
+    VkMemoryDedicatedAllocateInfo dedicatedInfo = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO,
+        .buffer = buffer,
+        .image = image
+    };
+    VkDeviceMemory memory;
+    bool named = buffer != VK_NULL_HANDLE || image != VK_NULL_HANDLE;
+    if (allocate_device_memory(memoryType, requirements->size, named ? &dedicatedInfo : NULL, &memory) != VK_SUCCESS) {
+        return NULL;
+    }
+
+    Allocation *allocation = calloc(1, sizeof(Allocation));
+    allocation->memory = memory;
+    allocation->offset = 0;
+    allocation->size = requirements->size;
+    allocation->memoryType = memoryType;
+    allocation->kind = kind;
+    if (host_visible(memoryType)) {
+        VK(vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &allocation->mapped));
+    }
+    dedicatedCount++;
+    dedicatedBytes += requirements->size;
+    return allocation;
+}
+
+static Allocation *alloc_from_pool(uint32_t memoryType, const VkMemoryRequirements *requirements, AllocationKind kind) {
+    MemoryPool *pool = &pools[memoryType][kind];
+    VkDeviceSize nodeSize = requirements->size > requirements->alignment ? requirements->size : requirements->alignment;
+    uint32_t order = order_for(nodeSize);
+
+    MemoryBlock *block = NULL;
+    VkDeviceSize offset = 0;
+    for (uint32_t i = 0; i < pool->blockCount && block == NULL; i++) {
+        if (block_alloc(pool->blocks[i], order, &offset)) {
+            block = pool->blocks[i];
+        }
+    }
+    if (block == NULL) {
+        block = block_create(memoryType);
+        if (block == NULL) {
+            return NULL;
+        }
+        pool_add(pool, block);
+        bool fits = block_alloc(block, order, &offset);
+        assert(fits);
+    }
+
+    Allocation *allocation = calloc(1, sizeof(Allocation));
+    allocation->memory = block->memory;
+    allocation->offset = offset;
+    allocation->size = requirements->size;
+    allocation->memoryType = memoryType;
+    allocation->kind = kind;
+    allocation->block = block;
+    allocation->order = order;
+    if (block->mapped != NULL) {
+        allocation->mapped = (uint8_t *) block->mapped + offset;
+    }
+    block_track(block, allocation);
+    return allocation;
+}
+
+static Allocation *alloc_internal(const VkMemoryRequirements *requirements, VkMemoryPropertyFlags properties,
+    AllocationKind kind, bool dedicated, VkBuffer buffer, VkImage image) {
+    for (uint32_t type = 0; type < memProperties.memoryTypeCount; type++) {
+        if ((requirements->memoryTypeBits & (1u << type)) == 0 ||
+            (memProperties.memoryTypes[type].propertyFlags & properties) != properties) {
+            continue;
+        }
+
+        // large resources would waste most of a block (and defeat the buddy split) on their own
+        VkDeviceSize blockSize = blockSizes[memProperties.memoryTypes[type].heapIndex];
+        bool ownMemory = dedicated || requirements->size > blockSize / 2;
+
+        Allocation *allocation = ownMemory
+            ? alloc_dedicated(type, requirements, kind, buffer, image)
+            : alloc_from_pool(type, requirements, kind);
+        if (allocation != NULL) {
+            return allocation;
+        }
+        // over budget in this type's heap, try the next compatible type
+    }
+    return NULL;
+}
+
+Allocation *allocator_alloc(const VkMemoryRequirements *requirements, VkMemoryPropertyFlags properties,
+    AllocationKind kind, bool dedicated) {
+    return alloc_internal(requirements, properties, kind, dedicated, VK_NULL_HANDLE, VK_NULL_HANDLE);
+}
+
+void allocator_free(Allocation *allocation) {
+    if (allocation == NULL) {
+        return;
+    }
+    if (allocation->buffer != VK_NULL_HANDLE) {
+        vkDestroyBuffer(device, allocation->buffer, NULL);
+    }
+    if (allocation->image != VK_NULL_HANDLE) {
+        vkDestroyImage(device, allocation->image, NULL);
+    }
+
+    MemoryBlock *block = allocation->block;
+    if (block == NULL) {
+        if (allocation->mapped != NULL) {
+            vkUnmapMemory(device, allocation->memory);
+        }
+        free_device_memory(allocation->memoryType, allocation->size, allocation->memory);
+        dedicatedCount--;
+        dedicatedBytes -= allocation->size;
+    } else {
+        block_free(block, allocation->offset, allocation->order);
+        block_untrack(block, allocation);
+
+        // keep one empty block per pool around to absorb churn, release the rest
+        MemoryPool *pool = &pools[allocation->memoryType][allocation->kind];
+        if (block->allocationCount == 0 && pool->blockCount > 1) {
+            for (uint32_t i = 0; i < pool->blockCount; i++) {
+                if (pool->blocks[i] == block) {
+                    pool_remove(pool, i);
+                    break;
+                }
+            }
+            block_destroy(block, allocation->memoryType);
+        }
+    }
+    free(allocation);
+}
+
+// the create info of a buffer like allocation's, allocator_defragment rebuilds them with it
+static VkBufferCreateInfo buffer_info(const Allocation *allocation, VkDeviceSize size) {
+    VkBufferCreateInfo bufferInfo = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = size,
+        .usage = allocation->bufferUsage,
+        .sharingMode = allocation->sharedFamilyCount > 1 ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = allocation->sharedFamilyCount > 1 ? allocation->sharedFamilyCount : 0,
+        .pQueueFamilyIndices = allocation->sharedFamilyCount > 1 ? allocation->sharedFamilies : NULL
+    };
+    return bufferInfo;
+}
+
+Allocation *allocator_create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties) {
+    return allocator_create_shared_buffer(size, usage, properties, NULL, 0);
+}
+
+Allocation *allocator_create_shared_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+    const uint32_t *families, uint32_t familyCount) {
+    // transfer usage on everything so allocator_defragment can always move it with a copy
+    Allocation shape = {
+        .bufferUsage = usage | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT
+    };
+    for (uint32_t i = 0; i < familyCount; i++) {
+        bool seen = false;
+        for (uint32_t j = 0; j < shape.sharedFamilyCount; j++) {
+            seen = seen || shape.sharedFamilies[j] == families[i];
+        }
+        if (!seen && shape.sharedFamilyCount < ALLOCATOR_MAX_SHARED_FAMILIES) {
+            shape.sharedFamilies[shape.sharedFamilyCount++] = families[i];
+        }
+    }
+    if (shape.sharedFamilyCount < 2) {
+        shape.sharedFamilyCount = 0;
+    }
+
+    VkBufferCreateInfo bufferInfo = buffer_info(&shape, size);
+    VkBuffer buffer;
+    VK(vkCreateBuffer(device, &bufferInfo, NULL, &buffer));
+
+    VkMemoryDedicatedRequirements dedicatedRequirements = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS
+    };
+    VkMemoryRequirements2 requirements = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2,
+        .pNext = &dedicatedRequirements
+    };
+    VkBufferMemoryRequirementsInfo2 requirementsInfo = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2,
+        .buffer = buffer
+    };
+    vkGetBufferMemoryRequirements2(device, &requirementsInfo, &requirements);
+
+    bool dedicated = dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation;
+    Allocation *allocation = alloc_internal(&requirements.memoryRequirements, properties, ALLOCATION_LINEAR,
+        dedicated, buffer, VK_NULL_HANDLE);
+    if (allocation == NULL) {
+        fprintf(stderr, "Out of memory for %llu byte buffer\n", (unsigned long long) size);
+        exit(1);
+    }
+    VK(vkBindBufferMemory(device, buffer, allocation->memory, allocation->offset));
+    allocation->buffer = buffer;
+    allocation->bufferUsage = shape.bufferUsage;
+    allocation->sharedFamilyCount = shape.sharedFamilyCount;
+    memcpy(allocation->sharedFamilies, shape.sharedFamilies, sizeof(shape.sharedFamilies));
+    return allocation;
+}
+
+Allocation *allocator_create_image(const VkImageCreateInfo *imageInfo, VkMemoryPropertyFlags properties) {
+    VkImage image;
+    VK(vkCreateImage(device, imageInfo, NULL, &image));
+
+    VkMemoryDedicatedRequirements dedicatedRequirements = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS
+    };
+    VkMemoryRequirements2 requirements = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2,
+        .pNext = &dedicatedRequirements
+    };
+    VkImageMemoryRequirementsInfo2 requirementsInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2,
+        .image = image
+    };
+    vkGetImageMemoryRequirements2(device, &requirementsInfo, &requirements);
+
+    bool dedicated = dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation;
+    AllocationKind kind = imageInfo->tiling == VK_IMAGE_TILING_OPTIMAL ? ALLOCATION_OPTIMAL : ALLOCATION_LINEAR;
+    Allocation *allocation = alloc_internal(&requirements.memoryRequirements, properties, kind,
+        dedicated, VK_NULL_HANDLE, image);
+    if (allocation == NULL) {
+        fprintf(stderr, "Out of memory for %ux%u image\n", imageInfo->extent.width, imageInfo->extent.height);
+        exit(1);
+    }
+    VK(vkBindImageMemory(device, image, allocation->memory, allocation->offset));
+    allocation->image = image;
+    return allocation;
+}
+
+static int compare_block_used(const void *a, const void *b) {
+    const MemoryBlock *blockA = *(const MemoryBlock * const *) a;
+    const MemoryBlock *blockB = *(const MemoryBlock * const *) b;
+    return blockA->used < blockB->used ? -1 : (blockA->used > blockB->used ? 1 : 0);
+}
+
+typedef struct Move {
+    Allocation *allocation;
+    MemoryBlock *srcBlock;
+    MemoryBlock *dstBlock;
+    VkDeviceSize dstOffset;
+    VkBuffer dstBuffer;
+} Move;
+
+void allocator_defragment(void) {
+    VkCommandPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+        .queueFamilyIndex = queueFamilyIdx
+    };
+    VkCommandPool commandPool;
+    VK(vkCreateCommandPool(device, &poolInfo, NULL, &commandPool));
+
+    uint32_t movedCount = 0;
+    uint32_t releasedCount = 0;
+
+    for (uint32_t type = 0; type < memProperties.memoryTypeCount; type++) {
+        MemoryPool *pool = &pools[type][ALLOCATION_LINEAR];
+        if (pool->blockCount < 2) {
+            continue;
+        }
+        // drain the emptiest blocks into the fullest
+        qsort(pool->blocks, pool->blockCount, sizeof(MemoryBlock *), compare_block_used);
+
+        uint32_t moveCapacity = 0;
+        for (uint32_t i = 0; i < pool->blockCount; i++) {
+            moveCapacity += pool->blocks[i]->allocationCount;
+        }
+        Move *moves = malloc(sizeof(Move) * (moveCapacity ? moveCapacity : 1));
+        uint32_t moveCount = 0;
+
+        VkCommandBufferAllocateInfo allocInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = commandPool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = 1
+        };
+        VkCommandBuffer cmd;
+        VK(vkAllocateCommandBuffers(device, &allocInfo, &cmd));
+        VkCommandBufferBeginInfo beginInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+        };
+        VK(vkBeginCommandBuffer(cmd, &beginInfo));
+
+        for (uint32_t src = 0; src + 1 < pool->blockCount; src++) {
+            MemoryBlock *srcBlock = pool->blocks[src];
+            for (uint32_t a = 0; a < srcBlock->allocationCount; a++) {
+                Allocation *allocation = srcBlock->allocations[a];
+                if (allocation->buffer == VK_NULL_HANDLE) {
+                    continue;
+                }
+
+                for (uint32_t dst = pool->blockCount - 1; dst > src; dst--) {
+                    MemoryBlock *dstBlock = pool->blocks[dst];
+                    VkDeviceSize dstOffset;
+                    if (!block_alloc(dstBlock, allocation->order, &dstOffset)) {
+                        continue;
+                    }
+
+                    VkBufferCreateInfo bufferInfo = buffer_info(allocation, allocation->size);
+                    VkBuffer dstBuffer;
+                    VK(vkCreateBuffer(device, &bufferInfo, NULL, &dstBuffer));
+                    VK(vkBindBufferMemory(device, dstBuffer, dstBlock->memory, dstOffset));
+
+                    VkBufferCopy region = {
+                        .srcOffset = 0,
+                        .dstOffset = 0,
+                        .size = allocation->size
+                    };
+                    vkCmdCopyBuffer(cmd, allocation->buffer, dstBuffer, 1, &region);
+
+                    Move move = {
+                        .allocation = allocation,
+                        .srcBlock = srcBlock,
+                        .dstBlock = dstBlock,
+                        .dstOffset = dstOffset,
+                        .dstBuffer = dstBuffer
+                    };
+                    moves[moveCount++] = move;
+                    break;
+                }
+            }
+        }
+
+        VK(vkEndCommandBuffer(cmd));
+        if (moveCount > 0) {
+            VkSubmitInfo submitInfo = {
+                .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+                .commandBufferCount = 1,
+                .pCommandBuffers = &cmd
+            };
+            VK(vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE));
+            VK(vkQueueWaitIdle(graphicsQueue));
+        }
+
+        for (uint32_t i = 0; i < moveCount; i++) {
+            Move *move = &moves[i];
+            Allocation *allocation = move->allocation;
+
+            vkDestroyBuffer(device, allocation->buffer, NULL);
+            block_free(move->srcBlock, allocation->offset, allocation->order);
+            block_untrack(move->srcBlock, allocation);
+
+            allocation->buffer = move->dstBuffer;
+            allocation->memory = move->dstBlock->memory;
+            allocation->offset = move->dstOffset;
+            allocation->block = move->dstBlock;
+            allocation->mapped = move->dstBlock->mapped != NULL ? (uint8_t *) move->dstBlock->mapped + move->dstOffset : NULL;
+            block_track(move->dstBlock, allocation);
+        }
+        movedCount += moveCount;
+        free(moves);
+        vkFreeCommandBuffers(device, commandPool, 1, &cmd);
+
+        for (uint32_t i = pool->blockCount; i-- > 0;) {
+            if (pool->blocks[i]->allocationCount == 0 && pool->blockCount > 1) {
+                block_destroy(pool->blocks[i], type);
+                pool_remove(pool, i);
+                releasedCount++;
+            }
+        }
+    }
+
+    vkDestroyCommandPool(device, commandPool, NULL);
+    printf("defragment: moved %u buffers, released %u blocks\n", movedCount, releasedCount);
+}
+
+void allocator_print_stats(void) {
+    const char *kindNames[ALLOCATION_KIND_COUNT] = {"linear", "optimal"};
+
+    printf("gpu memory: %u/%u device allocations, %u dedicated (%llu KiB)\n",
+        deviceMemoryCount, maxDeviceMemoryCount, dedicatedCount, (unsigned long long) (dedicatedBytes / 1024));
+
+    for (uint32_t type = 0; type < memProperties.memoryTypeCount; type++) {
+        for (uint32_t kind = 0; kind < ALLOCATION_KIND_COUNT; kind++) {
+            MemoryPool *pool = &pools[type][kind];
+            if (pool->blockCount == 0) {
+                continue;
+            }
+
+            VkDeviceSize total = 0, used = 0, requested = 0, largestFree = 0;
+            uint32_t allocationCount = 0;
+            for (uint32_t i = 0; i < pool->blockCount; i++) {
+                MemoryBlock *block = pool->blocks[i];
+                total += block->size;
+                used += block->used;
+                requested += block->requested;
+                allocationCount += block->allocationCount;
+                if (block->longest[0] > 0) {
+                    VkDeviceSize blockLargest = (VkDeviceSize) ALLOCATOR_MIN_SIZE << (block->longest[0] - 1);
+                    largestFree = blockLargest > largestFree ? blockLargest : largestFree;
+                }
+            }
+            VkDeviceSize freeBytes = total - used;
+
+            // external: free space not usable by one request, internal: buddy rounding waste
+            double external = freeBytes > 0 ? 1.0 - (double) largestFree / (double) freeBytes : 0.0;
+            double internal = used > 0 ? 1.0 - (double) requested / (double) used : 0.0;
+            printf("  type %u %s: %u blocks, %u allocations, %llu/%llu KiB used, "
+                "largest free %llu KiB, fragmentation %.1f%% external %.1f%% internal\n",
+                type, kindNames[kind], pool->blockCount, allocationCount,
+                (unsigned long long) (used / 1024), (unsigned long long) (total / 1024),
+                (unsigned long long) (largestFree / 1024), external * 100.0, internal * 100.0);
+        }
+    }
+
+    for (uint32_t heap = 0; heap < memProperties.memoryHeapCount; heap++) {
+        VkDeviceSize budget, usage;
+        heap_budget(heap, &budget, &usage);
+        printf("  heap %u: %llu MiB used of %llu MiB budget%s\n", heap,
+            (unsigned long long) (usage / (1024 * 1024)), (unsigned long long) (budget / (1024 * 1024)),
+            memoryBudgetEnabled ? "" : " (estimated)");
+    }
+}
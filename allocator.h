@@ -0,0 +1,67 @@
+#ifndef VULK_ALLOCATOR_H
+#define VULK_ALLOCATOR_H
+
+#include "vulk.h"
+
+// buffers and optimally tiled images live in separate blocks, so bufferImageGranularity
+// never has to be honoured between neighbouring allocations
+typedef enum AllocationKind {
+    ALLOCATION_LINEAR,
+    ALLOCATION_OPTIMAL,
+    ALLOCATION_KIND_COUNT
+} AllocationKind;
+
+struct MemoryBlock;
+
+#define ALLOCATOR_MAX_SHARED_FAMILIES 4
+
+typedef struct Allocation {
+    VkDeviceMemory memory;
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    void *mapped; // persistently mapped pointer for host visible memory, NULL otherwise
+    uint32_t memoryType;
+    AllocationKind kind;
+    struct MemoryBlock *block; // NULL for dedicated allocations
+    uint32_t order;
+
+    // set when the resource was created through the allocator, freed with it.
+    // allocator_defragment may replace buffer (and move memory/offset/mapped)
+    VkBuffer buffer;
+    VkBufferUsageFlags bufferUsage;
+    // queue families of a concurrent buffer, 0 for exclusive
+    uint32_t sharedFamilyCount;
+    uint32_t sharedFamilies[ALLOCATOR_MAX_SHARED_FAMILIES];
+    VkImage image;
+} Allocation;
+
+// set by main before allocator_init when VK_EXT_memory_budget was enabled on the device
+extern bool memoryBudgetEnabled;
+
+void allocator_init(void);
+void allocator_destroy(void);
+
+// sub-allocates from a per memory type block pool, or gives the request its own
+// VkDeviceMemory when dedicated or too large for a block. returns NULL when no memory
+// type with the properties has budget left
+Allocation *allocator_alloc(const VkMemoryRequirements *requirements, VkMemoryPropertyFlags properties,
+    AllocationKind kind, bool dedicated);
+// frees the memory and destroys the buffer or image created with it
+void allocator_free(Allocation *allocation);
+
+Allocation *allocator_create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
+// a VK_SHARING_MODE_CONCURRENT buffer the families use without ownership transfers, for data
+// written once and read from several queues. duplicate families are dropped, and with only one
+// left it is an ordinary exclusive buffer
+Allocation *allocator_create_shared_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+    const uint32_t *families, uint32_t familyCount);
+Allocation *allocator_create_image(const VkImageCreateInfo *imageInfo, VkMemoryPropertyFlags properties);
+
+// offline compaction: moves buffers out of the emptiest blocks into fuller ones and
+// releases blocks left empty. the caller guarantees the device is idle and nothing
+// holds a moved buffer's old handle or mapping. images stay where they are
+void allocator_defragment(void);
+
+void allocator_print_stats(void);
+
+#endif
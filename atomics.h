@@ -0,0 +1,72 @@
+#ifndef VULK_ATOMICS_H
+#define VULK_ATOMICS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// sequentially consistent atomics for C99, which has no <stdatomic.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+
+static __inline uint64_t atomic_add_u64(volatile uint64_t *p, uint64_t value) {
+    return (uint64_t) _InterlockedExchangeAdd64((volatile __int64 *) p, (__int64) value);
+}
+
+static __inline bool atomic_cas_u64(volatile uint64_t *p, uint64_t *expected, uint64_t desired) {
+    __int64 previous = _InterlockedCompareExchange64((volatile __int64 *) p, (__int64) desired, (__int64) *expected);
+    bool swapped = (uint64_t) previous == *expected;
+    *expected = (uint64_t) previous;
+    return swapped;
+}
+
+static __inline uint64_t atomic_load_u64(volatile uint64_t *p) {
+    return (uint64_t) _InterlockedCompareExchange64((volatile __int64 *) p, 0, 0);
+}
+
+static __inline void atomic_store_u64(volatile uint64_t *p, uint64_t value) {
+    _InterlockedExchange64((volatile __int64 *) p, (__int64) value);
+}
+
+static __inline uint32_t atomic_add_u32(volatile uint32_t *p, uint32_t value) {
+    return (uint32_t) _InterlockedExchangeAdd((volatile long *) p, (long) value);
+}
+
+static __inline uint32_t atomic_load_u32(volatile uint32_t *p) {
+    return (uint32_t) _InterlockedCompareExchange((volatile long *) p, 0, 0);
+}
+
+static __inline void atomic_store_u32(volatile uint32_t *p, uint32_t value) {
+    _InterlockedExchange((volatile long *) p, (long) value);
+}
+#else
+static inline uint64_t atomic_add_u64(volatile uint64_t *p, uint64_t value) {
+    return __atomic_fetch_add(p, value, __ATOMIC_SEQ_CST);
+}
+
+static inline bool atomic_cas_u64(volatile uint64_t *p, uint64_t *expected, uint64_t desired) {
+    return __atomic_compare_exchange_n(p, expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+static inline uint64_t atomic_load_u64(volatile uint64_t *p) {
+    return __atomic_load_n(p, __ATOMIC_SEQ_CST);
+}
+
+static inline void atomic_store_u64(volatile uint64_t *p, uint64_t value) {
+    __atomic_store_n(p, value, __ATOMIC_SEQ_CST);
+}
+
+static inline uint32_t atomic_add_u32(volatile uint32_t *p, uint32_t value) {
+    return __atomic_fetch_add(p, value, __ATOMIC_SEQ_CST);
+}
+
+static inline uint32_t atomic_load_u32(volatile uint32_t *p) {
+    return __atomic_load_n(p, __ATOMIC_SEQ_CST);
+}
+
+static inline void atomic_store_u32(volatile uint32_t *p, uint32_t value) {
+    __atomic_store_n(p, value, __ATOMIC_SEQ_CST);
+}
+#endif
+
+#endif
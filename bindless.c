@@ -0,0 +1,261 @@
+#include <string.h>
+#include "bindless.h"
+#include "frame.h"
+
+#define BINDLESS_MAX_BUFFERS 16384
+#define BINDLESS_MAX_TEXTURES 16384
+#define BINDLESS_MAX_SAMPLERS 64
+
+typedef struct BindlessRelease {
+    uint32_t index;
+    uint64_t retireFrame;
+} BindlessRelease;
+
+// slots are handed out from a free list first, then from the never used tail
+typedef struct BindlessTable {
+    VkDescriptorType type;
+    uint32_t capacity;
+    uint32_t next;
+    uint32_t *freeList;
+    uint32_t freeCount;
+    BindlessRelease *released;
+    uint32_t releasedCount;
+    uint32_t releasedCapacity;
+} BindlessTable;
+
+VkDescriptorSetLayout bindlessSetLayout;
+VkDescriptorSet bindlessSet;
+
+static VkDescriptorPool pool;
+static BindlessTable tables[BINDLESS_KIND_COUNT];
+
+static const char *kindNames[BINDLESS_KIND_COUNT] = {"buffer", "texture", "sampler"};
+
+void bindless_require_features(const VkPhysicalDeviceVulkan12Features *supported, VkPhysicalDeviceVulkan12Features *enabled) {
+    if (!supported->descriptorIndexing || !supported->runtimeDescriptorArray ||
+        !supported->descriptorBindingPartiallyBound || !supported->descriptorBindingUpdateUnusedWhilePending ||
+        !supported->descriptorBindingSampledImageUpdateAfterBind ||
+        !supported->descriptorBindingStorageBufferUpdateAfterBind ||
+        !supported->shaderSampledImageArrayNonUniformIndexing ||
+        !supported->shaderStorageBufferArrayNonUniformIndexing) {
+        fprintf(stderr, "Fatal: device lacks the descriptor indexing features bindless resources need\n");
+        exit(1);
+    }
+    enabled->descriptorIndexing = VK_TRUE;
+    enabled->runtimeDescriptorArray = VK_TRUE;
+    enabled->descriptorBindingPartiallyBound = VK_TRUE;
+    enabled->descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    enabled->descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    enabled->descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+    enabled->shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    enabled->shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+}
+
+static uint32_t clamp_count(uint32_t wanted, uint32_t perSet, uint32_t perStage) {
+    uint32_t count = wanted < perSet ? wanted : perSet;
+    return count < perStage ? count : perStage;
+}
+
+void bindless_init(void) {
+    VkPhysicalDeviceVulkan12Properties properties12 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES
+    };
+    VkPhysicalDeviceProperties2 properties = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext = &properties12
+    };
+    vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+    tables[BINDLESS_BUFFER].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    tables[BINDLESS_BUFFER].capacity = clamp_count(BINDLESS_MAX_BUFFERS,
+        properties12.maxDescriptorSetUpdateAfterBindStorageBuffers,
+        properties12.maxPerStageDescriptorUpdateAfterBindStorageBuffers);
+    tables[BINDLESS_TEXTURE].type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    tables[BINDLESS_TEXTURE].capacity = clamp_count(BINDLESS_MAX_TEXTURES,
+        properties12.maxDescriptorSetUpdateAfterBindSampledImages,
+        properties12.maxPerStageDescriptorUpdateAfterBindSampledImages);
+    tables[BINDLESS_SAMPLER].type = VK_DESCRIPTOR_TYPE_SAMPLER;
+    tables[BINDLESS_SAMPLER].capacity = clamp_count(BINDLESS_MAX_SAMPLERS,
+        properties12.maxDescriptorSetUpdateAfterBindSamplers,
+        properties12.maxPerStageDescriptorUpdateAfterBindSamplers);
+
+    // every stage sees the whole set, and buffers and textures also count against the stage's
+    // resource limit together (samplers do not). the share one table leaves goes to the other
+    uint32_t *buffers = &tables[BINDLESS_BUFFER].capacity;
+    uint32_t *textures = &tables[BINDLESS_TEXTURE].capacity;
+    uint32_t resources = properties12.maxPerStageUpdateAfterBindResources;
+    if ((uint64_t) *buffers + *textures > resources) {
+        uint32_t half = resources / 2;
+        if (*buffers < half) {
+            *textures = resources - *buffers;
+        } else if (*textures < half) {
+            *buffers = resources - *textures;
+        } else {
+            *buffers = half;
+            *textures = resources - half;
+        }
+    }
+
+    VkDescriptorSetLayoutBinding bindings[BINDLESS_KIND_COUNT];
+    VkDescriptorBindingFlags bindingFlags[BINDLESS_KIND_COUNT];
+    VkDescriptorPoolSize poolSizes[BINDLESS_KIND_COUNT];
+    for (uint32_t i = 0; i < BINDLESS_KIND_COUNT; i++) {
+        BindlessTable *table = &tables[i];
+        table->freeList = malloc(sizeof(uint32_t) * table->capacity);
+
+        VkDescriptorSetLayoutBinding binding = {
+            .binding = i,
+            .descriptorType = table->type,
+            .descriptorCount = table->capacity,
+            .stageFlags = VK_SHADER_STAGE_ALL
+        };
+        bindings[i] = binding;
+        // slots that were never written (or were released) are fine as long as shaders don't index them
+        bindingFlags[i] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+            VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+
+        VkDescriptorPoolSize poolSize = {
+            .type = table->type,
+            .descriptorCount = table->capacity
+        };
+        poolSizes[i] = poolSize;
+    }
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+        .bindingCount = BINDLESS_KIND_COUNT,
+        .pBindingFlags = bindingFlags
+    };
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = &bindingFlagsInfo,
+        .flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT,
+        .bindingCount = BINDLESS_KIND_COUNT,
+        .pBindings = bindings
+    };
+    VK(vkCreateDescriptorSetLayout(device, &layoutInfo, NULL, &bindlessSetLayout));
+
+    VkDescriptorPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+        .maxSets = 1,
+        .poolSizeCount = BINDLESS_KIND_COUNT,
+        .pPoolSizes = poolSizes
+    };
+    VK(vkCreateDescriptorPool(device, &poolInfo, NULL, &pool));
+
+    VkDescriptorSetAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = pool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &bindlessSetLayout
+    };
+    VK(vkAllocateDescriptorSets(device, &allocInfo, &bindlessSet));
+
+    printf("bindless: %u buffers, %u textures, %u samplers\n", tables[BINDLESS_BUFFER].capacity,
+        tables[BINDLESS_TEXTURE].capacity, tables[BINDLESS_SAMPLER].capacity);
+}
+
+void bindless_destroy(void) {
+    vkDestroyDescriptorPool(device, pool, NULL);
+    vkDestroyDescriptorSetLayout(device, bindlessSetLayout, NULL);
+    for (uint32_t i = 0; i < BINDLESS_KIND_COUNT; i++) {
+        free(tables[i].freeList);
+        free(tables[i].released);
+        memset(&tables[i], 0, sizeof(tables[i]));
+    }
+    pool = VK_NULL_HANDLE;
+    bindlessSetLayout = VK_NULL_HANDLE;
+    bindlessSet = VK_NULL_HANDLE;
+}
+
+static uint32_t take_slot(BindlessKind kind) {
+    BindlessTable *table = &tables[kind];
+    if (table->freeCount > 0) {
+        return table->freeList[--table->freeCount];
+    }
+    if (table->next == table->capacity) {
+        fprintf(stderr, "Fatal: bindless %s table full (%u)\n", kindNames[kind], table->capacity);
+        exit(1);
+    }
+    return table->next++;
+}
+
+static void write_slot(BindlessKind kind, uint32_t index, const VkDescriptorBufferInfo *bufferInfo,
+    const VkDescriptorImageInfo *imageInfo) {
+    VkWriteDescriptorSet write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = bindlessSet,
+        .dstBinding = kind,
+        .dstArrayElement = index,
+        .descriptorCount = 1,
+        .descriptorType = tables[kind].type,
+        .pBufferInfo = bufferInfo,
+        .pImageInfo = imageInfo
+    };
+    vkUpdateDescriptorSets(device, 1, &write, 0, NULL);
+}
+
+uint32_t bindless_add_buffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+    uint32_t index = take_slot(BINDLESS_BUFFER);
+    VkDescriptorBufferInfo bufferInfo = {
+        .buffer = buffer,
+        .offset = offset,
+        .range = range
+    };
+    write_slot(BINDLESS_BUFFER, index, &bufferInfo, NULL);
+    return index;
+}
+
+uint32_t bindless_add_texture(VkImageView view, VkImageLayout layout) {
+    uint32_t index = take_slot(BINDLESS_TEXTURE);
+    VkDescriptorImageInfo imageInfo = {
+        .imageView = view,
+        .imageLayout = layout
+    };
+    write_slot(BINDLESS_TEXTURE, index, NULL, &imageInfo);
+    return index;
+}
+
+uint32_t bindless_add_sampler(VkSampler sampler) {
+    uint32_t index = take_slot(BINDLESS_SAMPLER);
+    VkDescriptorImageInfo imageInfo = {
+        .sampler = sampler
+    };
+    write_slot(BINDLESS_SAMPLER, index, NULL, &imageInfo);
+    return index;
+}
+
+void bindless_release(BindlessKind kind, uint32_t index) {
+    BindlessTable *table = &tables[kind];
+    assert(index < table->next);
+    if (table->releasedCount == table->releasedCapacity) {
+        table->releasedCapacity = table->releasedCapacity ? table->releasedCapacity * 2 : 64;
+        table->released = realloc(table->released, sizeof(BindlessRelease) * table->releasedCapacity);
+    }
+    BindlessRelease release = {
+        .index = index,
+        .retireFrame = frameNumber
+    };
+    table->released[table->releasedCount++] = release;
+}
+
+void bindless_update(void) {
+    for (uint32_t i = 0; i < BINDLESS_KIND_COUNT; i++) {
+        BindlessTable *table = &tables[i];
+        uint32_t kept = 0;
+        for (uint32_t r = 0; r < table->releasedCount; r++) {
+            BindlessRelease *release = &table->released[r];
+            if (frameNumber >= release->retireFrame + framesInFlight) {
+                table->freeList[table->freeCount++] = release->index;
+            } else {
+                table->released[kept++] = *release;
+            }
+        }
+        table->releasedCount = kept;
+    }
+}
+
+void bindless_bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout layout) {
+    vkCmdBindDescriptorSets(commandBuffer, bindPoint, layout, 0, 1, &bindlessSet, 0, NULL);
+}
@@ -0,0 +1,43 @@
+#ifndef VULK_BINDLESS_H
+#define VULK_BINDLESS_H
+
+#include "vulk.h"
+
+// one global descriptor set (set 0) holding every buffer, texture and sampler in large
+// partially bound, update-after-bind arrays. it is bound once per command buffer and
+// shaders pick resources by index (usually from push constants), so draws never
+// bind descriptor sets. main thread only
+#define BINDLESS_INVALID 0xffffffffu
+
+// binding numbers in set 0, see shaders/bindless.glsl
+typedef enum BindlessKind {
+    BINDLESS_BUFFER,
+    BINDLESS_TEXTURE,
+    BINDLESS_SAMPLER,
+    BINDLESS_KIND_COUNT
+} BindlessKind;
+
+extern VkDescriptorSetLayout bindlessSetLayout;
+extern VkDescriptorSet bindlessSet;
+
+// before device creation: turns on the descriptor indexing features the table needs, fatal if missing
+void bindless_require_features(const VkPhysicalDeviceVulkan12Features *supported, VkPhysicalDeviceVulkan12Features *enabled);
+
+void bindless_init(void);
+void bindless_destroy(void);
+
+// write the descriptor into a free slot and return its index
+uint32_t bindless_add_buffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+uint32_t bindless_add_texture(VkImageView view, VkImageLayout layout);
+uint32_t bindless_add_sampler(VkSampler sampler);
+
+// the slot is reused once frames recorded before the release have retired
+void bindless_release(BindlessKind kind, uint32_t index);
+
+// call after frame_begin, recycles released slots
+void bindless_update(void);
+
+// binds the table as set 0, layout must have been created with bindlessSetLayout
+void bindless_bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout layout);
+
+#endif
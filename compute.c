@@ -0,0 +1,190 @@
+#include "compute.h"
+#include "frame.h"
+#include "streaming.h"
+
+// everything graphics may consume from compute results
+#define COMPUTE_DST_STAGES (VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | \
+    VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | meshShaderStage | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | \
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT)
+
+typedef struct ComputeFrame {
+    VkCommandPool commandPool;
+    VkCommandBuffer commandBuffer;
+    uint64_t timelineValue; // computeTimeline value of the slot's last submission, 0 before the first
+} ComputeFrame;
+
+bool asyncComputeRequested = true;
+bool asyncCompute = false;
+int computeQueueFamilyIdx = -1;
+VkQueue computeQueue;
+Timeline computeTimeline;
+
+static ComputeFrame computeFrames[MAX_FRAMES_IN_FLIGHT];
+static VkCommandBuffer recording; // begun this frame, VK_NULL_HANDLE otherwise
+static uint64_t submittedValue; // this frame's submission, 0 for none
+
+bool compute_select_queue(VkDeviceQueueCreateInfo *queueInfo) {
+    if (!asyncComputeRequested) {
+        return false;
+    }
+
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, NULL);
+    VkQueueFamilyProperties families[32];
+    familyCount = familyCount < 32 ? familyCount : 32;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families);
+
+    for (uint32_t i = 0; i < familyCount && computeQueueFamilyIdx < 0; i++) {
+        VkQueueFlags flags = families[i].queueFlags;
+        if ((int) i == queueFamilyIdx || (int) i == transferQueueFamilyIdx || families[i].queueCount == 0) {
+            continue;
+        }
+        if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT)) {
+            computeQueueFamilyIdx = (int) i;
+        }
+    }
+    if (computeQueueFamilyIdx < 0) {
+        return false;
+    }
+
+    // frame work, as urgent as graphics
+    static float priority = 1.0f;
+    VkDeviceQueueCreateInfo info = {
+        .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+        .queueFamilyIndex = computeQueueFamilyIdx,
+        .queueCount = 1,
+        .pQueuePriorities = &priority
+    };
+    *queueInfo = info;
+    return true;
+}
+
+void compute_init(void) {
+    recording = VK_NULL_HANDLE;
+    submittedValue = 0;
+    asyncCompute = computeQueueFamilyIdx >= 0;
+    if (!asyncCompute) {
+        printf("compute: graphics queue\n");
+        return;
+    }
+
+    vkGetDeviceQueue(device, computeQueueFamilyIdx, 0, &computeQueue);
+    timeline_create(&computeTimeline);
+    for (uint32_t i = 0; i < framesInFlight; i++) {
+        ComputeFrame *frame = &computeFrames[i];
+        VkCommandPoolCreateInfo poolInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+            .queueFamilyIndex = computeQueueFamilyIdx
+        };
+        VK(vkCreateCommandPool(device, &poolInfo, NULL, &frame->commandPool));
+
+        VkCommandBufferAllocateInfo allocInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = frame->commandPool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = 1
+        };
+        VK(vkAllocateCommandBuffers(device, &allocInfo, &frame->commandBuffer));
+        frame->timelineValue = 0;
+    }
+    printf("compute: async on family %d\n", computeQueueFamilyIdx);
+}
+
+void compute_destroy(void) {
+    if (!asyncCompute) {
+        return;
+    }
+    for (uint32_t i = 0; i < framesInFlight; i++) {
+        vkDestroyCommandPool(device, computeFrames[i].commandPool, NULL);
+    }
+    timeline_destroy(&computeTimeline);
+    asyncCompute = false;
+}
+
+VkCommandBuffer compute_begin(VkCommandBuffer graphicsCommandBuffer) {
+    if (!asyncCompute) {
+        return graphicsCommandBuffer;
+    }
+    if (recording != VK_NULL_HANDLE) {
+        return recording;
+    }
+
+    // the graphics frame waited on this slot already, and it waits on compute, so this
+    // normally passes straight away
+    ComputeFrame *frame = &computeFrames[currentFrame];
+    timeline_wait(&computeTimeline, frame->timelineValue);
+    VK(vkResetCommandPool(device, frame->commandPool, 0));
+
+    VkCommandBufferBeginInfo beginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+    };
+    VK(vkBeginCommandBuffer(frame->commandBuffer, &beginInfo));
+    recording = frame->commandBuffer;
+    return recording;
+}
+
+void compute_submit(uint64_t graphicsWaitValue) {
+    if (recording == VK_NULL_HANDLE) {
+        return;
+    }
+    VK(vkEndCommandBuffer(recording));
+
+    TimelineSubmit submit = {0};
+    if (graphicsWaitValue != 0) {
+        timeline_submit_wait(&submit, graphicsTimeline.semaphore, graphicsWaitValue, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    }
+    submittedValue = timeline_submit(&computeTimeline, computeQueue, &submit, 1, &recording);
+    computeFrames[currentFrame].timelineValue = submittedValue;
+    recording = VK_NULL_HANDLE;
+}
+
+void compute_submit_waits(TimelineSubmit *submit) {
+    if (submittedValue == 0) {
+        return;
+    }
+    timeline_submit_wait(submit, computeTimeline.semaphore, submittedValue, COMPUTE_DST_STAGES);
+    submittedValue = 0;
+}
+
+void compute_release_buffer(VkCommandBuffer computeCommandBuffer, VkBuffer buffer) {
+    if (!asyncCompute) {
+        return;
+    }
+    VkBufferMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = 0,
+        .srcQueueFamilyIndex = computeQueueFamilyIdx,
+        .dstQueueFamilyIndex = queueFamilyIdx,
+        .buffer = buffer,
+        .offset = 0,
+        .size = VK_WHOLE_SIZE
+    };
+    vkCmdPipelineBarrier(computeCommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, NULL, 1, &barrier, 0, NULL);
+}
+
+void compute_acquire_buffer(VkCommandBuffer graphicsCommandBuffer, VkBuffer buffer,
+    VkPipelineStageFlags dstStages, VkAccessFlags dstAccess) {
+    VkBufferMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = dstAccess,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = buffer,
+        .offset = 0,
+        .size = VK_WHOLE_SIZE
+    };
+    VkPipelineStageFlags srcStages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+    if (asyncCompute) {
+        // the semaphore wait already covers the writes, only the acquire half is left
+        barrier.srcAccessMask = 0;
+        barrier.srcQueueFamilyIndex = computeQueueFamilyIdx;
+        barrier.dstQueueFamilyIndex = queueFamilyIdx;
+        srcStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    }
+    vkCmdPipelineBarrier(graphicsCommandBuffer, srcStages, dstStages, 0, 0, NULL, 1, &barrier, 0, NULL);
+}
@@ -0,0 +1,45 @@
+#ifndef VULK_COMPUTE_H
+#define VULK_COMPUTE_H
+
+#include "vulk.h"
+#include "timeline.h"
+
+// async compute on a compute-only queue family. a frame's compute work is recorded into a
+// command buffer of its own and submitted ahead of the frame's graphics submission, which
+// waits on computeTimeline where the results are consumed. compute only waits on graphics
+// when told to, so it overlaps the previous frame's rendering. without a separate family
+// (lavapipe, most integrated GPUs) or with --no-async-compute the same recording goes into
+// the graphics command buffer and ordering comes from barriers alone
+extern bool asyncComputeRequested;
+// set by compute_init
+extern bool asyncCompute;
+extern int computeQueueFamilyIdx; // -1 when there is no separate compute family
+extern VkQueue computeQueue;
+// work submitted to computeQueue
+extern Timeline computeTimeline;
+
+// before device creation, after streaming_select_queue: picks a compute family other than
+// the graphics and transfer ones and fills queueInfo for it. false when there is none
+bool compute_select_queue(VkDeviceQueueCreateInfo *queueInfo);
+// after frames_create
+void compute_init(void);
+// after vkDeviceWaitIdle
+void compute_destroy(void);
+
+// the command buffer this frame's compute work goes into: the compute queue's own (begun on
+// the first call of the frame) or graphicsCommandBuffer when there is no async compute
+VkCommandBuffer compute_begin(VkCommandBuffer graphicsCommandBuffer);
+// submits what compute_begin handed out this frame, once graphicsTimeline has reached
+// graphicsWaitValue (0 for no wait). nothing happens when the frame recorded no compute work
+void compute_submit(uint64_t graphicsWaitValue);
+// adds the wait for this frame's compute submission to the frame's graphics submit
+void compute_submit_waits(TimelineSubmit *submit);
+
+// hand a buffer written by compute over to graphics: the release is recorded into the compute
+// command buffer after the writes, the acquire into the graphics one before the reads. with
+// a single queue the release does nothing and the acquire is a plain memory barrier
+void compute_release_buffer(VkCommandBuffer computeCommandBuffer, VkBuffer buffer);
+void compute_acquire_buffer(VkCommandBuffer graphicsCommandBuffer, VkBuffer buffer,
+    VkPipelineStageFlags dstStages, VkAccessFlags dstAccess);
+
+#endif
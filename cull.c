@@ -0,0 +1,683 @@
+#include <string.h>
+#include "cull.h"
+#include "bindless.h"
+#include "compute.h"
+#include "frame.h"
+#include "hiz.h"
+#include "lod.h"
+#include "pipeline_cache.h"
+#include "timeline.h"
+#include "timer.h"
+
+// mirrored by ViewBuffer in shaders/cull.comp
+typedef struct CullView {
+    mat4 viewProj;
+    vec4 planes[6];
+    vec4 eye;
+    uint32_t depthSize[2];
+    uint32_t pyramidTexture;
+    uint32_t pyramidSampler;
+    uint32_t pyramidLevels;
+    float facing;
+} CullView;
+
+// mirrored by PushConstants in shaders/cull.comp
+typedef struct CullPushConstants {
+    uint32_t viewBuffer;
+    uint32_t objectBuffer;
+    uint32_t meshletBuffer;
+    uint32_t clusterBuffer;
+    uint32_t drawBuffer;
+    uint32_t countBuffer;
+    uint32_t visibilityBuffer;
+    uint32_t lodBuffer;
+    uint32_t levelBuffer;
+    uint32_t clusterCount;
+    uint32_t compact;
+    uint32_t phase;
+    uint32_t meshTasks;
+} CullPushConstants;
+
+typedef enum CullPhase {
+    CULL_PHASE_ALL,
+    CULL_PHASE_EARLY,
+    CULL_PHASE_LATE
+} CullPhase;
+
+#define CULL_GROUP_SIZE 64
+
+bool cullRequested = true;
+bool cullOcclusionRequested = true;
+bool cullOcclusion = false;
+bool cullVerify = false;
+
+static VkPipelineLayout layout;
+static VkPipeline pipeline;
+static bool enabled;
+// frame number from which the object upload has landed
+static uint64_t firstFrame;
+// the slot culled last, MAX_FRAMES_IN_FLIGHT before the first dispatch
+static uint32_t lastSlot = MAX_FRAMES_IN_FLIGHT;
+// frameNumber of the last cull_record that dispatched
+static uint64_t culledFrame = UINT64_MAX;
+
+// written by the CPU at the start of each frame, read by both phases
+static Allocation *viewBuffers[MAX_FRAMES_IN_FLIGHT];
+static uint32_t viewBufferIndices[MAX_FRAMES_IN_FLIGHT];
+// uint per cluster, 1 when the late phase found it visible. read and written on both queues
+static Allocation *visibilityBuffer;
+static uint32_t visibilityBufferIndex = BINDLESS_INVALID;
+static bool visibilityCleared;
+
+// two timestamps per frame slot around the dispatch, VK_NULL_HANDLE when the queue has none
+static VkQueryPool queryPool;
+static bool queryPending[MAX_FRAMES_IN_FLIGHT];
+static uint64_t timestampMask;
+static float timestampPeriod;
+static double gpuTime; // seconds over the timed dispatches
+static uint32_t timedDispatches;
+
+void cull_configure(const VkPhysicalDeviceFeatures *supported) {
+    // the pyramid levels are storage images indexed by push constant
+    cullOcclusion = cullRequested && cullOcclusionRequested && sceneIndirect &&
+        supported->shaderStorageImageArrayDynamicIndexing;
+    renderingDepthSampled = cullOcclusion;
+    sceneTwoPhase = cullOcclusion;
+}
+
+void cull_init(void) {
+    enabled = cullRequested && sceneIndirect && sceneClusterCount > 0;
+    cullOcclusion = cullOcclusion && enabled;
+    if (!enabled) {
+        printf("cull: %s\n", cullRequested ? "cpu only, the scene draws directly" : "off");
+        return;
+    }
+
+    for (uint32_t i = 0; i < framesInFlight; i++) {
+        viewBuffers[i] = allocator_create_buffer(sizeof(CullView), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        viewBufferIndices[i] = bindless_add_buffer(viewBuffers[i]->buffer, 0, sizeof(CullView));
+    }
+    if (cullOcclusion) {
+        uint32_t families[] = {(uint32_t) queueFamilyIdx, (uint32_t) computeQueueFamilyIdx};
+        VkDeviceSize visibilitySize = sizeof(uint32_t) * sceneClusterCount;
+        visibilityBuffer = allocator_create_shared_buffer(visibilitySize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, families, asyncCompute ? 2 : 0);
+        visibilityBufferIndex = bindless_add_buffer(visibilityBuffer->buffer, 0, visibilitySize);
+        visibilityCleared = false;
+        hiz_init();
+    }
+
+    VkPushConstantRange pushConstantRange = {
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = sizeof(CullPushConstants)
+    };
+    VkPipelineLayoutCreateInfo layoutInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &bindlessSetLayout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &pushConstantRange
+    };
+    VK(vkCreatePipelineLayout(device, &layoutInfo, NULL, &layout));
+
+    VkShaderModule shader = read_shader("../shaders/cull.spv");
+    VkComputePipelineCreateInfo pipelineInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .stage = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .module = shader,
+            .pName = "main"
+        },
+        .layout = layout,
+        .basePipelineIndex = -1
+    };
+    VK(vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, NULL, &pipeline));
+    vkDestroyShaderModule(device, shader, NULL);
+
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, NULL);
+    VkQueueFamilyProperties families[32];
+    familyCount = familyCount < 32 ? familyCount : 32;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families);
+    uint32_t validBits = families[asyncCompute ? computeQueueFamilyIdx : queueFamilyIdx].timestampValidBits;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    timestampPeriod = properties.limits.timestampPeriod;
+    timestampMask = validBits >= 64 ? UINT64_MAX : (1ull << validBits) - 1;
+    queryPool = VK_NULL_HANDLE;
+    if (validBits > 0) {
+        VkQueryPoolCreateInfo queryInfo = {
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .queryType = VK_QUERY_TYPE_TIMESTAMP,
+            .queryCount = 2 * MAX_FRAMES_IN_FLIGHT
+        };
+        VK(vkCreateQueryPool(device, &queryInfo, NULL, &queryPool));
+    }
+    memset(queryPending, 0, sizeof(queryPending));
+    gpuTime = 0.0;
+    timedDispatches = 0;
+
+    // the first frame flushes the upload, it has retired by the time its slot comes round again
+    firstFrame = frameNumber + framesInFlight;
+    lastSlot = MAX_FRAMES_IN_FLIGHT;
+    printf("cull: gpu, %s draw list%s%s\n", sceneIndirectCount ? "compacted" : "in place",
+        cullOcclusion ? ", two-phase occlusion" : "", queryPool == VK_NULL_HANDLE ? ", untimed" : "");
+}
+
+void cull_destroy(void) {
+    if (!enabled) {
+        return;
+    }
+    if (cullOcclusion) {
+        hiz_destroy();
+        bindless_release(BINDLESS_BUFFER, visibilityBufferIndex);
+        allocator_free(visibilityBuffer);
+        visibilityBuffer = NULL;
+        visibilityBufferIndex = BINDLESS_INVALID;
+    }
+    for (uint32_t i = 0; i < framesInFlight; i++) {
+        bindless_release(BINDLESS_BUFFER, viewBufferIndices[i]);
+        allocator_free(viewBuffers[i]);
+        viewBuffers[i] = NULL;
+    }
+    if (queryPool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(device, queryPool, NULL);
+    }
+    vkDestroyPipeline(device, pipeline, NULL);
+    vkDestroyPipelineLayout(device, layout, NULL);
+    enabled = false;
+}
+
+void cull_frustum_planes(mat4 viewProj, vec4 planes[6]) {
+    glm_frustum_planes(viewProj, planes);
+
+    // cglm derives near from GL's -w <= z, Vulkan clips at 0 <= z
+    mat4 t;
+    glm_mat4_transpose_to(viewProj, t);
+    glm_vec4_copy(t[2], planes[4]);
+    glm_plane_normalize(planes[4]);
+}
+
+void cull_camera(mat4 viewProj, CullCamera *camera) {
+    cull_frustum_planes(viewProj, camera->planes);
+
+    // clip space points with x = y = w = 0 all map back to the eye, the one towards smaller
+    // depth gives the direction to the viewer when the eye is at infinity
+    mat4 inverse;
+    glm_mat4_inv(viewProj, inverse);
+    glm_mat4_mulv(inverse, (vec4){0.0f, 0.0f, -1.0f, 0.0f}, camera->eye);
+    float scale = glm_vec3_norm(camera->eye);
+    if (camera->eye[3] < -1e-6f * scale) {
+        glm_vec4_negate(camera->eye);
+    } else if (camera->eye[3] < 1e-6f * scale) {
+        camera->eye[3] = 0.0f;
+    }
+    camera->facing = glm_mat4_det(viewProj) < 0.0f ? -1.0f : 1.0f;
+}
+
+bool cull_object_visible(const SceneObject *object, vec4 planes[6]) {
+    vec3 box[2];
+    glm_vec3_copy((float *) object->boundsMin, box[0]);
+    glm_vec3_copy((float *) object->boundsMax, box[1]);
+    return glm_aabb_frustum(box, planes);
+}
+
+static bool sphere_frustum(const vec4 sphere, const CullCamera *camera) {
+    for (int i = 0; i < 6; i++) {
+        const float *p = camera->planes[i];
+        float distance = p[0] * sphere[0] + p[1] * sphere[1] + p[2] * sphere[2] + p[3];
+        if (distance < -sphere[3]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// every triangle faces away from the eye. front faces wind clockwise on Vulkan's y down
+// screen (see main.c), so with facing 1 a triangle shows its back to eyes on the side its
+// winding normal points to: the eye must lie within the cone around the axis, the sphere
+// keeping it clear of all the triangles. squared to stay clear of sqrt, which the GPU does
+// not round the same way
+static bool cone_backfacing(const vec4 sphere, const Meshlet *meshlet, const CullCamera *camera) {
+    if (meshlet->coneCutoff > 1.0f) {
+        return false;
+    }
+    const float *eye = camera->eye;
+    const float *axis = meshlet->coneAxis;
+    float toEye[3];
+    for (int c = 0; c < 3; c++) {
+        toEye[c] = eye[c] - sphere[c] * eye[3];
+    }
+    float along = camera->facing * (toEye[0] * axis[0] + toEye[1] * axis[1] + toEye[2] * axis[2])
+        - sphere[3] * eye[3];
+    float lengthSquared = toEye[0] * toEye[0] + toEye[1] * toEye[1] + toEye[2] * toEye[2];
+    return along >= 0.0f && along * along >= meshlet->coneCutoff * meshlet->coneCutoff * lengthSquared;
+}
+
+bool cull_cluster_visible(uint32_t cluster, const CullCamera *camera) {
+    const SceneObject *object = &sceneObjects[sceneClusterObjects[cluster]];
+    if (!scene_cluster_in_level(cluster, lodLevels[sceneClusterObjects[cluster]]) ||
+        !cull_object_visible(object, (vec4 *) camera->planes)) {
+        return false;
+    }
+    if (object->meshletCount == 0) {
+        return true;
+    }
+
+    const Meshlet *meshlet = &sceneMeshlets[object->firstMeshlet + cluster - object->firstCluster];
+    mat4 model;
+    glm_translate_make(model, (float *) object->transform);
+    glm_scale_uni(model, object->transform[3]);
+    vec4 sphere = {meshlet->center[0], meshlet->center[1], meshlet->center[2], meshlet->radius};
+    glm_sphere_transform(sphere, model, sphere);
+    // glm_sphere_transform keeps the radius as it is
+    sphere[3] = meshlet->radius * object->transform[3];
+    return sphere_frustum(sphere, camera) && !cone_backfacing(sphere, meshlet, camera);
+}
+
+uint32_t cull_clusters(const CullCamera *camera, bool *visible) {
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < sceneClusterCount; i++) {
+        visible[i] = cull_cluster_visible(i, camera);
+        count += visible[i];
+    }
+    return count;
+}
+
+// folds in the slot's timestamps from its previous frame, which has retired
+static void collect_timestamps(uint32_t slot) {
+    if (!queryPending[slot]) {
+        return;
+    }
+    uint64_t timestamps[2];
+    VkResult result = vkGetQueryPoolResults(device, queryPool, 2 * slot, 2, sizeof(timestamps), timestamps,
+        sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (result == VK_SUCCESS) {
+        uint64_t ticks = (timestamps[1] - timestamps[0]) & timestampMask;
+        gpuTime += ticks * (double) timestampPeriod * 1e-9;
+        timedDispatches++;
+    } else if (result != VK_NOT_READY) {
+        VK(result);
+    }
+    queryPending[slot] = false;
+}
+
+// fills the phase's draw list for the current frame slot, the caller binds nothing
+static void dispatch(VkCommandBuffer commandBuffer, const SceneDrawList *list, CullPhase phase) {
+    // the count starts at 0 for the atomics, without drawIndirectCount it stays unused. the task
+    // count's y and z are rewritten with it, compute takes the buffer without an acquire so
+    // nothing uploaded on graphics is defined here
+    if (sceneMeshTasks) {
+        VkDrawMeshTasksIndirectCommandEXT taskCount = {0, 1, 1};
+        vkCmdUpdateBuffer(commandBuffer, list->count->buffer, 0, sizeof(taskCount), &taskCount);
+    } else if (sceneIndirectCount) {
+        vkCmdFillBuffer(commandBuffer, list->count->buffer, 0, sizeof(uint32_t), 0);
+    }
+    if (sceneIndirectCount) {
+        VkBufferMemoryBarrier barrier = {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .buffer = list->count->buffer,
+            .offset = 0,
+            .size = VK_WHOLE_SIZE
+        };
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 0, NULL, 1, &barrier, 0, NULL);
+    }
+
+    CullPushConstants pushConstants = {
+        .viewBuffer = viewBufferIndices[currentFrame],
+        .objectBuffer = sceneObjectBufferIndex,
+        .meshletBuffer = sceneMeshletBufferIndex,
+        .clusterBuffer = sceneClusterBufferIndex,
+        .drawBuffer = list->drawsIndex,
+        .countBuffer = list->countIndex,
+        .visibilityBuffer = visibilityBufferIndex,
+        .lodBuffer = sceneLodBufferIndex,
+        .levelBuffer = lod_level_buffer(),
+        .clusterCount = sceneClusterCount,
+        .compact = sceneIndirectCount,
+        .phase = phase,
+        .meshTasks = sceneMeshTasks
+    };
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    bindless_bind(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, layout);
+    vkCmdPushConstants(commandBuffer, layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+    vkCmdDispatch(commandBuffer, (sceneClusterCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+}
+
+void cull_record(VkCommandBuffer graphicsCommandBuffer, mat4 viewProj) {
+    if (cullOcclusion) {
+        hiz_update();
+    }
+    if (!enabled || frameNumber < firstFrame) {
+        return;
+    }
+
+    CullCamera camera;
+    cull_camera(viewProj, &camera);
+    CullView *view = viewBuffers[currentFrame]->mapped;
+    glm_mat4_copy(viewProj, view->viewProj);
+    memcpy(view->planes, camera.planes, sizeof(view->planes));
+    glm_vec4_copy(camera.eye, view->eye);
+    view->facing = camera.facing;
+    view->depthSize[0] = swapChainExtent.width;
+    view->depthSize[1] = swapChainExtent.height;
+    view->pyramidTexture = hizTexture;
+    view->pyramidSampler = hizSampler;
+    view->pyramidLevels = hizLevels;
+
+    SceneDrawList *list = &sceneDrawLists[currentFrame][SCENE_EARLY];
+    VkCommandBuffer commandBuffer = compute_begin(graphicsCommandBuffer);
+    if (queryPool != VK_NULL_HANDLE) {
+        collect_timestamps(currentFrame);
+        vkCmdResetQueryPool(commandBuffer, queryPool, 2 * currentFrame, 2);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 2 * currentFrame);
+    }
+
+    // nothing was drawn before the first culled frame, so the early phase starts out empty
+    if (cullOcclusion && !visibilityCleared) {
+        vkCmdFillBuffer(commandBuffer, visibilityBuffer->buffer, 0, VK_WHOLE_SIZE, 0);
+        VkMemoryBarrier barrier = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT
+        };
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 1, &barrier, 0, NULL, 0, NULL);
+        visibilityCleared = true;
+    } else if (cullOcclusion && !asyncCompute) {
+        // the previous frame's late phase wrote the visibility on this queue in another
+        // submission, the timeline wait only orders it for the compute queue
+        VkMemoryBarrier barrier = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT
+        };
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, NULL, 0, NULL);
+    }
+    dispatch(commandBuffer, list, cullOcclusion ? CULL_PHASE_EARLY : CULL_PHASE_ALL);
+
+    if (queryPool != VK_NULL_HANDLE) {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 2 * currentFrame + 1);
+        queryPending[currentFrame] = true;
+    }
+
+    // what is not rewritten here is never read, so compute takes the buffers without an acquire
+    // with mesh tasks only the count is an indirect command, the mesh shader reads the entries
+    compute_release_buffer(commandBuffer, list->draws->buffer);
+    compute_acquire_buffer(graphicsCommandBuffer, list->draws->buffer,
+        sceneMeshTasks ? VK_PIPELINE_STAGE_MESH_SHADER_BIT_EXT : VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+        sceneMeshTasks ? VK_ACCESS_SHADER_READ_BIT : VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+    if (sceneIndirectCount) {
+        compute_release_buffer(commandBuffer, list->count->buffer);
+        compute_acquire_buffer(graphicsCommandBuffer, list->count->buffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+            VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+    }
+    lastSlot = currentFrame;
+    culledFrame = frameNumber;
+}
+
+uint64_t cull_compute_wait(void) {
+    if (!cullOcclusion || culledFrame != frameNumber) {
+        return 0;
+    }
+    return graphicsTimeline.submitted;
+}
+
+void cull_record_late(VkCommandBuffer commandBuffer) {
+    if (!cullOcclusion || culledFrame != frameNumber) {
+        return;
+    }
+    dispatch(commandBuffer, &sceneDrawLists[currentFrame][SCENE_LATE], CULL_PHASE_LATE);
+}
+
+void cull_report(mat4 viewProj) {
+    if (sceneClusterCount == 0) {
+        return;
+    }
+
+    // the CPU reference over the same clusters, repeated until the timer resolves it
+    CullCamera camera;
+    cull_camera(viewProj, &camera);
+    bool *visible = malloc(sizeof(bool) * sceneClusterCount);
+    uint32_t visibleCount = 0;
+    uint32_t runs = 0;
+    double start = timer_now();
+    double cpuTime;
+    do {
+        visibleCount = cull_clusters(&camera, visible);
+        runs++;
+        cpuTime = timer_now() - start;
+    } while (cpuTime < 0.01 && runs < 1000);
+    free(visible);
+
+    double cpuMs = cpuTime * 1000.0 / runs;
+    printf("cull: %u of %u clusters visible, cpu %.3fms (%.0f clusters/ms)", visibleCount, sceneClusterCount,
+        cpuMs, cpuMs > 0.0 ? sceneClusterCount / cpuMs : 0.0);
+    if (enabled && timedDispatches > 0) {
+        double gpuMs = gpuTime * 1000.0 / timedDispatches;
+        printf(", gpu %.3fms (%.0f clusters/ms) over %u dispatches", gpuMs,
+            gpuMs > 0.0 ? sceneClusterCount / gpuMs : 0.0, timedDispatches);
+    }
+    printf("\n");
+}
+
+// copies the list's draws with its count behind them
+static void copy_list(VkCommandBuffer cmd, const SceneDrawList *list, VkBuffer dst, VkDeviceSize offset) {
+    VkDeviceSize drawsSize = sizeof(VkDrawIndexedIndirectCommand) * sceneClusterCount;
+    VkBufferCopy drawsRegion = {
+        .srcOffset = 0,
+        .dstOffset = offset,
+        .size = drawsSize
+    };
+    vkCmdCopyBuffer(cmd, list->draws->buffer, dst, 1, &drawsRegion);
+    VkBufferCopy countRegion = {
+        .srcOffset = 0,
+        .dstOffset = offset + drawsSize,
+        .size = sizeof(uint32_t)
+    };
+    vkCmdCopyBuffer(cmd, list->count->buffer, dst, 1, &countRegion);
+}
+
+// the cluster an indexed draw covers, by the object's meshlet starting at its first index.
+// UINT32_MAX when it covers none
+static uint32_t draw_cluster(const VkDrawIndexedIndirectCommand *draw) {
+    if (draw->firstInstance >= sceneObjectCount) {
+        return UINT32_MAX;
+    }
+    const SceneObject *object = &sceneObjects[draw->firstInstance];
+    if (draw->vertexOffset != object->vertexOffset) {
+        return UINT32_MAX;
+    }
+    if (object->meshletCount == 0) {
+        const MeshLod *lod = lod_object_level(draw->firstInstance);
+        uint32_t indexCount = lod != NULL ? lod->indexCount : object->indexCount;
+        uint32_t firstIndex = object->firstIndex + (lod != NULL ? lod->firstIndex : 0);
+        bool whole = draw->indexCount == indexCount && draw->firstIndex == firstIndex;
+        return whole ? object->firstCluster : UINT32_MAX;
+    }
+    if (draw->firstIndex < object->firstIndex || (draw->firstIndex - object->firstIndex) % 3 != 0) {
+        return UINT32_MAX;
+    }
+
+    // the meshlets are in index buffer order
+    uint32_t triangleOffset = (draw->firstIndex - object->firstIndex) / 3;
+    const Meshlet *meshlets = &sceneMeshlets[object->firstMeshlet];
+    uint32_t low = 0;
+    uint32_t high = object->meshletCount;
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        if (meshlets[middle].triangleOffset < triangleOffset) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    if (low == object->meshletCount || meshlets[low].triangleOffset != triangleOffset ||
+        draw->indexCount != 3 * meshlets[low].triangleCount) {
+        return UINT32_MAX;
+    }
+    return object->firstCluster + low;
+}
+
+// the cluster a mesh task entry names, UINT32_MAX when the meshlet is not the object's
+static uint32_t task_cluster(const SceneClusterDraw *draw) {
+    if (draw->object >= sceneObjectCount) {
+        return UINT32_MAX;
+    }
+    const SceneObject *object = &sceneObjects[draw->object];
+    if (draw->meshlet < object->firstMeshlet || draw->meshlet - object->firstMeshlet >= object->meshletCount) {
+        return UINT32_MAX;
+    }
+    return object->firstCluster + draw->meshlet - object->firstMeshlet;
+}
+
+// compacted lists come out in atomic order, so a list becomes one flag per cluster. in place
+// lists keep every cluster, only the ones with instances count. returns the malformed draws
+static uint32_t read_list(const void *data, bool *drawn, uint32_t *duplicates) {
+    const VkDrawIndexedIndirectCommand *draws = data;
+    const SceneClusterDraw *tasks = data;
+    uint32_t drawCount = sceneIndirectCount ? *(const uint32_t *) (draws + sceneClusterCount) : sceneClusterCount;
+    uint32_t malformed = drawCount > sceneClusterCount;
+    for (uint32_t i = 0; i < drawCount && i < sceneClusterCount; i++) {
+        uint32_t cluster;
+        if (sceneMeshTasks) {
+            cluster = task_cluster(&tasks[i]);
+        } else {
+            const VkDrawIndexedIndirectCommand *draw = &draws[i];
+            if (sceneIndirectCount && draw->instanceCount != 1) {
+                malformed++;
+                continue;
+            }
+            if (draw->instanceCount == 0) {
+                continue;
+            }
+            cluster = draw_cluster(draw);
+        }
+        if (cluster == UINT32_MAX) {
+            malformed++;
+            continue;
+        }
+        *duplicates += drawn[cluster];
+        drawn[cluster] = true;
+    }
+    return malformed;
+}
+
+bool cull_verify(mat4 viewProj) {
+    if (!enabled || lastSlot == MAX_FRAMES_IN_FLIGHT) {
+        return true;
+    }
+
+    // early list, late list, visibility
+    VkDeviceSize listSize = sizeof(VkDrawIndexedIndirectCommand) * sceneClusterCount + sizeof(uint32_t);
+    VkDeviceSize visibilitySize = sizeof(uint32_t) * sceneClusterCount;
+    Allocation *readback = allocator_create_buffer(2 * listSize + visibilitySize, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    VkCommandPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+        .queueFamilyIndex = queueFamilyIdx
+    };
+    VkCommandPool pool;
+    VK(vkCreateCommandPool(device, &poolInfo, NULL, &pool));
+
+    VkCommandBufferAllocateInfo cmdAllocInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1
+    };
+    VkCommandBuffer cmd;
+    VK(vkAllocateCommandBuffers(device, &cmdAllocInfo, &cmd));
+
+    VkCommandBufferBeginInfo beginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+    };
+    VK(vkBeginCommandBuffer(cmd, &beginInfo));
+
+    // the last frame acquired the early list on graphics and wrote the rest there, the writes
+    // only need making visible
+    VkMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT
+    };
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, 1, &barrier, 0, NULL, 0, NULL);
+    copy_list(cmd, &sceneDrawLists[lastSlot][SCENE_EARLY], readback->buffer, 0);
+    if (cullOcclusion) {
+        copy_list(cmd, &sceneDrawLists[lastSlot][SCENE_LATE], readback->buffer, listSize);
+        VkBufferCopy visibilityRegion = {
+            .srcOffset = 0,
+            .dstOffset = 2 * listSize,
+            .size = visibilitySize
+        };
+        vkCmdCopyBuffer(cmd, visibilityBuffer->buffer, readback->buffer, 1, &visibilityRegion);
+    }
+
+    VkMemoryBarrier hostBarrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_HOST_READ_BIT
+    };
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+        0, 1, &hostBarrier, 0, NULL, 0, NULL);
+    VK(vkEndCommandBuffer(cmd));
+
+    timeline_wait(&graphicsTimeline, timeline_submit(&graphicsTimeline, graphicsQueue, NULL, 1, &cmd));
+    vkDestroyCommandPool(device, pool, NULL);
+
+    const char *data = readback->mapped;
+    bool *gpuVisible = calloc(sceneClusterCount, sizeof(bool));
+    bool *cpuVisible = malloc(sizeof(bool) * sceneClusterCount);
+    uint32_t duplicates = 0;
+    uint32_t malformed = read_list(data, gpuVisible, &duplicates);
+    if (cullOcclusion) {
+        malformed += read_list(data + listSize, gpuVisible, &duplicates);
+    }
+
+    // occlusion only ever removes clusters from the frustum's set, and whatever the late
+    // phase found visible was drawn by one of the phases
+    CullCamera camera;
+    cull_camera(viewProj, &camera);
+    uint32_t cpuCount = cull_clusters(&camera, cpuVisible);
+    const uint32_t *visibility = (const uint32_t *) (data + 2 * listSize);
+    uint32_t differing = 0;
+    uint32_t occluded = 0;
+    for (uint32_t i = 0; i < sceneClusterCount; i++) {
+        if (!cullOcclusion) {
+            differing += gpuVisible[i] != cpuVisible[i];
+            continue;
+        }
+        differing += (gpuVisible[i] && !cpuVisible[i]) || (visibility[i] != 0 && !gpuVisible[i]);
+        occluded += cpuVisible[i] && !gpuVisible[i];
+    }
+    free(gpuVisible);
+    free(cpuVisible);
+    allocator_free(readback);
+
+    if (differing > 0 || malformed > 0 || duplicates > 0) {
+        fprintf(stderr, "cull: gpu and cpu disagree on %u clusters, %u malformed and %u duplicate draws\n",
+            differing, malformed, duplicates);
+        return false;
+    }
+    if (cullOcclusion) {
+        printf("cull: gpu and cpu agree, %u of %u clusters in the frustum, %u of them occluded\n", cpuCount,
+            sceneClusterCount, occluded);
+    } else {
+        printf("cull: gpu and cpu agree, %u of %u clusters visible\n", cpuCount, sceneClusterCount);
+    }
+    return true;
+}
@@ -0,0 +1,75 @@
+#ifndef VULK_CULL_H
+#define VULK_CULL_H
+
+#include <cglm/cglm.h>
+#include "vulk.h"
+#include "scene.h"
+
+// culling of the scene's clusters (see scene.h). every cluster is tested against the frustum
+// with its object's world AABB, meshlet clusters also with their bounding sphere (placed by
+// glm_sphere_transform) and their normal cone against the eye. the planes are cglm's
+// glm_frustum_planes and the box test glm_aabb_frustum's, run on the CPU by
+// cull_cluster_visible and in shaders/cull.comp on the GPU, with the same float operations in
+// the same order so both agree on every cluster. the shader runs as the frame's compute work
+// and rewrites the frame slot's draw list: compacted behind an atomic count with
+// drawIndirectCount, otherwise in place with instanceCount 0 for culled clusters. the dispatch
+// is timed with timestamp queries and cull_report prints the throughput of both sides.
+//
+// with occlusion the scene draws in two phases against a depth pyramid (hiz.h). the early
+// phase, on compute, draws what the previous frame's late phase found visible. its depth is
+// reduced into the pyramid and the late phase, on graphics, tests every cluster in the
+// frustum against it, records the result for the next frame and draws the ones the early
+// phase missed.
+//
+// clusters outside their object's selected level of detail (lod.h) are culled first, objects
+// drawn whole draw the level's index range
+extern bool cullRequested;
+// --no-occlusion clears it
+extern bool cullOcclusionRequested;
+// set by cull_configure and cull_init, the scene draws in two phases
+extern bool cullOcclusion;
+// --verify-culling: cull_verify compares the last GPU list with the CPU result
+extern bool cullVerify;
+
+// before rendering_init: decides on occlusion and asks for a sampled depth target
+void cull_configure(const VkPhysicalDeviceFeatures *supported);
+// after scene_create: builds the pipeline when the scene draws indirectly
+void cull_init(void);
+void cull_destroy(void);
+
+// what the tests need from a view
+typedef struct CullCamera {
+    vec4 planes[6];
+    // the eye in homogeneous world coordinates, w 0 for orthographic views
+    vec4 eye;
+    // 1, or -1 when viewProj mirrors and the other winding faces the eye
+    float facing;
+} CullCamera;
+
+// glm_frustum_planes, with the near plane at Vulkan's z = 0 instead of GL's z = -w
+void cull_frustum_planes(mat4 viewProj, vec4 planes[6]);
+void cull_camera(mat4 viewProj, CullCamera *camera);
+bool cull_object_visible(const SceneObject *object, vec4 planes[6]);
+bool cull_cluster_visible(uint32_t cluster, const CullCamera *camera);
+// the CPU reference, fills visible (one per scene cluster) and returns how many are
+uint32_t cull_clusters(const CullCamera *camera, bool *visible);
+
+// culls into the current frame slot's draw list: the dispatch goes into
+// compute_begin(graphicsCommandBuffer), the draw list's acquire into graphicsCommandBuffer.
+// nothing is recorded until the object upload has landed, the lists list everything till then.
+// with occlusion this is the early phase, and the pyramid is resized to the swapchain first
+void cull_record(VkCommandBuffer graphicsCommandBuffer, mat4 viewProj);
+// the graphics value the frame's compute submission waits on: the early phase reads the
+// visibility the previous frame's late phase wrote. 0 when nothing needs waiting for
+uint64_t cull_compute_wait(void);
+// the late phase into the current slot's late list, after hiz_build. a no-op without occlusion
+// or when cull_record did not dispatch this frame
+void cull_record_late(VkCommandBuffer commandBuffer);
+
+void cull_report(mat4 viewProj);
+// after vkDeviceWaitIdle, reads back the draw lists culled last and checks them against
+// cull_clusters: the same set without occlusion, a subset holding everything the late phase
+// found visible with it. true when they agree or nothing was culled on the GPU
+bool cull_verify(mat4 viewProj);
+
+#endif
@@ -0,0 +1,150 @@
+#include "deletion.h"
+#include "thread.h"
+#include "timeline.h"
+
+static Deletion *queue;
+static uint32_t queueCount;
+static uint32_t queueCapacity;
+static Mutex mutex;
+
+static void destroy(const Deletion *deletion) {
+    switch (deletion->kind) {
+        case DELETION_BUFFER:
+            vkDestroyBuffer(device, deletion->object.buffer, NULL);
+            break;
+        case DELETION_IMAGE:
+            vkDestroyImage(device, deletion->object.image, NULL);
+            break;
+        case DELETION_IMAGE_VIEW:
+            vkDestroyImageView(device, deletion->object.imageView, NULL);
+            break;
+        case DELETION_FRAMEBUFFER:
+            vkDestroyFramebuffer(device, deletion->object.framebuffer, NULL);
+            break;
+        case DELETION_SAMPLER:
+            vkDestroySampler(device, deletion->object.sampler, NULL);
+            break;
+        case DELETION_SEMAPHORE:
+            vkDestroySemaphore(device, deletion->object.semaphore, NULL);
+            break;
+        case DELETION_SWAPCHAIN:
+            vkDestroySwapchainKHR(device, deletion->object.swapchain, NULL);
+            break;
+        case DELETION_PIPELINE:
+            vkDestroyPipeline(device, deletion->object.pipeline, NULL);
+            break;
+        case DELETION_DESCRIPTOR_POOL:
+            vkDestroyDescriptorPool(device, deletion->object.descriptorPool, NULL);
+            break;
+        case DELETION_COMMAND_POOL:
+            vkDestroyCommandPool(device, deletion->object.commandPool, NULL);
+            break;
+        case DELETION_MEMORY:
+            vkFreeMemory(device, deletion->object.memory, NULL);
+            break;
+        case DELETION_ALLOCATION:
+            allocator_free(deletion->object.allocation);
+            break;
+        case DELETION_HOST_MEMORY:
+            free(deletion->object.host);
+            break;
+    }
+}
+
+void deletion_init(void) {
+    mutex_init(&mutex);
+    queueCount = 0;
+}
+
+void deletion_destroy(void) {
+    assert(queueCount == 0);
+    free(queue);
+    queue = NULL;
+    queueCapacity = 0;
+    mutex_destroy(&mutex);
+}
+
+void deletion_queue(Deletion deletion) {
+    mutex_lock(&mutex);
+    if (deletion.retireValue == 0) {
+        deletion.retireValue = timeline_pending(&graphicsTimeline);
+    }
+    if (queueCount == queueCapacity) {
+        queueCapacity = queueCapacity ? queueCapacity * 2 : 64;
+        queue = realloc(queue, sizeof(Deletion) * queueCapacity);
+    }
+    queue[queueCount++] = deletion;
+    mutex_unlock(&mutex);
+}
+
+void deletion_buffer(VkBuffer buffer) {
+    Deletion deletion = {.kind = DELETION_BUFFER, .object.buffer = buffer};
+    deletion_queue(deletion);
+}
+
+void deletion_image(VkImage image) {
+    Deletion deletion = {.kind = DELETION_IMAGE, .object.image = image};
+    deletion_queue(deletion);
+}
+
+void deletion_image_view(VkImageView imageView) {
+    Deletion deletion = {.kind = DELETION_IMAGE_VIEW, .object.imageView = imageView};
+    deletion_queue(deletion);
+}
+
+void deletion_framebuffer(VkFramebuffer framebuffer) {
+    Deletion deletion = {.kind = DELETION_FRAMEBUFFER, .object.framebuffer = framebuffer};
+    deletion_queue(deletion);
+}
+
+void deletion_semaphore(VkSemaphore semaphore) {
+    Deletion deletion = {.kind = DELETION_SEMAPHORE, .object.semaphore = semaphore};
+    deletion_queue(deletion);
+}
+
+void deletion_swapchain(VkSwapchainKHR swapchain) {
+    Deletion deletion = {.kind = DELETION_SWAPCHAIN, .object.swapchain = swapchain};
+    deletion_queue(deletion);
+}
+
+void deletion_pipeline(VkPipeline pipeline) {
+    Deletion deletion = {.kind = DELETION_PIPELINE, .object.pipeline = pipeline};
+    deletion_queue(deletion);
+}
+
+void deletion_allocation(Allocation *allocation) {
+    Deletion deletion = {.kind = DELETION_ALLOCATION, .object.allocation = allocation};
+    deletion_queue(deletion);
+}
+
+void deletion_host_memory(void *host) {
+    Deletion deletion = {.kind = DELETION_HOST_MEMORY, .object.host = host};
+    deletion_queue(deletion);
+}
+
+void deletion_collect(void) {
+    mutex_lock(&mutex);
+    if (queueCount > 0) {
+        // one poll for the whole queue
+        uint64_t completed = timeline_completed(&graphicsTimeline);
+        uint32_t kept = 0;
+        for (uint32_t i = 0; i < queueCount; i++) {
+            if (queue[i].retireValue <= completed) {
+                destroy(&queue[i]);
+            } else {
+                queue[kept++] = queue[i];
+            }
+        }
+        queueCount = kept;
+    }
+    mutex_unlock(&mutex);
+}
+
+void deletion_flush(void) {
+    mutex_lock(&mutex);
+    for (uint32_t i = 0; i < queueCount; i++) {
+        destroy(&queue[i]);
+    }
+    queueCount = 0;
+    mutex_unlock(&mutex);
+}
@@ -0,0 +1,72 @@
+#ifndef VULK_DELETION_H
+#define VULK_DELETION_H
+
+#include "vulk.h"
+#include "allocator.h"
+
+// deferred destruction. objects the GPU may still be using are queued with the
+// graphicsTimeline value of the last submission that could reference them and destroyed
+// by deletion_collect once the timeline gets there, so runtime resource churn (resizes,
+// streaming, reloads) never needs vkDeviceWaitIdle. entries with the same value are
+// destroyed in the order they were queued. thread safe
+typedef enum DeletionKind {
+    DELETION_BUFFER,
+    DELETION_IMAGE,
+    DELETION_IMAGE_VIEW,
+    DELETION_FRAMEBUFFER,
+    DELETION_SAMPLER,
+    DELETION_SEMAPHORE,
+    DELETION_SWAPCHAIN,
+    DELETION_PIPELINE,
+    DELETION_DESCRIPTOR_POOL,
+    DELETION_COMMAND_POOL,
+    DELETION_MEMORY,
+    DELETION_ALLOCATION, // allocator_free, which also destroys its buffer or image
+    DELETION_HOST_MEMORY // free(), for arrays of handles queued alongside
+} DeletionKind;
+
+typedef struct Deletion {
+    DeletionKind kind;
+    uint64_t retireValue;
+    union {
+        VkBuffer buffer;
+        VkImage image;
+        VkImageView imageView;
+        VkFramebuffer framebuffer;
+        VkSampler sampler;
+        VkSemaphore semaphore;
+        VkSwapchainKHR swapchain;
+        VkPipeline pipeline;
+        VkDescriptorPool descriptorPool;
+        VkCommandPool commandPool;
+        VkDeviceMemory memory;
+        Allocation *allocation;
+        void *host;
+    } object;
+} Deletion;
+
+void deletion_init(void);
+// the queue has to have been flushed
+void deletion_destroy(void);
+
+// queues the deletion, a retireValue of 0 means the submission currently being recorded
+void deletion_queue(Deletion deletion);
+
+// shorthands retiring with the submission currently being recorded
+void deletion_buffer(VkBuffer buffer);
+void deletion_image(VkImage image);
+void deletion_image_view(VkImageView imageView);
+void deletion_framebuffer(VkFramebuffer framebuffer);
+void deletion_semaphore(VkSemaphore semaphore);
+void deletion_swapchain(VkSwapchainKHR swapchain);
+void deletion_pipeline(VkPipeline pipeline);
+void deletion_allocation(Allocation *allocation);
+void deletion_host_memory(void *host);
+
+// main thread after frame_begin, destroys everything the GPU has finished with
+void deletion_collect(void);
+
+// destroys everything regardless of the timeline, after vkDeviceWaitIdle
+void deletion_flush(void);
+
+#endif
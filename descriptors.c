@@ -0,0 +1,96 @@
+#include "descriptors.h"
+
+// descriptors per set of each type, sized for typical compute and post passes
+static const VkDescriptorPoolSize poolRatios[] = {
+    {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2},
+    {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4},
+    {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4},
+    {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 2},
+    {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2},
+    {VK_DESCRIPTOR_TYPE_SAMPLER, 1}
+};
+
+static VkDescriptorPool create_pool(void) {
+    uint32_t typeCount = sizeof(poolRatios) / sizeof(poolRatios[0]);
+    VkDescriptorPoolSize sizes[sizeof(poolRatios) / sizeof(poolRatios[0])];
+    for (uint32_t i = 0; i < typeCount; i++) {
+        sizes[i].type = poolRatios[i].type;
+        sizes[i].descriptorCount = poolRatios[i].descriptorCount * DESCRIPTOR_SETS_PER_POOL;
+    }
+
+    // no FREE_DESCRIPTOR_SET_BIT, the driver can allocate linearly
+    VkDescriptorPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .flags = 0,
+        .maxSets = DESCRIPTOR_SETS_PER_POOL,
+        .poolSizeCount = typeCount,
+        .pPoolSizes = sizes
+    };
+    VkDescriptorPool pool;
+    VK(vkCreateDescriptorPool(device, &poolInfo, NULL, &pool));
+    return pool;
+}
+
+void descriptor_allocator_init(DescriptorAllocator *allocator) {
+    allocator->poolCapacity = 4;
+    allocator->pools = malloc(sizeof(VkDescriptorPool) * allocator->poolCapacity);
+    allocator->pools[0] = create_pool();
+    allocator->poolCount = 1;
+    allocator->current = 0;
+    allocator->currentSetCount = 0;
+}
+
+void descriptor_allocator_destroy(DescriptorAllocator *allocator) {
+    for (uint32_t i = 0; i < allocator->poolCount; i++) {
+        vkDestroyDescriptorPool(device, allocator->pools[i], NULL);
+    }
+    free(allocator->pools);
+    allocator->pools = NULL;
+    allocator->poolCount = 0;
+    allocator->poolCapacity = 0;
+}
+
+void descriptor_allocator_reset(DescriptorAllocator *allocator) {
+    // pools past current were never touched since the last reset
+    for (uint32_t i = 0; i <= allocator->current; i++) {
+        VK(vkResetDescriptorPool(device, allocator->pools[i], 0));
+    }
+    allocator->current = 0;
+    allocator->currentSetCount = 0;
+}
+
+VkDescriptorSet descriptor_allocate(DescriptorAllocator *allocator, VkDescriptorSetLayout layout) {
+    for (;;) {
+        VkDescriptorSetAllocateInfo allocInfo = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .descriptorPool = allocator->pools[allocator->current],
+            .descriptorSetCount = 1,
+            .pSetLayouts = &layout
+        };
+        VkDescriptorSet set;
+        VkResult result = vkAllocateDescriptorSets(device, &allocInfo, &set);
+        if (result == VK_SUCCESS) {
+            allocator->currentSetCount++;
+            return set;
+        }
+        if (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL) {
+            VK(result);
+        }
+
+        // an empty pool that can't fit the set never will
+        if (allocator->currentSetCount == 0) {
+            fprintf(stderr, "Fatal: descriptor set layout does not fit in an empty pool\n");
+            exit(1);
+        }
+
+        allocator->current++;
+        allocator->currentSetCount = 0;
+        if (allocator->current == allocator->poolCount) {
+            if (allocator->poolCount == allocator->poolCapacity) {
+                allocator->poolCapacity *= 2;
+                allocator->pools = realloc(allocator->pools, sizeof(VkDescriptorPool) * allocator->poolCapacity);
+            }
+            allocator->pools[allocator->poolCount++] = create_pool();
+        }
+    }
+}
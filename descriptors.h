@@ -0,0 +1,27 @@
+#ifndef VULK_DESCRIPTORS_H
+#define VULK_DESCRIPTORS_H
+
+#include "vulk.h"
+
+// linear allocator for transient descriptor sets (compute dispatches, post passes). sets
+// are never freed one by one: allocation bumps through a chain of pools, growing it when
+// a pool runs out, and the whole chain is reset at once when its frame slot comes round
+#define DESCRIPTOR_SETS_PER_POOL 256
+
+typedef struct DescriptorAllocator {
+    VkDescriptorPool *pools;
+    uint32_t poolCount;
+    uint32_t poolCapacity;
+    uint32_t current; // pools before this one are full
+    uint32_t currentSetCount;
+} DescriptorAllocator;
+
+void descriptor_allocator_init(DescriptorAllocator *allocator);
+void descriptor_allocator_destroy(DescriptorAllocator *allocator);
+
+// the sets handed out since the last reset must no longer be in use by the GPU
+void descriptor_allocator_reset(DescriptorAllocator *allocator);
+
+VkDescriptorSet descriptor_allocate(DescriptorAllocator *allocator, VkDescriptorSetLayout layout);
+
+#endif
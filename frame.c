@@ -0,0 +1,72 @@
+#include "frame.h"
+
+Frame frames[MAX_FRAMES_IN_FLIGHT];
+uint32_t framesInFlight = 2;
+uint32_t currentFrame = 0;
+uint64_t frameNumber = 0;
+
+void frames_create(uint32_t count) {
+    assert(count > 0 && count <= MAX_FRAMES_IN_FLIGHT);
+    framesInFlight = count;
+    currentFrame = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO
+    };
+
+    for (uint32_t i = 0; i < framesInFlight; i++) {
+        Frame *frame = &frames[i];
+
+        VkCommandPoolCreateInfo poolInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+            .queueFamilyIndex = queueFamilyIdx
+        };
+        VK(vkCreateCommandPool(device, &poolInfo, NULL, &frame->commandPool));
+
+        VkCommandBufferAllocateInfo allocInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = frame->commandPool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = 1
+        };
+        VK(vkAllocateCommandBuffers(device, &allocInfo, &frame->commandBuffer));
+        descriptor_allocator_init(&frame->descriptors);
+
+        VK(vkCreateSemaphore(device, &semaphoreInfo, NULL, &frame->imageAvailableSemaphore));
+        frame->timelineValue = 0;
+    }
+}
+
+void frames_destroy(void) {
+    for (uint32_t i = 0; i < framesInFlight; i++) {
+        Frame *frame = &frames[i];
+        vkDestroySemaphore(device, frame->imageAvailableSemaphore, NULL);
+        vkDestroyCommandPool(device, frame->commandPool, NULL);
+        descriptor_allocator_destroy(&frame->descriptors);
+    }
+}
+
+Frame *frame_begin(void) {
+    Frame *frame = &frames[currentFrame];
+
+    timeline_wait(&graphicsTimeline, frame->timelineValue);
+
+    // one reset for everything recorded from this slot last time round
+    VK(vkResetCommandPool(device, frame->commandPool, 0));
+    descriptor_allocator_reset(&frame->descriptors);
+    return frame;
+}
+
+void frame_submit(Frame *frame, TimelineSubmit *submit) {
+    frame->timelineValue = timeline_submit(&graphicsTimeline, graphicsQueue, submit, 1, &frame->commandBuffer);
+}
+
+VkDescriptorSet frame_allocate_descriptors(VkDescriptorSetLayout layout) {
+    return descriptor_allocate(&frames[currentFrame].descriptors, layout);
+}
+
+void frame_end(void) {
+    currentFrame = (currentFrame + 1) % framesInFlight;
+    frameNumber++;
+}
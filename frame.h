@@ -0,0 +1,44 @@
+#ifndef VULK_FRAME_H
+#define VULK_FRAME_H
+
+#include "vulk.h"
+#include "descriptors.h"
+#include "timeline.h"
+
+#define MAX_FRAMES_IN_FLIGHT 8
+
+// everything the CPU touches while recording one frame. a slot is only reused once
+// graphicsTimeline has reached its last submission, so the CPU can record frame N+1
+// while the GPU runs frame N
+typedef struct Frame {
+    VkCommandPool commandPool;
+    VkCommandBuffer commandBuffer;
+    // transient descriptor sets, reset together with the command pool
+    DescriptorAllocator descriptors;
+    VkSemaphore imageAvailableSemaphore;
+    // graphicsTimeline value of the slot's last submission, 0 before the first
+    uint64_t timelineValue;
+} Frame;
+
+extern Frame frames[MAX_FRAMES_IN_FLIGHT];
+extern uint32_t framesInFlight;
+extern uint32_t currentFrame;
+
+// count of frames ended so far, work retired at frame F is safe to free
+// once frameNumber >= F + framesInFlight
+extern uint64_t frameNumber;
+
+void frames_create(uint32_t count);
+void frames_destroy(void);
+
+// waits for the slot's previous submission and resets its command pool. a frame abandoned
+// before submit (out of date swapchain) keeps its old value, so the next wait passes at once
+Frame *frame_begin(void);
+// submits the slot's command buffer on graphicsQueue and records the value it signals
+void frame_submit(Frame *frame, TimelineSubmit *submit);
+
+// a descriptor set valid until this frame slot is begun again
+VkDescriptorSet frame_allocate_descriptors(VkDescriptorSetLayout layout);
+void frame_end(void);
+
+#endif
@@ -0,0 +1,593 @@
+#include <string.h>
+#include "graph.h"
+#include "allocator.h"
+#include "deletion.h"
+
+#define GRAPH_NO_TRANSIENT UINT32_MAX
+
+typedef struct GraphAccessInfo {
+    VkPipelineStageFlags stages;
+    VkAccessFlags access;
+    VkImageLayout layout;
+    bool write;
+} GraphAccessInfo;
+
+static const GraphAccessInfo accessInfos[GRAPH_ACCESS_COUNT] = {
+    [GRAPH_ACCESS_NONE] = {0, 0, VK_IMAGE_LAYOUT_UNDEFINED, false},
+    // a write without access, so the first use waits at the stage the acquire semaphore unblocks
+    [GRAPH_ACQUIRED] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED, true},
+    [GRAPH_PRESENT] = {VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, false},
+    [GRAPH_COLOR_ATTACHMENT_WRITE] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true},
+    [GRAPH_DEPTH_ATTACHMENT_WRITE] = {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, true},
+    [GRAPH_DEPTH_ATTACHMENT_READ] = {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, false},
+    [GRAPH_SAMPLED_READ] = {VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false},
+    [GRAPH_STORAGE_READ] = {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, false},
+    [GRAPH_STORAGE_WRITE] = {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        VK_IMAGE_LAYOUT_GENERAL, true},
+    [GRAPH_TRANSFER_READ] = {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false},
+    [GRAPH_TRANSFER_WRITE] = {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true},
+    [GRAPH_INDIRECT_READ] = {VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+        VK_IMAGE_LAYOUT_UNDEFINED, false},
+    [GRAPH_VERTEX_READ] = {VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+        VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false},
+    [GRAPH_MESH_READ] = {VK_PIPELINE_STAGE_MESH_SHADER_BIT_EXT, VK_ACCESS_SHADER_READ_BIT,
+        VK_IMAGE_LAYOUT_UNDEFINED, false}
+};
+
+// what the next use of a resource has to synchronize with
+typedef struct GraphState {
+    VkImageLayout layout;
+    VkPipelineStageFlags writeStages; // last write (or layout transition)
+    VkAccessFlags writeAccess;
+    VkPipelineStageFlags readStages; // reads since that write
+    VkPipelineStageFlags visibleStages; // stages and accesses the write has been made visible to
+    VkAccessFlags visibleAccess;
+} GraphState;
+
+// a transient image as placed by the last plan, kept for as long as the plan does not change
+typedef struct GraphTransient {
+    GraphImageDesc desc;
+    uint32_t firstPass; // lifetime among the passes that survived culling
+    uint32_t lastPass;
+    VkImage image;
+    VkImageView view;
+    VkMemoryRequirements requirements;
+    uint32_t block;
+} GraphTransient;
+
+// memory shared by transients whose lifetimes do not overlap, each bound at offset 0
+typedef struct GraphMemoryBlock {
+    Allocation *allocation;
+    VkMemoryRequirements requirements;
+    bool lazy;
+    // the last accesses through any of its images, the next image placed here waits on them.
+    // carried over between frames
+    GraphState state;
+} GraphMemoryBlock;
+
+typedef struct GraphResourceData {
+    bool isImage;
+    bool imported;
+    bool needed; // culling
+    VkImage image;
+    VkImageView view;
+    VkImageAspectFlags aspect;
+    VkBuffer buffer;
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    GraphAccess after;
+    GraphImageDesc desc;
+    uint32_t transient;
+    bool started;
+    GraphState state;
+} GraphResourceData;
+
+typedef struct GraphUse {
+    GraphResource resource;
+    GraphAccess access;
+} GraphUse;
+
+typedef struct GraphPassData {
+    const char *name;
+    GraphPassFunction function;
+    void *user;
+    bool keep;
+    GraphUse uses[GRAPH_MAX_USES];
+    uint32_t useCount;
+} GraphPassData;
+
+// one pass's barriers, buffers share a global memory barrier
+typedef struct GraphBarriers {
+    VkPipelineStageFlags srcStages;
+    VkPipelineStageFlags dstStages;
+    VkMemoryBarrier memory;
+    VkImageMemoryBarrier images[GRAPH_MAX_RESOURCES];
+    uint32_t imageCount;
+} GraphBarriers;
+
+static GraphResourceData resources[GRAPH_MAX_RESOURCES];
+static uint32_t resourceCount;
+static GraphPassData passes[GRAPH_MAX_PASSES];
+static uint32_t passCount;
+static GraphTransient transients[GRAPH_MAX_RESOURCES];
+static uint32_t transientCount;
+static GraphMemoryBlock blocks[GRAPH_MAX_RESOURCES];
+static uint32_t blockCount;
+
+static GraphState initial_state(GraphAccess access) {
+    const GraphAccessInfo *info = &accessInfos[access];
+    GraphState state = {
+        .layout = info->layout
+    };
+    if (info->write) {
+        state.writeStages = info->stages;
+        state.writeAccess = info->access;
+    } else {
+        state.readStages = info->stages;
+        state.visibleStages = info->stages;
+        state.visibleAccess = info->access;
+    }
+    return state;
+}
+
+void graph_init(void) {
+    resourceCount = 0;
+    passCount = 0;
+    transientCount = 0;
+    blockCount = 0;
+}
+
+// frames in flight may still use them
+static void release_transients(void) {
+    for (uint32_t i = 0; i < transientCount; i++) {
+        deletion_image_view(transients[i].view);
+        deletion_image(transients[i].image);
+    }
+    for (uint32_t i = 0; i < blockCount; i++) {
+        deletion_allocation(blocks[i].allocation);
+    }
+    transientCount = 0;
+    blockCount = 0;
+}
+
+void graph_destroy(void) {
+    release_transients();
+}
+
+void graph_begin(void) {
+    resourceCount = 0;
+    passCount = 0;
+}
+
+static GraphResource add_resource(GraphResourceData data) {
+    assert(resourceCount < GRAPH_MAX_RESOURCES);
+    resources[resourceCount] = data;
+    return resourceCount++;
+}
+
+GraphResource graph_import_image(VkImage image, VkImageView view, VkImageAspectFlags aspect,
+    GraphAccess before, GraphAccess after) {
+    GraphResourceData data = {
+        .isImage = true,
+        .imported = true,
+        .image = image,
+        .view = view,
+        .aspect = aspect,
+        .after = after,
+        .transient = GRAPH_NO_TRANSIENT,
+        .state = initial_state(before)
+    };
+    return add_resource(data);
+}
+
+GraphResource graph_import_buffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size,
+    GraphAccess before, GraphAccess after) {
+    GraphResourceData data = {
+        .isImage = false,
+        .imported = true,
+        .buffer = buffer,
+        .offset = offset,
+        .size = size,
+        .after = after,
+        .transient = GRAPH_NO_TRANSIENT,
+        .state = initial_state(before)
+    };
+    return add_resource(data);
+}
+
+GraphResource graph_create_image(const GraphImageDesc *desc) {
+    GraphResourceData data = {
+        .isImage = true,
+        .imported = false,
+        .aspect = desc->aspect,
+        .after = GRAPH_ACCESS_NONE,
+        .desc = *desc,
+        .transient = GRAPH_NO_TRANSIENT
+    };
+    return add_resource(data);
+}
+
+VkImage graph_image(GraphResource resource) {
+    assert(resource < resourceCount && resources[resource].isImage);
+    return resources[resource].image;
+}
+
+VkImageView graph_image_view(GraphResource resource) {
+    assert(resource < resourceCount && resources[resource].isImage);
+    return resources[resource].view;
+}
+
+VkBuffer graph_buffer(GraphResource resource) {
+    assert(resource < resourceCount && !resources[resource].isImage);
+    return resources[resource].buffer;
+}
+
+GraphPass graph_add_pass(const char *name, GraphPassFunction function, void *user) {
+    assert(passCount < GRAPH_MAX_PASSES);
+    GraphPassData pass = {
+        .name = name,
+        .function = function,
+        .user = user
+    };
+    passes[passCount] = pass;
+    return passCount++;
+}
+
+void graph_use(GraphPass pass, GraphResource resource, GraphAccess access) {
+    assert(pass < passCount && resource < resourceCount);
+    GraphPassData *data = &passes[pass];
+    assert(data->useCount < GRAPH_MAX_USES);
+    GraphUse use = {
+        .resource = resource,
+        .access = access
+    };
+    data->uses[data->useCount++] = use;
+}
+
+void graph_keep(GraphPass pass) {
+    assert(pass < passCount);
+    passes[pass].keep = true;
+}
+
+// walks the passes backwards from the imported resources, a pass survives if something
+// after it reads what it writes. partial writes keep every earlier writer alive
+static void cull(bool *alive) {
+    for (uint32_t r = 0; r < resourceCount; r++) {
+        resources[r].needed = resources[r].imported;
+    }
+    for (uint32_t p = passCount; p-- > 0;) {
+        GraphPassData *pass = &passes[p];
+        alive[p] = pass->keep;
+        for (uint32_t u = 0; u < pass->useCount && !alive[p]; u++) {
+            alive[p] = accessInfos[pass->uses[u].access].write && resources[pass->uses[u].resource].needed;
+        }
+        if (!alive[p]) {
+            continue;
+        }
+        for (uint32_t u = 0; u < pass->useCount; u++) {
+            if (!accessInfos[pass->uses[u].access].write) {
+                resources[pass->uses[u].resource].needed = true;
+            }
+        }
+    }
+}
+
+static bool lifetimes_overlap(const GraphTransient *a, const GraphTransient *b) {
+    return a->firstPass <= b->lastPass && b->firstPass <= a->lastPass;
+}
+
+static bool is_lazy(const GraphTransient *transient) {
+    return (transient->desc.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) != 0;
+}
+
+// largest first, each into the first block it fits without overlapping anything already there
+static void assign_blocks(void) {
+    uint32_t order[GRAPH_MAX_RESOURCES];
+    for (uint32_t i = 0; i < transientCount; i++) {
+        uint32_t j = i;
+        for (; j > 0 && transients[order[j - 1]].requirements.size < transients[i].requirements.size; j--) {
+            order[j] = order[j - 1];
+        }
+        order[j] = i;
+    }
+
+    for (uint32_t i = 0; i < transientCount; i++) {
+        GraphTransient *transient = &transients[order[i]];
+        transient->block = GRAPH_NO_TRANSIENT;
+        for (uint32_t b = 0; b < blockCount && transient->block == GRAPH_NO_TRANSIENT; b++) {
+            GraphMemoryBlock *block = &blocks[b];
+            bool fits = block->lazy == is_lazy(transient) &&
+                (block->requirements.memoryTypeBits & transient->requirements.memoryTypeBits) != 0;
+            for (uint32_t j = 0; j < i && fits; j++) {
+                const GraphTransient *other = &transients[order[j]];
+                fits = other->block != b || !lifetimes_overlap(transient, other);
+            }
+            if (fits) {
+                transient->block = b;
+            }
+        }
+        if (transient->block == GRAPH_NO_TRANSIENT) {
+            GraphMemoryBlock block = {
+                .requirements = transient->requirements,
+                .lazy = is_lazy(transient)
+            };
+            blocks[blockCount] = block;
+            transient->block = blockCount++;
+            continue;
+        }
+        VkMemoryRequirements *requirements = &blocks[transient->block].requirements;
+        if (transient->requirements.size > requirements->size) {
+            requirements->size = transient->requirements.size;
+        }
+        if (transient->requirements.alignment > requirements->alignment) {
+            requirements->alignment = transient->requirements.alignment;
+        }
+        requirements->memoryTypeBits &= transient->requirements.memoryTypeBits;
+    }
+}
+
+// returns whether the memory is lazily allocated
+static bool allocate_block(GraphMemoryBlock *block) {
+    block->allocation = NULL;
+    if (block->lazy) {
+        // only tile-based GPUs tend to have lazily allocated memory, it may never be backed at all
+        block->allocation = allocator_alloc(&block->requirements,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, ALLOCATION_OPTIMAL, true);
+    }
+    bool lazilyAllocated = block->allocation != NULL;
+    if (block->allocation == NULL) {
+        block->allocation = allocator_alloc(&block->requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            ALLOCATION_OPTIMAL, true);
+    }
+    if (block->allocation == NULL) {
+        fprintf(stderr, "Fatal: out of memory for %llu bytes of render targets\n",
+            (unsigned long long) block->requirements.size);
+        exit(1);
+    }
+    GraphState state = {
+        .layout = VK_IMAGE_LAYOUT_UNDEFINED
+    };
+    block->state = state;
+    return lazilyAllocated;
+}
+
+static void create_transients(void) {
+    VkDeviceSize unaliasedSize = 0;
+    for (uint32_t i = 0; i < transientCount; i++) {
+        GraphTransient *transient = &transients[i];
+        VkImageCreateInfo imageInfo = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+            .imageType = VK_IMAGE_TYPE_2D,
+            .format = transient->desc.format,
+            .extent = {transient->desc.extent.width, transient->desc.extent.height, 1},
+            .mipLevels = 1,
+            .arrayLayers = 1,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .tiling = VK_IMAGE_TILING_OPTIMAL,
+            .usage = transient->desc.usage,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+        };
+        VK(vkCreateImage(device, &imageInfo, NULL, &transient->image));
+        vkGetImageMemoryRequirements(device, transient->image, &transient->requirements);
+        unaliasedSize += transient->requirements.size;
+    }
+
+    assign_blocks();
+    VkDeviceSize aliasedSize = 0;
+    uint32_t lazyCount = 0;
+    for (uint32_t i = 0; i < blockCount; i++) {
+        if (allocate_block(&blocks[i])) {
+            lazyCount++;
+        }
+        aliasedSize += blocks[i].requirements.size;
+    }
+
+    for (uint32_t i = 0; i < transientCount; i++) {
+        GraphTransient *transient = &transients[i];
+        Allocation *allocation = blocks[transient->block].allocation;
+        VK(vkBindImageMemory(device, transient->image, allocation->memory, allocation->offset));
+
+        VkImageViewCreateInfo viewInfo = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            .image = transient->image,
+            .viewType = VK_IMAGE_VIEW_TYPE_2D,
+            .format = transient->desc.format,
+            .subresourceRange.aspectMask = transient->desc.aspect,
+            .subresourceRange.levelCount = 1,
+            .subresourceRange.layerCount = 1
+        };
+        VK(vkCreateImageView(device, &viewInfo, NULL, &transient->view));
+    }
+    printf("graph: %u transient images in %u memory blocks (%u lazily allocated), %llu KiB, %llu KiB unaliased\n",
+        transientCount, blockCount, lazyCount, (unsigned long long) (aliasedSize / 1024),
+        (unsigned long long) (unaliasedSize / 1024));
+}
+
+// works out the lifetime of each transient that survived culling. the images and their
+// memory are rebuilt only when that differs from the last plan, e.g. after a resize
+static void plan_transients(const bool *alive) {
+    GraphTransient planned[GRAPH_MAX_RESOURCES];
+    uint32_t plannedCount = 0;
+    for (uint32_t r = 0; r < resourceCount; r++) {
+        GraphResourceData *resource = &resources[r];
+        if (resource->imported) {
+            continue;
+        }
+        GraphTransient transient = {
+            .desc = resource->desc,
+            .firstPass = GRAPH_NO_TRANSIENT
+        };
+        for (uint32_t p = 0; p < passCount; p++) {
+            for (uint32_t u = 0; u < passes[p].useCount && alive[p]; u++) {
+                if (passes[p].uses[u].resource == r) {
+                    transient.firstPass = transient.firstPass == GRAPH_NO_TRANSIENT ? p : transient.firstPass;
+                    transient.lastPass = p;
+                }
+            }
+        }
+        if (transient.firstPass != GRAPH_NO_TRANSIENT) {
+            resource->transient = plannedCount;
+            planned[plannedCount++] = transient;
+        }
+    }
+
+    bool same = plannedCount == transientCount;
+    for (uint32_t i = 0; i < plannedCount && same; i++) {
+        same = memcmp(&planned[i].desc, &transients[i].desc, sizeof(GraphImageDesc)) == 0 &&
+            planned[i].firstPass == transients[i].firstPass && planned[i].lastPass == transients[i].lastPass;
+    }
+    if (!same) {
+        release_transients();
+        memcpy(transients, planned, sizeof(GraphTransient) * plannedCount);
+        transientCount = plannedCount;
+        create_transients();
+    }
+
+    for (uint32_t r = 0; r < resourceCount; r++) {
+        GraphResourceData *resource = &resources[r];
+        if (resource->transient != GRAPH_NO_TRANSIENT) {
+            resource->image = transients[resource->transient].image;
+            resource->view = transients[resource->transient].view;
+        }
+    }
+}
+
+// contents start out undefined, but whatever last used the memory has to finish first
+static void begin_transient(GraphResourceData *resource) {
+    if (resource->started) {
+        return;
+    }
+    resource->started = true;
+    resource->state = blocks[transients[resource->transient].block].state;
+    resource->state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+}
+
+static void add_barrier(GraphBarriers *barriers, GraphResourceData *resource, GraphAccess access) {
+    const GraphAccessInfo *info = &accessInfos[access];
+    GraphState *state = &resource->state;
+    bool transition = resource->isImage && info->layout != state->layout && info->layout != VK_IMAGE_LAYOUT_UNDEFINED;
+
+    VkPipelineStageFlags srcStages = 0;
+    VkAccessFlags srcAccess = 0;
+    if (info->write || transition) {
+        // writes and layout transitions wait for everything since the last write
+        srcStages = state->writeStages | state->readStages;
+        srcAccess = state->writeAccess;
+        state->writeStages = info->stages;
+        state->writeAccess = info->write ? info->access & (VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT) : 0;
+        state->readStages = 0;
+        state->visibleStages = info->stages;
+        state->visibleAccess = info->access;
+    } else if (state->writeStages != 0 &&
+        ((info->stages & ~state->visibleStages) || (info->access & ~state->visibleAccess))) {
+        // first read in these stages since the write
+        srcStages = state->writeStages;
+        srcAccess = state->writeAccess;
+        state->visibleStages |= info->stages;
+        state->visibleAccess |= info->access;
+    }
+    VkImageLayout oldLayout = state->layout;
+    if (!info->write && !transition) {
+        state->readStages |= info->stages;
+    }
+    if (transition) {
+        state->layout = info->layout;
+    }
+    if (srcStages == 0 && !transition) {
+        return;
+    }
+
+    barriers->srcStages |= srcStages;
+    barriers->dstStages |= info->stages;
+    if (!resource->isImage) {
+        barriers->memory.srcAccessMask |= srcAccess;
+        barriers->memory.dstAccessMask |= info->access;
+        return;
+    }
+    VkImageMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = srcAccess,
+        .dstAccessMask = info->access,
+        .oldLayout = oldLayout,
+        .newLayout = state->layout,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = resource->image,
+        .subresourceRange.aspectMask = resource->aspect,
+        .subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS,
+        .subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS
+    };
+    barriers->images[barriers->imageCount++] = barrier;
+}
+
+static void record_barriers(VkCommandBuffer commandBuffer, GraphBarriers *barriers) {
+    if (barriers->dstStages == 0) {
+        return;
+    }
+    bool memory = barriers->memory.srcAccessMask != 0 || barriers->memory.dstAccessMask != 0;
+    vkCmdPipelineBarrier(commandBuffer,
+        barriers->srcStages ? barriers->srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, barriers->dstStages,
+        0, memory ? 1 : 0, &barriers->memory, 0, NULL, barriers->imageCount, barriers->images);
+}
+
+static void reset_barriers(GraphBarriers *barriers) {
+    VkMemoryBarrier memory = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER
+    };
+    barriers->srcStages = 0;
+    barriers->dstStages = 0;
+    barriers->memory = memory;
+    barriers->imageCount = 0;
+}
+
+void graph_execute(VkCommandBuffer commandBuffer) {
+    bool alive[GRAPH_MAX_PASSES];
+    cull(alive);
+    plan_transients(alive);
+
+    GraphBarriers barriers;
+    for (uint32_t p = 0; p < passCount; p++) {
+        if (!alive[p]) {
+            continue;
+        }
+        GraphPassData *pass = &passes[p];
+        reset_barriers(&barriers);
+        for (uint32_t u = 0; u < pass->useCount; u++) {
+            GraphResourceData *resource = &resources[pass->uses[u].resource];
+            if (resource->transient != GRAPH_NO_TRANSIENT) {
+                begin_transient(resource);
+            }
+            add_barrier(&barriers, resource, pass->uses[u].access);
+        }
+        record_barriers(commandBuffer, &barriers);
+        pass->function(commandBuffer, pass->user);
+
+        // the memory is free for the next transient placed in it
+        for (uint32_t u = 0; u < pass->useCount; u++) {
+            GraphResourceData *resource = &resources[pass->uses[u].resource];
+            if (resource->transient != GRAPH_NO_TRANSIENT && transients[resource->transient].lastPass == p) {
+                blocks[transients[resource->transient].block].state = resource->state;
+            }
+        }
+    }
+
+    // hand imported resources over in the state they were promised in
+    reset_barriers(&barriers);
+    for (uint32_t r = 0; r < resourceCount; r++) {
+        GraphResourceData *resource = &resources[r];
+        if (resource->imported && resource->after != GRAPH_ACCESS_NONE) {
+            add_barrier(&barriers, resource, resource->after);
+        }
+    }
+    record_barriers(commandBuffer, &barriers);
+}
@@ -0,0 +1,76 @@
+#ifndef VULK_GRAPH_H
+#define VULK_GRAPH_H
+
+#include "vulk.h"
+
+// per-frame render graph. passes are added in execution order together with the images and
+// buffers they use, and graph_execute records them with the synchronization derived from
+// those uses: one batched barrier in front of each pass covering exactly the hazards and
+// layout changes since each resource's previous use. passes whose results nothing reads
+// are dropped. imported resources (swapchain image, persistent buffers) outlive the graph,
+// transient images belong to it: transients whose lifetimes (first to last surviving use)
+// do not overlap share memory, and attachments with TRANSIENT_ATTACHMENT usage go into
+// lazily allocated memory where the device has it. main thread only
+#define GRAPH_MAX_PASSES 32
+#define GRAPH_MAX_RESOURCES 32
+#define GRAPH_MAX_USES 8
+
+typedef enum GraphAccess {
+    GRAPH_ACCESS_NONE, // contents undefined before, or not needed after the graph
+    GRAPH_ACQUIRED, // swapchain image, ready once the acquire semaphore wait at color output passes
+    GRAPH_PRESENT,
+    GRAPH_COLOR_ATTACHMENT_WRITE,
+    GRAPH_DEPTH_ATTACHMENT_WRITE,
+    GRAPH_DEPTH_ATTACHMENT_READ,
+    GRAPH_SAMPLED_READ, // fragment and compute shaders
+    GRAPH_STORAGE_READ, // compute shaders
+    GRAPH_STORAGE_WRITE,
+    GRAPH_TRANSFER_READ,
+    GRAPH_TRANSFER_WRITE,
+    GRAPH_INDIRECT_READ,
+    GRAPH_VERTEX_READ, // vertex and index buffers
+    GRAPH_MESH_READ, // storage buffers read by mesh shaders, only with them enabled
+    GRAPH_ACCESS_COUNT
+} GraphAccess;
+
+typedef uint32_t GraphResource;
+typedef uint32_t GraphPass;
+
+typedef void (*GraphPassFunction)(VkCommandBuffer commandBuffer, void *user);
+
+typedef struct GraphImageDesc {
+    VkFormat format;
+    VkExtent2D extent;
+    VkImageUsageFlags usage;
+    VkImageAspectFlags aspect;
+} GraphImageDesc;
+
+void graph_init(void);
+void graph_destroy(void);
+
+// starts a new graph. transient images are kept as long as the next graph declares the same
+// ones with the same lifetimes
+void graph_begin(void);
+
+// before is the state the resource arrives in, after the state graph_execute leaves it in
+GraphResource graph_import_image(VkImage image, VkImageView view, VkImageAspectFlags aspect,
+    GraphAccess before, GraphAccess after);
+GraphResource graph_import_buffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size,
+    GraphAccess before, GraphAccess after);
+
+// an image only valid during this graph, its contents are undefined at its first use.
+// it is only created by graph_execute, so graph_image and graph_image_view are for the passes
+GraphResource graph_create_image(const GraphImageDesc *desc);
+
+VkImage graph_image(GraphResource resource);
+VkImageView graph_image_view(GraphResource resource);
+VkBuffer graph_buffer(GraphResource resource);
+
+GraphPass graph_add_pass(const char *name, GraphPassFunction function, void *user);
+void graph_use(GraphPass pass, GraphResource resource, GraphAccess access);
+// never culled, for passes with effects outside the graph
+void graph_keep(GraphPass pass);
+
+void graph_execute(VkCommandBuffer commandBuffer);
+
+#endif
@@ -0,0 +1,273 @@
+#include "hiz.h"
+#include "allocator.h"
+#include "bindless.h"
+#include "deletion.h"
+#include "frame.h"
+#include "pipeline_cache.h"
+
+// sources up to this size in both dimensions are reduced to 1x1 by a single workgroup,
+// mirrored in shaders/hiz.comp
+#define HIZ_TAIL_SIZE 32
+#define HIZ_GROUP_SIZE 8
+
+// mirrored by PushConstants in shaders/hiz.comp
+typedef struct HizPushConstants {
+    int32_t srcSize[2];
+    uint32_t level;
+    uint32_t levelCount;
+} HizPushConstants;
+
+uint32_t hizTexture = BINDLESS_INVALID;
+uint32_t hizSampler = BINDLESS_INVALID;
+uint32_t hizLevels;
+
+static VkDescriptorSetLayout setLayout;
+static VkPipelineLayout layout;
+static VkPipeline pipeline;
+static VkSampler sampler; // nearest, the shaders only fetch texels
+static Allocation *pyramid;
+static VkImageView pyramidView; // every level, for sampling
+static VkImageView levelViews[HIZ_MAX_LEVELS]; // one level each, for storage
+static VkExtent2D depthExtent; // the pyramid was built for
+
+static VkExtent2D level_extent(uint32_t level) {
+    VkExtent2D extent = {
+        .width = depthExtent.width >> (level + 1),
+        .height = depthExtent.height >> (level + 1)
+    };
+    extent.width = extent.width > 0 ? extent.width : 1;
+    extent.height = extent.height > 0 ? extent.height : 1;
+    return extent;
+}
+
+void hiz_init(void) {
+    VkSamplerCreateInfo samplerInfo = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .magFilter = VK_FILTER_NEAREST,
+        .minFilter = VK_FILTER_NEAREST,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .maxLod = VK_LOD_CLAMP_NONE
+    };
+    VK(vkCreateSampler(device, &samplerInfo, NULL, &sampler));
+    hizSampler = bindless_add_sampler(sampler);
+
+    VkDescriptorSetLayoutBinding bindings[] = {
+        {
+            .binding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .pImmutableSamplers = &sampler
+        },
+        {
+            .binding = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .descriptorCount = HIZ_MAX_LEVELS,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+        }
+    };
+    VkDescriptorSetLayoutCreateInfo setLayoutInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = 2,
+        .pBindings = bindings
+    };
+    VK(vkCreateDescriptorSetLayout(device, &setLayoutInfo, NULL, &setLayout));
+
+    VkPushConstantRange pushConstantRange = {
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = sizeof(HizPushConstants)
+    };
+    VkPipelineLayoutCreateInfo layoutInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &setLayout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &pushConstantRange
+    };
+    VK(vkCreatePipelineLayout(device, &layoutInfo, NULL, &layout));
+
+    VkShaderModule shader = read_shader("../shaders/hiz.spv");
+    VkComputePipelineCreateInfo pipelineInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .stage = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .module = shader,
+            .pName = "main"
+        },
+        .layout = layout,
+        .basePipelineIndex = -1
+    };
+    VK(vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, NULL, &pipeline));
+    vkDestroyShaderModule(device, shader, NULL);
+
+    pyramid = NULL;
+    hizLevels = 0;
+}
+
+// the pyramid in use by frames in flight retires with them, once idle it goes at once
+static void release_pyramid(bool idle) {
+    if (pyramid == NULL) {
+        return;
+    }
+    bindless_release(BINDLESS_TEXTURE, hizTexture);
+    hizTexture = BINDLESS_INVALID;
+    for (uint32_t i = 0; i < hizLevels; i++) {
+        if (idle) {
+            vkDestroyImageView(device, levelViews[i], NULL);
+        } else {
+            deletion_image_view(levelViews[i]);
+        }
+    }
+    if (idle) {
+        vkDestroyImageView(device, pyramidView, NULL);
+        allocator_free(pyramid);
+    } else {
+        deletion_image_view(pyramidView);
+        deletion_allocation(pyramid);
+    }
+    pyramid = NULL;
+    hizLevels = 0;
+}
+
+void hiz_destroy(void) {
+    release_pyramid(true);
+    if (hizSampler != BINDLESS_INVALID) {
+        bindless_release(BINDLESS_SAMPLER, hizSampler);
+        hizSampler = BINDLESS_INVALID;
+    }
+    vkDestroyPipeline(device, pipeline, NULL);
+    vkDestroyPipelineLayout(device, layout, NULL);
+    vkDestroyDescriptorSetLayout(device, setLayout, NULL);
+    vkDestroySampler(device, sampler, NULL);
+}
+
+void hiz_update(void) {
+    if (pyramid != NULL && depthExtent.width == swapChainExtent.width && depthExtent.height == swapChainExtent.height) {
+        return;
+    }
+    release_pyramid(false);
+
+    depthExtent = swapChainExtent;
+    uint32_t largest = depthExtent.width > depthExtent.height ? depthExtent.width : depthExtent.height;
+    hizLevels = 1;
+    while ((largest >> hizLevels) > 1 && hizLevels < HIZ_MAX_LEVELS) {
+        hizLevels++;
+    }
+
+    VkExtent2D extent = level_extent(0);
+    VkImageCreateInfo imageInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = VK_FORMAT_R32_SFLOAT,
+        .extent = {extent.width, extent.height, 1},
+        .mipLevels = hizLevels,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+    };
+    pyramid = allocator_create_image(&imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    VkImageViewCreateInfo viewInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image = pyramid->image,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = VK_FORMAT_R32_SFLOAT,
+        .subresourceRange = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .baseMipLevel = 0,
+            .levelCount = hizLevels,
+            .baseArrayLayer = 0,
+            .layerCount = 1
+        }
+    };
+    VK(vkCreateImageView(device, &viewInfo, NULL, &pyramidView));
+    for (uint32_t i = 0; i < hizLevels; i++) {
+        viewInfo.subresourceRange.baseMipLevel = i;
+        viewInfo.subresourceRange.levelCount = 1;
+        VK(vkCreateImageView(device, &viewInfo, NULL, &levelViews[i]));
+    }
+    hizTexture = bindless_add_texture(pyramidView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+}
+
+GraphResource hiz_import(void) {
+    return graph_import_image(pyramid->image, pyramidView, VK_IMAGE_ASPECT_COLOR_BIT,
+        GRAPH_ACCESS_NONE, GRAPH_ACCESS_NONE);
+}
+
+void hiz_build(VkCommandBuffer commandBuffer, VkImageView depthView) {
+    // the array is written whole, entries past the last level repeat it
+    VkDescriptorImageInfo depthInfo = {
+        .imageView = depthView,
+        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+    };
+    VkDescriptorImageInfo levelInfos[HIZ_MAX_LEVELS];
+    for (uint32_t i = 0; i < HIZ_MAX_LEVELS; i++) {
+        VkDescriptorImageInfo levelInfo = {
+            .imageView = levelViews[i < hizLevels ? i : hizLevels - 1],
+            .imageLayout = VK_IMAGE_LAYOUT_GENERAL
+        };
+        levelInfos[i] = levelInfo;
+    }
+    VkDescriptorSet set = frame_allocate_descriptors(setLayout);
+    VkWriteDescriptorSet writes[] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = set,
+            .dstBinding = 0,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .pImageInfo = &depthInfo
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = set,
+            .dstBinding = 1,
+            .descriptorCount = HIZ_MAX_LEVELS,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .pImageInfo = levelInfos
+        }
+    };
+    vkUpdateDescriptorSets(device, 2, writes, 0, NULL);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0, 1, &set, 0, NULL);
+
+    uint32_t level = 0;
+    while (level < hizLevels) {
+        VkExtent2D src = level == 0 ? depthExtent : level_extent(level - 1);
+        VkExtent2D dst = level_extent(level);
+        bool tail = src.width <= HIZ_TAIL_SIZE && src.height <= HIZ_TAIL_SIZE;
+        HizPushConstants pushConstants = {
+            .srcSize = {(int32_t) src.width, (int32_t) src.height},
+            .level = level,
+            .levelCount = tail ? hizLevels - level : 1
+        };
+        vkCmdPushConstants(commandBuffer, layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+        if (tail) {
+            vkCmdDispatch(commandBuffer, 1, 1, 1);
+        } else {
+            vkCmdDispatch(commandBuffer, (dst.width + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE,
+                (dst.height + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE, 1);
+        }
+        level += pushConstants.levelCount;
+
+        // the next dispatch reads the level just written
+        if (level < hizLevels) {
+            VkMemoryBarrier barrier = {
+                .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+                .dstAccessMask = VK_ACCESS_SHADER_READ_BIT
+            };
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                0, 1, &barrier, 0, NULL, 0, NULL);
+        }
+    }
+}
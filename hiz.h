@@ -0,0 +1,33 @@
+#ifndef VULK_HIZ_H
+#define VULK_HIZ_H
+
+#include "vulk.h"
+#include "graph.h"
+
+// hierarchical depth: a max pyramid over the depth target for occlusion tests. level 0 is half
+// the depth extent rounded down, every level halves the one before down to 1x1, and the last
+// texel of an odd row or column also covers the texel left over, so depth pixel p falls into
+// texel min(p >> (level + 1), size - 1) and each texel holds the farthest depth under it.
+// shaders/hiz.comp builds it with one dispatch per level until the rest fits a single
+// workgroup, which then reduces all remaining levels in shared memory in one go
+#define HIZ_MAX_LEVELS 16
+
+// the pyramid for culling shaders, valid after hiz_update: bindless texture and sampler
+// indices and the level count
+extern uint32_t hizTexture;
+extern uint32_t hizSampler;
+extern uint32_t hizLevels;
+
+void hiz_init(void);
+// after vkDeviceWaitIdle
+void hiz_destroy(void);
+
+// (re)builds the pyramid when swapChainExtent has changed, the old one retires with the frame
+void hiz_update(void);
+// the pyramid as a graph resource, its contents do not outlive the graph
+GraphResource hiz_import(void);
+
+// the body of a pass using depth as GRAPH_SAMPLED_READ and the pyramid as GRAPH_STORAGE_WRITE
+void hiz_build(VkCommandBuffer commandBuffer, VkImageView depthView);
+
+#endif
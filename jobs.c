@@ -0,0 +1,292 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "jobs.h"
+#include "atomics.h"
+#include "thread.h"
+
+#ifdef _MSC_VER
+#define JOBS_THREAD_LOCAL __declspec(thread)
+#else
+#define JOBS_THREAD_LOCAL __thread
+#endif
+
+// power of two, a push onto a full deque runs the job right away instead
+#define JOBS_DEQUE_SIZE 4096
+#define JOBS_DEQUE_MASK (JOBS_DEQUE_SIZE - 1)
+#define JOBS_NOT_A_WORKER 0xffffffffu
+// failed steal rounds before an idle worker goes to sleep
+#define JOBS_SPIN_ROUNDS 64
+
+typedef struct QueuedJob {
+    Job job;
+    JobCounter *counter;
+} QueuedJob;
+
+// chase-lev deque: the owner works the bottom end without locks, thieves race on top with a cas.
+// indices only grow and start at 1 so the owner's bottom - 1 never wraps
+typedef struct JobDeque {
+    volatile uint64_t top;
+    char pad0[64 - sizeof(uint64_t)];
+    volatile uint64_t bottom;
+    char pad1[64 - sizeof(uint64_t)];
+    QueuedJob jobs[JOBS_DEQUE_SIZE];
+} JobDeque;
+
+typedef struct ParallelForRange {
+    ParallelForFunction function;
+    void *user;
+    uint32_t begin;
+    uint32_t end;
+} ParallelForRange;
+
+static uint32_t threadCount;
+static JobDeque *deques;
+static Thread threads[JOBS_MAX_THREADS];
+static volatile uint32_t queuedCount;
+static volatile uint32_t quit;
+static Mutex sleepMutex;
+static Cond sleepCond;
+
+static JOBS_THREAD_LOCAL uint32_t threadIndex = JOBS_NOT_A_WORKER;
+static JOBS_THREAD_LOCAL uint32_t stealSeed;
+
+static void execute(const QueuedJob *queued) {
+    queued->job.function(queued->job.data);
+    if (queued->counter) {
+        atomic_add_u32(&queued->counter->value, (uint32_t) -1);
+    }
+}
+
+static bool deque_push(JobDeque *deque, const QueuedJob *queued) {
+    uint64_t bottom = atomic_load_u64(&deque->bottom);
+    uint64_t top = atomic_load_u64(&deque->top);
+    if (bottom - top >= JOBS_DEQUE_SIZE) {
+        return false;
+    }
+    deque->jobs[bottom & JOBS_DEQUE_MASK] = *queued;
+    atomic_store_u64(&deque->bottom, bottom + 1);
+    return true;
+}
+
+static bool deque_pop(JobDeque *deque, QueuedJob *queued) {
+    uint64_t bottom = atomic_load_u64(&deque->bottom) - 1;
+    atomic_store_u64(&deque->bottom, bottom);
+    uint64_t top = atomic_load_u64(&deque->top);
+    if (top > bottom) {
+        atomic_store_u64(&deque->bottom, bottom + 1);
+        return false;
+    }
+    *queued = deque->jobs[bottom & JOBS_DEQUE_MASK];
+    if (top < bottom) {
+        return true;
+    }
+    // last job, a thief may be taking it at the same time
+    bool won = atomic_cas_u64(&deque->top, &top, top + 1);
+    atomic_store_u64(&deque->bottom, bottom + 1);
+    return won;
+}
+
+static bool deque_steal(JobDeque *deque, QueuedJob *queued) {
+    uint64_t top = atomic_load_u64(&deque->top);
+    uint64_t bottom = atomic_load_u64(&deque->bottom);
+    if (top >= bottom) {
+        return false;
+    }
+    // the slot at top can't be reused by the owner until top moves past it, so the copy is only
+    // stale if the cas fails
+    *queued = deque->jobs[top & JOBS_DEQUE_MASK];
+    return atomic_cas_u64(&deque->top, &top, top + 1);
+}
+
+static bool find_job(QueuedJob *queued) {
+    if (atomic_load_u32(&queuedCount) == 0) {
+        return false;
+    }
+    bool found = deque_pop(&deques[threadIndex], queued);
+    if (!found) {
+        // start at a different victim each time so thieves spread out
+        stealSeed = stealSeed * 1664525u + 1013904223u;
+        uint32_t first = (stealSeed >> 16) % threadCount;
+        for (uint32_t i = 0; i < threadCount && !found; i++) {
+            uint32_t victim = (first + i) % threadCount;
+            if (victim != threadIndex) {
+                found = deque_steal(&deques[victim], queued);
+            }
+        }
+    }
+    if (found) {
+        atomic_add_u32(&queuedCount, (uint32_t) -1);
+    }
+    return found;
+}
+
+static void worker_main(void *arg) {
+    threadIndex = (uint32_t) (uintptr_t) arg;
+    stealSeed = threadIndex;
+
+    uint32_t idleRounds = 0;
+    while (!atomic_load_u32(&quit)) {
+        QueuedJob queued;
+        if (find_job(&queued)) {
+            execute(&queued);
+            idleRounds = 0;
+        } else if (++idleRounds < JOBS_SPIN_ROUNDS) {
+            thread_yield();
+        } else {
+            // jobs_run raises queuedCount before taking the lock to wake us, so checking it
+            // under the lock can't miss a wakeup
+            mutex_lock(&sleepMutex);
+            while (atomic_load_u32(&queuedCount) == 0 && !atomic_load_u32(&quit)) {
+                cond_wait(&sleepCond, &sleepMutex);
+            }
+            mutex_unlock(&sleepMutex);
+            idleRounds = 0;
+        }
+    }
+}
+
+void jobs_init(uint32_t count) {
+    if (count == 0) {
+        count = thread_hardware_concurrency();
+    }
+    threadCount = count < JOBS_MAX_THREADS ? count : JOBS_MAX_THREADS;
+    deques = malloc(sizeof(JobDeque) * threadCount);
+    for (uint32_t i = 0; i < threadCount; i++) {
+        deques[i].top = 1;
+        deques[i].bottom = 1;
+    }
+    queuedCount = 0;
+    quit = 0;
+    mutex_init(&sleepMutex);
+    cond_init(&sleepCond);
+
+    threadIndex = 0;
+    stealSeed = 0;
+    for (uint32_t i = 1; i < threadCount; i++) {
+        thread_create(&threads[i], worker_main, (void *) (uintptr_t) i);
+    }
+    printf("jobs: %u threads\n", threadCount);
+}
+
+void jobs_destroy(void) {
+    assert(threadIndex == 0);
+    mutex_lock(&sleepMutex);
+    atomic_store_u32(&quit, 1);
+    cond_broadcast(&sleepCond);
+    mutex_unlock(&sleepMutex);
+    for (uint32_t i = 1; i < threadCount; i++) {
+        thread_join(&threads[i]);
+    }
+    mutex_destroy(&sleepMutex);
+    cond_destroy(&sleepCond);
+    free(deques);
+    deques = NULL;
+    threadCount = 0;
+    threadIndex = JOBS_NOT_A_WORKER;
+}
+
+uint32_t jobs_thread_count(void) {
+    return threadCount;
+}
+
+uint32_t jobs_thread_index(void) {
+    assert(threadIndex != JOBS_NOT_A_WORKER);
+    return threadIndex;
+}
+
+void jobs_run(const Job *jobs, uint32_t count, JobCounter *counter) {
+    assert(threadIndex != JOBS_NOT_A_WORKER);
+    if (counter) {
+        atomic_add_u32(&counter->value, count);
+    }
+
+    uint32_t pushed = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        QueuedJob queued = {
+            .job = jobs[i],
+            .counter = counter
+        };
+        // counted before it becomes visible so find_job never sees the count go negative
+        atomic_add_u32(&queuedCount, 1);
+        if (deque_push(&deques[threadIndex], &queued)) {
+            pushed++;
+        } else {
+            atomic_add_u32(&queuedCount, (uint32_t) -1);
+            execute(&queued);
+        }
+    }
+
+    if (pushed > 0 && threadCount > 1) {
+        mutex_lock(&sleepMutex);
+        if (pushed == 1) {
+            cond_signal(&sleepCond);
+        } else {
+            cond_broadcast(&sleepCond);
+        }
+        mutex_unlock(&sleepMutex);
+    }
+}
+
+void jobs_wait(JobCounter *counter) {
+    assert(threadIndex != JOBS_NOT_A_WORKER);
+    while (atomic_load_u32(&counter->value) != 0) {
+        QueuedJob queued;
+        if (find_job(&queued)) {
+            execute(&queued);
+        } else {
+            // the rest is running on other threads
+            thread_yield();
+        }
+    }
+}
+
+static void parallel_for_range(void *data) {
+    ParallelForRange *range = data;
+    range->function(range->begin, range->end, range->user);
+}
+
+void jobs_parallel_for(uint32_t count, uint32_t grain, ParallelForFunction function, void *user) {
+    if (count == 0) {
+        return;
+    }
+    if (grain == 0) {
+        // a few ranges per thread so uneven ranges still balance
+        uint32_t ranges = threadCount * 4;
+        grain = (count + ranges - 1) / ranges;
+    }
+    uint32_t rangeCount = (count + grain - 1) / grain;
+    if (rangeCount > JOBS_MAX_RANGES) {
+        grain = (count + JOBS_MAX_RANGES - 1) / JOBS_MAX_RANGES;
+        rangeCount = (count + grain - 1) / grain;
+    }
+    if (rangeCount == 1 || threadCount == 1) {
+        for (uint32_t begin = 0; begin < count; begin += grain) {
+            function(begin, begin + grain < count ? begin + grain : count, user);
+        }
+        return;
+    }
+
+    ParallelForRange ranges[JOBS_MAX_RANGES];
+    Job jobs[JOBS_MAX_RANGES];
+    for (uint32_t i = 0; i < rangeCount; i++) {
+        uint32_t begin = i * grain;
+        ParallelForRange range = {
+            .function = function,
+            .user = user,
+            .begin = begin,
+            .end = begin + grain < count ? begin + grain : count
+        };
+        ranges[i] = range;
+        Job job = {
+            .function = parallel_for_range,
+            .data = &ranges[i]
+        };
+        jobs[i] = job;
+    }
+
+    JobCounter counter = {0};
+    jobs_run(jobs, rangeCount, &counter);
+    jobs_wait(&counter);
+}
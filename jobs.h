@@ -0,0 +1,45 @@
+#ifndef VULK_JOBS_H
+#define VULK_JOBS_H
+
+#include <stdint.h>
+
+// work-stealing job scheduler. every thread (the main thread is thread 0) owns a deque:
+// it pushes and pops its own jobs at the bottom, idle threads steal from the top of others.
+// completion is tracked with counters, a job that depends on others waits on their counter
+// and runs other jobs in the meantime instead of blocking its thread
+#define JOBS_MAX_THREADS 32
+#define JOBS_MAX_RANGES 256
+
+typedef void (*JobFunction)(void *data);
+
+typedef struct JobCounter {
+    volatile uint32_t value;
+} JobCounter;
+
+typedef struct Job {
+    JobFunction function;
+    void *data;
+} Job;
+
+// threadCount includes the main thread, 0 picks one per core
+void jobs_init(uint32_t threadCount);
+void jobs_destroy(void);
+
+uint32_t jobs_thread_count(void);
+// 0 on the main thread, 1..count-1 on workers, only valid on those threads
+uint32_t jobs_thread_index(void);
+
+// queues the jobs on the calling thread's deque, counter (may be NULL) is raised by count
+// and dropped by one as each job finishes. main thread and jobs only
+void jobs_run(const Job *jobs, uint32_t count, JobCounter *counter);
+
+// runs queued jobs until the counter reaches zero
+void jobs_wait(JobCounter *counter);
+
+// calls function over [0, count) in ranges of about grain items (0 picks one) across all
+// threads and returns when every range is done. ranges start at multiples of the grain, which
+// is raised if it would make more than JOBS_MAX_RANGES ranges
+typedef void (*ParallelForFunction)(uint32_t begin, uint32_t end, void *user);
+void jobs_parallel_for(uint32_t count, uint32_t grain, ParallelForFunction function, void *user);
+
+#endif
@@ -0,0 +1,201 @@
+#include <math.h>
+#include <string.h>
+#include "lod.h"
+#include "allocator.h"
+#include "bindless.h"
+#include "cull.h"
+#include "frame.h"
+#include "timer.h"
+
+bool lodRequested = true;
+float lodPixelError = 1.0f;
+uint32_t *lodLevels;
+
+static bool enabled;
+// the objects with levels, as arrays of their bounding sphere in world space, the scale of
+// their mesh space errors and their levels
+static uint32_t count;
+static uint32_t *objects;
+static float *centerX;
+static float *centerY;
+static float *centerZ;
+static float *radius;
+static float *errorScale;
+static float *depths;
+
+static Allocation *levelBuffers[MAX_FRAMES_IN_FLIGHT];
+static uint32_t levelBufferIndices[MAX_FRAMES_IN_FLIGHT];
+static double selectTime; // seconds over the selections
+static uint32_t selections;
+
+void lod_init(void) {
+    lodLevels = calloc(sceneObjectCount > 0 ? sceneObjectCount : 1, sizeof(uint32_t));
+    count = 0;
+    for (uint32_t i = 0; i < sceneObjectCount; i++) {
+        count += sceneObjects[i].lodCount > 1;
+    }
+    // only the GPU cull rewrites the indirect lists, without it they draw level 0
+    bool applied = !sceneIndirect || cullRequested;
+    enabled = lodRequested && applied && count > 0;
+    if (!enabled) {
+        printf("lod: %s\n", !lodRequested ? "off" : (!applied ? "off, the indirect lists are not culled" :
+            "no object has levels of detail"));
+        return;
+    }
+
+    objects = malloc(sizeof(uint32_t) * count);
+    centerX = malloc(sizeof(float) * count);
+    centerY = malloc(sizeof(float) * count);
+    centerZ = malloc(sizeof(float) * count);
+    radius = malloc(sizeof(float) * count);
+    errorScale = malloc(sizeof(float) * count);
+    depths = malloc(sizeof(float) * count);
+    uint32_t n = 0;
+    uint32_t maxLevels = 0;
+    for (uint32_t i = 0; i < sceneObjectCount; i++) {
+        const SceneObject *object = &sceneObjects[i];
+        if (object->lodCount <= 1) {
+            continue;
+        }
+        vec3 box[2];
+        glm_vec3_copy((float *) object->boundsMin, box[0]);
+        glm_vec3_copy((float *) object->boundsMax, box[1]);
+        vec3 center;
+        glm_aabb_center(box, center);
+        objects[n] = i;
+        centerX[n] = center[0];
+        centerY[n] = center[1];
+        centerZ[n] = center[2];
+        radius[n] = glm_aabb_radius(box);
+        errorScale[n] = object->transform[3];
+        maxLevels = object->lodCount > maxLevels ? object->lodCount : maxLevels;
+        n++;
+    }
+
+    // the GPU cull reads the levels of the frame it culls, the CPU writes them at its start
+    VkDeviceSize levelSize = sizeof(uint32_t) * sceneObjectCount;
+    for (uint32_t i = 0; i < framesInFlight; i++) {
+        levelBuffers[i] = allocator_create_buffer(levelSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        memset(levelBuffers[i]->mapped, 0, levelSize);
+        levelBufferIndices[i] = bindless_add_buffer(levelBuffers[i]->buffer, 0, levelSize);
+    }
+    selectTime = 0.0;
+    selections = 0;
+    printf("lod: %u of %u objects with up to %u levels, %.2f pixel error\n", count, sceneObjectCount, maxLevels,
+        lodPixelError);
+}
+
+void lod_destroy(void) {
+    free(lodLevels);
+    lodLevels = NULL;
+    if (!enabled) {
+        return;
+    }
+    for (uint32_t i = 0; i < framesInFlight; i++) {
+        bindless_release(BINDLESS_BUFFER, levelBufferIndices[i]);
+        allocator_free(levelBuffers[i]);
+        levelBuffers[i] = NULL;
+    }
+    free(objects);
+    free(centerX);
+    free(centerY);
+    free(centerZ);
+    free(radius);
+    free(errorScale);
+    free(depths);
+    objects = NULL;
+    enabled = false;
+}
+
+void lod_select(mat4 view, mat4 proj, float viewportHeight) {
+    if (!enabled) {
+        return;
+    }
+    double start = timer_now();
+
+    // clip w is the depth along the view direction for perspective projections and 1 for
+    // orthographic ones, the sphere's nearest point is its radius closer
+    mat4 viewProj;
+    glm_mat4_mul(proj, view, viewProj);
+    float wx = viewProj[0][3];
+    float wy = viewProj[1][3];
+    float wz = viewProj[2][3];
+    float ww = viewProj[3][3];
+    float wLength = sqrtf(wx * wx + wy * wy + wz * wz);
+
+    // a mesh space error e at depth w covers e * focal * height / 2 / w pixels, the focal
+    // length being 2 near / (top - bottom), or the y scale without perspective
+    float focal = fabsf(proj[1][1]);
+    if (proj[3][3] == 0.0f) {
+        float nearZ, farZ, top, bottom, left, right;
+        glm_persp_decomp(proj, &nearZ, &farZ, &top, &bottom, &left, &right);
+        focal = fabsf(2.0f * nearZ / (top - bottom));
+    }
+    float errorPerDepth = lodPixelError / (focal * 0.5f * viewportHeight);
+
+    for (uint32_t i = 0; i < count; i++) {
+        depths[i] = wx * centerX[i] + wy * centerY[i] + wz * centerZ[i] + ww - wLength * radius[i];
+    }
+
+    // the levels' errors only grow, the last one within the allowed error is the coarsest.
+    // spheres reaching the eye get level 0
+    uint32_t *levels = levelBuffers[currentFrame]->mapped;
+    for (uint32_t i = 0; i < count; i++) {
+        const SceneObject *object = &sceneObjects[objects[i]];
+        const MeshLod *lods = &sceneLods[object->firstLod];
+        float allowed = depths[i] > 0.0f ? errorPerDepth * depths[i] / errorScale[i] : 0.0f;
+        uint32_t level = 0;
+        while (level + 1 < object->lodCount && lods[level + 1].error <= allowed) {
+            level++;
+        }
+        lodLevels[objects[i]] = level;
+        levels[objects[i]] = level;
+    }
+    selectTime += timer_now() - start;
+    selections++;
+}
+
+uint32_t lod_level_buffer(void) {
+    return enabled ? levelBufferIndices[currentFrame] : BINDLESS_INVALID;
+}
+
+const MeshLod *lod_object_level(uint32_t object) {
+    const SceneObject *sceneObject = &sceneObjects[object];
+    if (sceneObject->lodCount == 0) {
+        return NULL;
+    }
+    return &sceneLods[sceneObject->firstLod + lodLevels[object]];
+}
+
+void lod_report(void) {
+    if (!enabled) {
+        return;
+    }
+    uint32_t levelObjects[MESH_MAX_LODS] = {0};
+    uint64_t triangles = 0;
+    uint64_t fullTriangles = 0;
+    for (uint32_t i = 0; i < sceneObjectCount; i++) {
+        const SceneObject *object = &sceneObjects[i];
+        const MeshLod *lod = lod_object_level(i);
+        if (lod == NULL) {
+            triangles += object->indexCount / 3;
+            fullTriangles += object->indexCount / 3;
+            continue;
+        }
+        levelObjects[lodLevels[i]]++;
+        triangles += lod->indexCount / 3;
+        fullTriangles += sceneLods[object->firstLod].indexCount / 3;
+    }
+
+    printf("lod: objects per level");
+    for (uint32_t i = 0; i < MESH_MAX_LODS; i++) {
+        if (levelObjects[i] > 0) {
+            printf(" %u:%u", i, levelObjects[i]);
+        }
+    }
+    double selectMs = selections > 0 ? selectTime * 1000.0 / selections : 0.0;
+    printf(", %llu of %llu triangles (%.1f%%), select %.3fms (%.0f objects/ms)\n", (unsigned long long) triangles,
+        (unsigned long long) fullTriangles, fullTriangles > 0 ? 100.0 * triangles / fullTriangles : 0.0, selectMs,
+        selectMs > 0.0 ? count / selectMs : 0.0);
+}
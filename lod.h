@@ -0,0 +1,38 @@
+#ifndef VULK_LOD_H
+#define VULK_LOD_H
+
+#include <cglm/cglm.h>
+#include "vulk.h"
+#include "scene.h"
+
+// level of detail selection for the scene's objects (see simplify.h for the levels). once a
+// frame, before cull_record, every object picks the coarsest level whose error projects to at
+// most lodPixelError pixels. the error is scaled into world space by the object's transform
+// and projected at the nearest depth of the object's bounding sphere, taken around its world
+// AABB, with the focal length glm_persp_decomp gives for the projection (its y scale for
+// orthographic ones, where depth does not matter). the objects are kept as arrays of their
+// sphere components so the whole scene is selected in two flat loops. the choice goes to the
+// GPU cull through a per frame slot buffer and to the direct draws through lodLevels. without
+// the GPU cull the indirect lists stay at level 0, so selection is off and every object reports
+// level 0
+extern bool lodRequested;
+// --lod-error=P, in pixels of the viewport height
+extern float lodPixelError;
+// per scene object, the level selected last, 0 for objects without levels
+extern uint32_t *lodLevels;
+
+// after scene_create
+void lod_init(void);
+void lod_destroy(void);
+
+// selects for the current frame slot, view is the world to eye transform proj applies to
+void lod_select(mat4 view, mat4 proj, float viewportHeight);
+// bindless index of the current frame slot's levels, a uint per object
+uint32_t lod_level_buffer(void);
+// the object's selected level, NULL when it has none
+const MeshLod *lod_object_level(uint32_t object);
+
+// the levels the last selection picked and the triangles they draw against level 0's
+void lod_report(void);
+
+#endif
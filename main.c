@@ -1,49 +1,135 @@
-#include <assert.h>
 #include <string.h>
 #include <cglm/cglm.h>
 
+#ifdef _WIN32
 #define VK_USE_PLATFORM_WIN32_KHR
+#endif
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
+#ifdef _WIN32
 #define GLFW_EXPOSE_NATIVE_WIN32
 #include <GLFW/glfw3native.h>
-#include <vulkan/vk_enum_string_helper.h>
-
-#define VK(f) { \
-    VkResult res = (f); \
-    if (res != VK_SUCCESS) { \
-        fprintf(stderr, "Fatal: %s (%d) in %s at line %d\n", \
-        string_VkResult(res), res, __FILE__, __LINE__); \
-        assert(res == VK_SUCCESS); \
-    } \
-}
+#endif
 
+#include "vulk.h"
+#include "allocator.h"
+#include "bindless.h"
+#include "compute.h"
+#include "cull.h"
+#include "deletion.h"
+#include "frame.h"
+#include "graph.h"
+#include "hiz.h"
+#include "jobs.h"
+#include "lod.h"
+#include "mesh_file.h"
+#include "offscreen.h"
+#include "pacing.h"
+#include "pipeline_cache.h"
+#include "record.h"
+#include "rendering.h"
+#include "scene.h"
+#include "staging.h"
+#include "streaming.h"
+#include "swapchain.h"
+#include "timeline.h"
+#include "timer.h"
+#include "vertex.h"
 
 VkInstance vk;
 VkPhysicalDevice physicalDevice;
 VkDevice device;
 VkDebugUtilsMessengerEXT vkDebugMessenger;
 VkQueue graphicsQueue;
+int queueFamilyIdx = -1;
 VkSurfaceKHR surface;
-VkSwapchainKHR swapChain;
-VkImage *swapchainImages;
-VkImageView *swapchainImageViews;
-VkFramebuffer *swapchainFramebuffers;
-uint32_t swapchainImageCount;
-VkFormat swapChainImageFormat;
-VkExtent2D swapChainExtent;
 VkShaderModule vertShaderModule;
 VkShaderModule fragShaderModule;
 VkPipelineLayout pipelineLayout;
-VkRenderPass renderPass;
 VkPipelineLayout pipelineLayout;
 VkPipeline graphicsPipeline;
-VkCommandPool commandPool;
-VkCommandBuffer commandBuffer;
-int imageIndex;
-VkSemaphore imageAvailableSemaphore;
-VkSemaphore renderFinishedSemaphore;
-VkFence inFlightFence;
+// with mesh shaders, the same fragment shader behind shaders/meshlet.mesh
+VkShaderModule meshShaderModule;
+VkPipeline meshPipeline;
+VkShaderStageFlags drawPushConstantStages = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+uint32_t imageIndex;
+uint32_t requestedFramesInFlight = 2;
+const char *pipelineCachePath = "pipeline_cache.bin";
+
+// headless: render into offscreen images, no window/surface/swapchain
+bool headless = false;
+uint32_t headlessFrameCount = 1000;
+VkExtent2D headlessExtent = {800, 600};
+const char *capturePath = NULL;
+
+bool framebufferResized = false;
+
+// vertex layout, --vertex-layout=split puts positions in their own stream
+bool splitVertexStreams = false;
+bool packedVertices = false;
+VertexLayout vertexLayout;
+Mesh sceneMesh;
+// --no-meshlets draws and culls every object whole
+bool meshletsRequested = true;
+// bindless indices of the mesh's streams and meshlet data, for the mesh shader
+uint32_t streamBufferIndices[VERTEX_MAX_STREAMS];
+uint32_t meshletDataBufferIndex;
+
+// --mesh loads a .vmesh (its layout overrides the options above), --write-mesh saves the triangle as one
+const char *meshPath = NULL;
+const char *writeMeshPath = NULL;
+MeshFile meshFile;
+double meshLoadStart;
+
+// --defragment compacts the allocator's blocks once the device is idle after the last frame
+bool defragmentRequested = false;
+
+// materials live in a bindless storage buffer, objects pick one by index (see shaders/bindless.glsl)
+typedef struct Material {
+    vec4 baseColor;
+    uint32_t texture;
+    uint32_t sampler;
+    uint32_t pad[2];
+} Material;
+
+// everything else comes from the object, see shaders/scene.glsl. the rest after materialBuffer
+// is only read by the mesh shader
+typedef struct DrawPushConstants {
+    mat4 viewProj;
+    uint32_t objectBuffer;
+    uint32_t materialBuffer;
+    uint32_t drawBuffer;
+    uint32_t meshletBuffer;
+    uint32_t meshletDataBuffer;
+    uint32_t meshletVertexCount;
+    uint32_t streams[VERTEX_MAX_STREAMS];
+} DrawPushConstants;
+
+static const Material materials[] = {
+    {{1.0f, 1.0f, 1.0f, 1.0f}, BINDLESS_INVALID, BINDLESS_INVALID}
+};
+Allocation *materialBuffer;
+uint32_t materialBufferIndex;
+
+// --draws=N places the mesh N times in a grid, one scene object each. with --direct-draws
+// they are drawn one by one, recorded in parallel on the job system
+uint32_t drawCount = 1;
+uint32_t drawGridSide = 1;
+// --threads=N job threads including the main one, 0 for one per core
+uint32_t requestedJobThreads = 0;
+
+// there is no camera yet, the scene is in clip space. --zoom=Z magnifies it around the center
+// so objects outside the view get culled
+float viewZoom = 1.0f;
+mat4 viewProj;
+vec4 frustumPlanes[6];
+
+static const SourceVertex triangleVertices[] = {
+    {{0.0f, -0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.5f, 0.0f}, {1.0f, 0.0f, 0.0f, 1.0f}},
+    {{0.5f, 0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}, {1.0f, 1.0f}, {0.0f, 1.0f, 0.0f, 1.0f}},
+    {{-0.5f, 0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 1.0f}, {0.0f, 0.0f, 1.0f, 1.0f}}
+};
+static const uint32_t triangleIndices[] = {0, 1, 2};
 
 PFN_vkCreateDebugUtilsMessengerEXT createDebugUtilsMessenger = NULL;
 PFN_vkDestroyDebugUtilsMessengerEXT destroyDebugUtilsMessenger = NULL;
@@ -98,27 +184,153 @@ VkShaderModule read_shader(const char *filename) {
     return shaderModule;
 }
 
-void draw() {
-    VkCommandBufferBeginInfo beginInfo = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-        .flags = 0,
-        .pInheritanceInfo = NULL
-    };
-    VK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+bool device_extension_supported(const char *name) {
+    uint32_t count = 0;
+    vkEnumerateDeviceExtensionProperties(physicalDevice, NULL, &count, NULL);
+    VkExtensionProperties *properties = malloc(sizeof(VkExtensionProperties) * count);
+    vkEnumerateDeviceExtensionProperties(physicalDevice, NULL, &count, properties);
 
-    VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
-    VkRenderPassBeginInfo renderPassBeginInfo = {
-        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-        .renderPass = renderPass,
-        .framebuffer = swapchainFramebuffers[imageIndex],
-        .renderArea.offset = {0, 0},
-        .renderArea.extent = swapChainExtent,
-        .clearValueCount = 1,
-        .pClearValues = &clearColor
-    };
-    vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    bool found = false;
+    for (uint32_t i = 0; i < count && !found; i++) {
+        found = strcmp(properties[i].extensionName, name) == 0;
+    }
+    free(properties);
+    return found;
+}
 
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+void parse_args(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strcmp(arg, "--headless") == 0) {
+            headless = true;
+        } else if (strncmp(arg, "--frames=", 9) == 0) {
+            headlessFrameCount = (uint32_t) strtoul(arg + 9, NULL, 10);
+        } else if (strncmp(arg, "--size=", 7) == 0) {
+            if (sscanf(arg + 7, "%ux%u", &headlessExtent.width, &headlessExtent.height) != 2) {
+                fprintf(stderr, "Invalid size: %s\n", arg + 7);
+                exit(1);
+            }
+        } else if (strncmp(arg, "--frames-in-flight=", 19) == 0) {
+            requestedFramesInFlight = (uint32_t) strtoul(arg + 19, NULL, 10);
+            if (requestedFramesInFlight < 1 || requestedFramesInFlight > MAX_FRAMES_IN_FLIGHT) {
+                fprintf(stderr, "frames in flight must be between 1 and %d\n", MAX_FRAMES_IN_FLIGHT);
+                exit(1);
+            }
+        } else if (strncmp(arg, "--pipeline-cache=", 17) == 0) {
+            pipelineCachePath = arg + 17;
+        } else if (strncmp(arg, "--present-mode=", 15) == 0) {
+            const char *mode = arg + 15;
+            if (strcmp(mode, "fifo") == 0) {
+                requestedPresentMode = VK_PRESENT_MODE_FIFO_KHR;
+            } else if (strcmp(mode, "fifo_relaxed") == 0) {
+                requestedPresentMode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+            } else if (strcmp(mode, "mailbox") == 0) {
+                requestedPresentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+            } else if (strcmp(mode, "immediate") == 0) {
+                requestedPresentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+            } else {
+                fprintf(stderr, "Unknown present mode: %s\n", mode);
+                exit(1);
+            }
+        } else if (strncmp(arg, "--swapchain-images=", 19) == 0) {
+            requestedSwapchainImageCount = (uint32_t) strtoul(arg + 19, NULL, 10);
+        } else if (strcmp(arg, "--low-latency") == 0) {
+            pacingEnabled = true;
+        } else if (strncmp(arg, "--capture=", 10) == 0) {
+            capturePath = arg + 10;
+        } else if (strncmp(arg, "--vertex-layout=", 16) == 0) {
+            const char *layout = arg + 16;
+            if (strcmp(layout, "interleaved") == 0) {
+                splitVertexStreams = false;
+            } else if (strcmp(layout, "split") == 0) {
+                splitVertexStreams = true;
+            } else {
+                fprintf(stderr, "Unknown vertex layout: %s\n", layout);
+                exit(1);
+            }
+        } else if (strncmp(arg, "--vertex-format=", 16) == 0) {
+            const char *format = arg + 16;
+            if (strcmp(format, "float") == 0) {
+                packedVertices = false;
+            } else if (strcmp(format, "packed") == 0) {
+                packedVertices = true;
+            } else {
+                fprintf(stderr, "Unknown vertex format: %s\n", format);
+                exit(1);
+            }
+        } else if (strncmp(arg, "--draws=", 8) == 0) {
+            drawCount = (uint32_t) strtoul(arg + 8, NULL, 10);
+        } else if (strcmp(arg, "--render-pass") == 0) {
+            dynamicRenderingRequested = false;
+        } else if (strcmp(arg, "--no-async-compute") == 0) {
+            asyncComputeRequested = false;
+        } else if (strcmp(arg, "--direct-draws") == 0) {
+            sceneIndirectRequested = false;
+        } else if (strcmp(arg, "--no-culling") == 0) {
+            cullRequested = false;
+        } else if (strcmp(arg, "--no-occlusion") == 0) {
+            cullOcclusionRequested = false;
+        } else if (strcmp(arg, "--verify-culling") == 0) {
+            cullVerify = true;
+        } else if (strcmp(arg, "--no-meshlets") == 0) {
+            meshletsRequested = false;
+        } else if (strcmp(arg, "--no-mesh-shader") == 0) {
+            sceneMeshShaderRequested = false;
+        } else if (strcmp(arg, "--defragment") == 0) {
+            defragmentRequested = true;
+        } else if (strcmp(arg, "--no-lod") == 0) {
+            lodRequested = false;
+        } else if (strncmp(arg, "--lod-error=", 12) == 0) {
+            lodPixelError = strtof(arg + 12, NULL);
+            if (!(lodPixelError >= 0.0f)) {
+                fprintf(stderr, "Invalid lod error: %s\n", arg + 12);
+                exit(1);
+            }
+        } else if (strncmp(arg, "--zoom=", 7) == 0) {
+            viewZoom = strtof(arg + 7, NULL);
+            if (!(viewZoom > 0.0f)) {
+                fprintf(stderr, "Invalid zoom: %s\n", arg + 7);
+                exit(1);
+            }
+        } else if (strncmp(arg, "--threads=", 10) == 0) {
+            requestedJobThreads = (uint32_t) strtoul(arg + 10, NULL, 10);
+            if (requestedJobThreads > JOBS_MAX_THREADS) {
+                fprintf(stderr, "threads must be at most %d\n", JOBS_MAX_THREADS);
+                exit(1);
+            }
+        } else if (strncmp(arg, "--mesh=", 7) == 0) {
+            meshPath = arg + 7;
+        } else if (strncmp(arg, "--write-mesh=", 13) == 0) {
+            writeMeshPath = arg + 13;
+        } else {
+            fprintf(stderr, "Unknown argument: %s\n", arg);
+            fprintf(stderr, "usage: vulk [--headless] [--frames=N] [--size=WxH] [--frames-in-flight=N] [--pipeline-cache=path]\n"
+                "            [--present-mode=fifo|fifo_relaxed|mailbox|immediate] [--swapchain-images=N] [--low-latency]\n"
+                "            [--capture=out.ppm] [--vertex-layout=interleaved|split] [--vertex-format=float|packed]\n"
+                "            [--mesh=in.vmesh] [--write-mesh=out.vmesh] [--draws=N] [--threads=N]\n"
+                "            [--render-pass] [--no-async-compute] [--direct-draws] [--zoom=Z] [--no-culling]\n"
+                "            [--no-occlusion] [--verify-culling] [--no-meshlets] [--no-mesh-shader]\n"
+                "            [--no-lod] [--lod-error=P] [--defragment]\n");
+            exit(1);
+        }
+    }
+
+    while (drawGridSide * drawGridSide < drawCount) {
+        drawGridSide++;
+    }
+
+    glm_mat4_identity(viewProj);
+    glm_scale(viewProj, (vec3){viewZoom, viewZoom, 1.0f});
+    cull_frustum_planes(viewProj, frustumPlanes);
+
+    jobs_init(requestedJobThreads);
+}
+
+// binds everything a scene draw needs, so it also works in a secondary buffer. the mesh
+// shader reads the phase's list itself
+void bind_scene(VkCommandBuffer commandBuffer, ScenePhase phase) {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, sceneMeshTasks ? meshPipeline : graphicsPipeline);
+    bindless_bind(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout);
 
     VkViewport viewport = {
         .x = 0.0f,
@@ -136,16 +348,254 @@ void draw() {
     };
     vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-    vkCmdDraw(commandBuffer, 3, 1, 0, 0);
-    vkCmdEndRenderPass(commandBuffer);
+    DrawPushConstants pushConstants = {
+        .objectBuffer = sceneObjectBufferIndex,
+        .materialBuffer = materialBufferIndex
+    };
+    glm_mat4_copy(viewProj, pushConstants.viewProj);
+    if (sceneMeshTasks) {
+        pushConstants.drawBuffer = sceneDrawLists[currentFrame][phase].drawsIndex;
+        pushConstants.meshletBuffer = sceneMeshletBufferIndex;
+        pushConstants.meshletDataBuffer = meshletDataBufferIndex;
+        pushConstants.meshletVertexCount = sceneMesh.meshletVertexCount;
+        memcpy(pushConstants.streams, streamBufferIndices, sizeof(pushConstants.streams));
+    } else {
+        mesh_bind(commandBuffer, &sceneMesh, false);
+    }
+    vkCmdPushConstants(commandBuffer, pipelineLayout, drawPushConstantStages, 0, sizeof(pushConstants), &pushConstants);
+}
+
+// the per object fallback, draws objects [begin, end) and culls them on the CPU
+void draw_range(VkCommandBuffer commandBuffer, uint32_t begin, uint32_t end, void *user) {
+    bind_scene(commandBuffer, SCENE_EARLY);
+    for (uint32_t i = begin; i < end; i++) {
+        const SceneObject *object = &sceneObjects[i];
+        if (cullRequested && !cull_object_visible(object, frustumPlanes)) {
+            continue;
+        }
+        const MeshLod *lod = lod_object_level(i);
+        if (lod != NULL) {
+            vkCmdDrawIndexed(commandBuffer, lod->indexCount, 1, object->firstIndex + lod->firstIndex,
+                object->vertexOffset, i);
+        } else {
+            vkCmdDrawIndexed(commandBuffer, object->indexCount, 1, object->firstIndex, object->vertexOffset, i);
+        }
+    }
+}
+
+// each object is shrunk into its own grid cell, a single one covers the whole screen
+void create_scene_objects(void) {
+    SceneObject *objects = malloc(sizeof(SceneObject) * drawCount);
+    float cell = 1.0f / drawGridSide;
+    for (uint32_t i = 0; i < drawCount; i++) {
+        vec3 center = {
+            -1.0f + (i % drawGridSide + 0.5f) * 2.0f * cell,
+            -1.0f + (i / drawGridSide + 0.5f) * 2.0f * cell,
+            0.0f
+        };
+        SceneObject *object = &objects[i];
+        glm_vec4_scale(sceneMesh.positionScale, cell, object->positionScale);
+        glm_vec4_scale(sceneMesh.positionOffset, cell, object->positionOffset);
+        glm_vec3_add(object->positionOffset, center, object->positionOffset);
+        // the full detail level, the others follow it in the index buffer
+        object->indexCount = sceneMesh.lods[0].indexCount;
+        object->firstIndex = 0;
+        object->vertexOffset = 0;
+        object->materialIndex = 0;
+        glm_vec3_scale(sceneMesh.boundsMin, cell, object->boundsMin);
+        glm_vec3_add(object->boundsMin, center, object->boundsMin);
+        glm_vec3_scale(sceneMesh.boundsMax, cell, object->boundsMax);
+        glm_vec3_add(object->boundsMax, center, object->boundsMax);
+        object->boundsMin[3] = object->boundsMax[3] = 0.0f;
+        glm_vec4(center, cell, object->transform);
+        object->firstMeshlet = 0;
+        // without levels of detail only level 0's meshlets are the object's
+        uint32_t meshletCount = lodRequested ? sceneMesh.meshletCount : sceneMesh.lods[0].meshletCount;
+        object->meshletCount = meshletsRequested ? meshletCount : 0;
+        object->firstLod = 0;
+        object->lodCount = lodRequested ? sceneMesh.lodCount : 0;
+    }
+    scene_create(objects, drawCount, sceneMesh.meshlets, sceneMesh.meshletCount, sceneMesh.lods, sceneMesh.lodCount);
+    free(objects);
+}
+
+typedef struct SceneTargets {
+    GraphResource color;
+    GraphResource depth;
+    ScenePhase phase;
+} SceneTargets;
+
+void scene_pass(VkCommandBuffer commandBuffer, void *user) {
+    SceneTargets *targets = user;
+    VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
+
+    // a streamed mesh is skipped until its buffers have been acquired
+    bool meshReady = streaming_complete(sceneMesh.uploadTicket);
+    bool parallel = meshReady && !sceneIndirect && drawCount > 1 && jobs_thread_count() > 1;
+    // the late phase draws over the early one
+    rendering_begin(commandBuffer, graph_image_view(targets->color), graph_image_view(targets->depth),
+        targets->phase == SCENE_EARLY ? &clearColor : NULL, parallel);
+
+    if (parallel) {
+        VkCommandBufferInheritanceInfo inheritance = rendering_inheritance();
+        record_parallel(commandBuffer, &inheritance, drawCount, draw_range, NULL);
+    } else if (meshReady && sceneIndirect) {
+        bind_scene(commandBuffer, targets->phase);
+        scene_draw(commandBuffer, targets->phase);
+    } else if (meshReady) {
+        draw_range(commandBuffer, 0, drawCount, NULL);
+    }
+    rendering_end(commandBuffer);
+}
+
+void depth_pyramid_pass(VkCommandBuffer commandBuffer, void *user) {
+    SceneTargets *targets = user;
+    hiz_build(commandBuffer, graph_image_view(targets->depth));
+}
+
+void cull_late_pass(VkCommandBuffer commandBuffer, void *user) {
+    cull_record_late(commandBuffer);
+}
+
+void draw(VkCommandBuffer commandBuffer) {
+    VkCommandBufferBeginInfo beginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = 0,
+        .pInheritanceInfo = NULL
+    };
+    VK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+
+    staging_flush(commandBuffer);
+    streaming_acquire(commandBuffer);
+    // no camera yet, viewProj is all projection
+    mat4 view = GLM_MAT4_IDENTITY_INIT;
+    lod_select(view, viewProj, (float) swapChainExtent.height);
+    cull_record(commandBuffer, viewProj);
+
+    // the swapchain image arrives straight from the acquire (undefined when headless) and leaves
+    // ready to present, or to be read back. depth follows the swapchain extent, a resize
+    // replaces it on the next frame
+    graph_begin();
+    SceneTargets targets;
+    targets.phase = SCENE_EARLY;
+    targets.color = graph_import_image(swapchainImages[imageIndex], swapchainImageViews[imageIndex],
+        VK_IMAGE_ASPECT_COLOR_BIT, headless ? GRAPH_ACCESS_NONE : GRAPH_ACQUIRED,
+        headless ? GRAPH_TRANSFER_READ : GRAPH_PRESENT);
+    GraphImageDesc depthDesc = rendering_depth_desc();
+    targets.depth = graph_create_image(&depthDesc);
+    GraphPass scene = graph_add_pass("scene", scene_pass, &targets);
+    graph_use(scene, targets.color, GRAPH_COLOR_ATTACHMENT_WRITE);
+    graph_use(scene, targets.depth, GRAPH_DEPTH_ATTACHMENT_WRITE);
+
+    // the early phase's depth goes into the pyramid, the late phase culls against it and
+    // draws what the early phase missed
+    SceneTargets lateTargets = targets;
+    lateTargets.phase = SCENE_LATE;
+    if (cullOcclusion) {
+        GraphResource pyramid = hiz_import();
+        GraphPass reduce = graph_add_pass("depth pyramid", depth_pyramid_pass, &targets);
+        graph_use(reduce, targets.depth, GRAPH_SAMPLED_READ);
+        graph_use(reduce, pyramid, GRAPH_STORAGE_WRITE);
+
+        // imported per frame slot, nothing else touches the slot's late list in between
+        SceneDrawList *lateList = &sceneDrawLists[currentFrame][SCENE_LATE];
+        GraphResource lateDraws = graph_import_buffer(lateList->draws->buffer, 0, VK_WHOLE_SIZE,
+            GRAPH_ACCESS_NONE, GRAPH_ACCESS_NONE);
+        GraphResource lateCount = graph_import_buffer(lateList->count->buffer, 0, VK_WHOLE_SIZE,
+            GRAPH_ACCESS_NONE, GRAPH_ACCESS_NONE);
+        GraphPass cullLate = graph_add_pass("cull late", cull_late_pass, NULL);
+        graph_use(cullLate, pyramid, GRAPH_SAMPLED_READ);
+        graph_use(cullLate, lateDraws, GRAPH_STORAGE_WRITE);
+        graph_use(cullLate, lateCount, GRAPH_STORAGE_WRITE);
+        // the visibility it records is read by the next frame
+        graph_keep(cullLate);
+
+        GraphPass late = graph_add_pass("scene late", scene_pass, &lateTargets);
+        graph_use(late, targets.color, GRAPH_COLOR_ATTACHMENT_WRITE);
+        graph_use(late, targets.depth, GRAPH_DEPTH_ATTACHMENT_WRITE);
+        graph_use(late, lateDraws, sceneMeshTasks ? GRAPH_MESH_READ : GRAPH_INDIRECT_READ);
+        graph_use(late, lateCount, GRAPH_INDIRECT_READ);
+    }
+    graph_execute(commandBuffer);
+
     VK(vkEndCommandBuffer(commandBuffer));
 }
 
-int main() {
-    glfwInit();
+// a graphics pipeline compiled on a job thread into a cache of its own, merged afterwards
+typedef struct PipelineJob {
+    const VkGraphicsPipelineCreateInfo *info;
+    VkPipelineCache cache;
+    VkPipeline *pipeline;
+} PipelineJob;
+
+void create_pipeline_job(void *data) {
+    PipelineJob *job = data;
+    VK(vkCreateGraphicsPipelines(device, job->cache, 1, job->info, NULL, job->pipeline));
+}
+
+void framebuffer_resize_callback(GLFWwindow *window, int width, int height) {
+    framebufferResized = true;
+}
+
+// P cycles present modes (applied through a swapchain rebuild), L toggles frame pacing
+void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
+    if (action != GLFW_PRESS) {
+        return;
+    }
+    if (key == GLFW_KEY_P) {
+        static const VkPresentModeKHR modes[] = {
+            VK_PRESENT_MODE_FIFO_KHR,
+            VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+            VK_PRESENT_MODE_MAILBOX_KHR,
+            VK_PRESENT_MODE_IMMEDIATE_KHR
+        };
+        uint32_t modeCount = sizeof(modes) / sizeof(modes[0]);
+        uint32_t next = 0;
+        for (uint32_t i = 0; i < modeCount; i++) {
+            if (modes[i] == requestedPresentMode) {
+                next = (i + 1) % modeCount;
+            }
+        }
+        requestedPresentMode = modes[next];
+        framebufferResized = true;
+    } else if (key == GLFW_KEY_L) {
+        pacingEnabled = !pacingEnabled;
+        printf("low latency pacing %s\n", pacingEnabled ? "on" : "off");
+    }
+}
+
+// retires the current swapchain (if any) and builds one at the window's framebuffer size
+void recreate_swapchain(GLFWwindow *window) {
+    int width = 0, height = 0;
+    glfwGetFramebufferSize(window, &width, &height);
+
+    // minimized, there is nothing to present to until the window comes back
+    while ((width == 0 || height == 0) && !glfwWindowShouldClose(window)) {
+        glfwWaitEvents();
+        glfwGetFramebufferSize(window, &width, &height);
+    }
+    if (width == 0 || height == 0) {
+        return;
+    }
+
+    VkExtent2D extent = {
+        .width = width,
+        .height = height
+    };
+    swapchain_create(extent);
+    framebufferResized = false;
+}
+
+int main(int argc, char **argv) {
+    parse_args(argc, argv);
 
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    GLFWwindow* window = glfwCreateWindow(800, 600, "Vulkan window", NULL, NULL);
+    GLFWwindow* window = NULL;
+    if (!headless) {
+        glfwInit();
+
+        glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+        window = glfwCreateWindow(800, 600, "Vulkan window", NULL, NULL);
+    }
 
     uint32_t extensionCount = 0;
     VkExtensionProperties extensions[256];
@@ -158,7 +608,7 @@ int main() {
         .applicationVersion = VK_MAKE_VERSION(1, 0, 0),
         .pEngineName = "Engine",
         .engineVersion = VK_MAKE_VERSION(1, 0, 0),
-        .apiVersion = VK_API_VERSION_1_0
+        .apiVersion = VK_API_VERSION_1_2
     };
 
     VkInstanceCreateInfo createInfo = {
@@ -169,12 +619,14 @@ int main() {
     uint32_t enabledExtensionCount = 0;
     const char *enabledExtensions[256];
 
-    uint32_t glfwExtensionCount = 0;
-    const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-    for (int i = 0; i < glfwExtensionCount; i++) {
-        enabledExtensions[i] = glfwExtensions[i];
+    if (!headless) {
+        uint32_t glfwExtensionCount = 0;
+        const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+        for (int i = 0; i < glfwExtensionCount; i++) {
+            enabledExtensions[i] = glfwExtensions[i];
+        }
+        enabledExtensionCount += glfwExtensionCount;
     }
-    enabledExtensionCount += glfwExtensionCount;
 
 #ifndef NDEBUG
     enabledExtensions[enabledExtensionCount++] = VK_EXT_DEBUG_UTILS_EXTENSION_NAME;
@@ -235,29 +687,44 @@ int main() {
 #endif
 
     // surface
-    VkWin32SurfaceCreateInfoKHR surfaceCreateInfo = {
-        .sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR,
-        .hwnd = glfwGetWin32Window(window),
-        .hinstance = GetModuleHandle(NULL)
-    };
-    VK(vkCreateWin32SurfaceKHR(vk, &surfaceCreateInfo, NULL, &surface));
+    if (!headless) {
+#ifdef _WIN32
+        VkWin32SurfaceCreateInfoKHR surfaceCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR,
+            .hwnd = glfwGetWin32Window(window),
+            .hinstance = GetModuleHandle(NULL)
+        };
+        VK(vkCreateWin32SurfaceKHR(vk, &surfaceCreateInfo, NULL, &surface));
+#else
+        VK(glfwCreateWindowSurface(vk, window, NULL, &surface));
+#endif
+    }
 
     // devices
     uint32_t deviceCount = 0;
     vkEnumeratePhysicalDevices(vk, &deviceCount, NULL);
-    if (deviceCount != 1) {
+    if (deviceCount == 0) {
         fprintf(stderr, "No GPU");
         exit(1);
     }
 
+    // first enumerated device, software ICDs (lavapipe) are usually the only one on build servers
+    deviceCount = 1;
     vkEnumeratePhysicalDevices(vk, &deviceCount, &physicalDevice);
 
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+    printf("using %s\n", deviceProperties.deviceName);
+    if (deviceProperties.apiVersion < VK_API_VERSION_1_2) {
+        fprintf(stderr, "Fatal: %s does not support Vulkan 1.2\n", deviceProperties.deviceName);
+        exit(1);
+    }
+
     uint32_t queueFamilyCount = 0;
     vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, NULL);
 
     VkQueueFamilyProperties queueFamilies[32];
     vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, &queueFamilies[0]);
-    int queueFamilyIdx = -1;
     for (int i = 0; i < queueFamilyCount; i++) {
         if (queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
             queueFamilyIdx = i;
@@ -265,20 +732,48 @@ int main() {
     }
 
     float queuePriority = 1.0f;
-    VkDeviceQueueCreateInfo queueCreateInfo = {
-        .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-        .queueFamilyIndex = queueFamilyIdx,
-        .queueCount = 1,
-        .pQueuePriorities = &queuePriority
+    VkDeviceQueueCreateInfo queueCreateInfos[3] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+            .queueFamilyIndex = queueFamilyIdx,
+            .queueCount = 1,
+            .pQueuePriorities = &queuePriority
+        }
     };
+    uint32_t queueCreateInfoCount = 1;
+    if (streaming_select_queue(&queueCreateInfos[queueCreateInfoCount])) {
+        queueCreateInfoCount++;
+    }
+    if (compute_select_queue(&queueCreateInfos[queueCreateInfoCount])) {
+        queueCreateInfoCount++;
+    }
 
     VkPhysicalDeviceFeatures deviceFeatures;
     vkGetPhysicalDeviceFeatures(physicalDevice, &deviceFeatures);
 
+    // 1.2 features are opt-in, each module turns on what it needs
+    VkPhysicalDeviceVulkan12Features supportedFeatures12 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES
+    };
+    VkPhysicalDeviceFeatures2 supportedFeatures = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &supportedFeatures12
+    };
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &supportedFeatures);
+
+    VkPhysicalDeviceVulkan12Features enabledFeatures12 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES
+    };
+    bindless_require_features(&supportedFeatures12, &enabledFeatures12);
+    timeline_require_features(&supportedFeatures12, &enabledFeatures12);
+    scene_require_features(&deviceFeatures, &supportedFeatures12, &enabledFeatures12);
+    cull_configure(&deviceFeatures);
+
     VkDeviceCreateInfo deviceCreateInfo = {
         .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-        .pQueueCreateInfos = &queueCreateInfo,
-        .queueCreateInfoCount = 1,
+        .pQueueCreateInfos = queueCreateInfos,
+        .queueCreateInfoCount = queueCreateInfoCount,
+        .pNext = &enabledFeatures12,
         .pEnabledFeatures = &deviceFeatures
     };
 
@@ -288,7 +783,16 @@ int main() {
 
     int enabledDeviceExtensionCount = 0;
     const char *enabledDeviceExtensions[256];
-    enabledDeviceExtensions[enabledDeviceExtensionCount++] = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
+    if (!headless) {
+        enabledDeviceExtensions[enabledDeviceExtensionCount++] = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
+    }
+    if (device_extension_supported(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) {
+        enabledDeviceExtensions[enabledDeviceExtensionCount++] = VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+        memoryBudgetEnabled = true;
+    }
+    rendering_require_features(&supportedFeatures12, &enabledFeatures12, enabledDeviceExtensions,
+        &enabledDeviceExtensionCount);
+    scene_require_mesh_shader(&enabledFeatures12, enabledDeviceExtensions, &enabledDeviceExtensionCount);
 
     deviceCreateInfo.enabledExtensionCount = enabledDeviceExtensionCount;
     deviceCreateInfo.ppEnabledExtensionNames = enabledDeviceExtensions;
@@ -296,87 +800,56 @@ int main() {
     VK(vkCreateDevice(physicalDevice, &deviceCreateInfo, NULL, &device));
 
     vkGetDeviceQueue(device, queueFamilyIdx, 0, &graphicsQueue);
+    timeline_create(&graphicsTimeline);
+    deletion_init();
+    graph_init();
 
-    VkSurfaceCapabilitiesKHR surfaceCapabilities;
-    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface, &surfaceCapabilities);
+    allocator_init();
+    bindless_init();
+    streaming_init();
+    pipeline_cache_load(pipelineCachePath);
 
-    uint32_t surfaceFormatCount;
-    vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &surfaceFormatCount, NULL);
-    VkSurfaceFormatKHR surfaceFormats[32];
-    vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &surfaceFormatCount, &surfaceFormats[0]);
+    // render pass and pipeline only depend on the format, the swapchain itself is built after them
+    swapChainImageFormat = VK_FORMAT_B8G8R8A8_SRGB;
 
-    uint32_t presentModeCount;
-    vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &presentModeCount, NULL);
-    VkPresentModeKHR presentModes[32];
-    vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &presentModeCount, &presentModes[0]);
+    vertShaderModule = read_shader("../shaders/vert.spv");
+    fragShaderModule = read_shader("../shaders/frag.spv");
+    if (sceneMeshShading) {
+        meshShaderModule = read_shader("../shaders/mesh.spv");
+        drawPushConstantStages |= VK_SHADER_STAGE_MESH_BIT_EXT;
+    }
 
-    VkSurfaceFormatKHR surfaceFormat = {
-        .format = VK_FORMAT_B8G8R8A8_SRGB,
-        .colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR
-    };
-    VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+    if (meshPath != NULL) {
+        mesh_file_open(&meshFile, meshPath);
+        packedVertices = (meshFile.header->flags & MESH_FILE_PACKED) != 0;
+        splitVertexStreams = (meshFile.header->flags & MESH_FILE_SPLIT_POSITIONS) != 0;
+    }
+    vertex_layout_init(&vertexLayout, packedVertices, splitVertexStreams);
+    if (writeMeshPath != NULL) {
+        mesh_file_write(writeMeshPath, &vertexLayout, triangleVertices, 3, triangleIndices, 3);
+        printf("wrote %s\n", writeMeshPath);
+    }
 
-    int width, height;
-    glfwGetFramebufferSize(window, &width, &height);
-    VkExtent2D extent = {
-        .width = width,
-        .height = height
+    // OCTAHEDRAL_NORMALS, the shader decodes normals to match the layout
+    VkBool32 octahedralNormals = vertexLayout.encodings[VERTEX_NORMAL] == VERTEX_OCTAHEDRAL;
+    VkSpecializationMapEntry vertSpecializationEntry = {
+        .constantID = 0,
+        .offset = 0,
+        .size = sizeof(VkBool32)
     };
-
-    uint32_t minSwapchainImageCount = surfaceCapabilities.minImageCount + 1;
-    VkSwapchainCreateInfoKHR swapchainCreateInfo = {
-        .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
-        .surface = surface,
-        .minImageCount = minSwapchainImageCount,
-        .imageFormat = surfaceFormat.format,
-        .imageColorSpace = surfaceFormat.colorSpace,
-        .imageExtent = extent,
-        .imageArrayLayers = 1,
-        .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-        .imageSharingMode = VK_SHARING_MODE_EXCLUSIVE,
-        .compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
-        .preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR,
-        .presentMode = presentMode,
-        .clipped = VK_TRUE
+    VkSpecializationInfo vertSpecialization = {
+        .mapEntryCount = 1,
+        .pMapEntries = &vertSpecializationEntry,
+        .dataSize = sizeof(VkBool32),
+        .pData = &octahedralNormals
     };
 
-    VK(vkCreateSwapchainKHR(device, &swapchainCreateInfo, NULL, &swapChain));
-
-    vkGetSwapchainImagesKHR(device, swapChain, &swapchainImageCount, NULL);
-    swapchainImages = malloc(sizeof(VkImage) * swapchainImageCount);
-    vkGetSwapchainImagesKHR(device, swapChain, &swapchainImageCount, &swapchainImages[0]);
-    swapChainImageFormat = surfaceFormat.format;
-    swapChainExtent = extent;
-
-    swapchainImageViews = malloc(sizeof(VkImageView) * swapchainImageCount);
-    for (int i = 0; i < swapchainImageCount; i++) {
-        VkImageViewCreateInfo viewCreateInfo = {
-            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-            .image = swapchainImages[i],
-            .viewType = VK_IMAGE_VIEW_TYPE_2D,
-            .format = swapChainImageFormat,
-            .components.r = VK_COMPONENT_SWIZZLE_IDENTITY,
-            .components.g = VK_COMPONENT_SWIZZLE_IDENTITY,
-            .components.b = VK_COMPONENT_SWIZZLE_IDENTITY,
-            .components.a = VK_COMPONENT_SWIZZLE_IDENTITY,
-            .subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-            .subresourceRange.baseMipLevel = 0,
-            .subresourceRange.levelCount = 1,
-            .subresourceRange.baseArrayLayer = 0,
-            .subresourceRange.layerCount = 1
-        };
-
-        VK(vkCreateImageView(device, &viewCreateInfo, NULL, &swapchainImageViews[i]));
-    }
-
-    vertShaderModule = read_shader("../shaders/vert.spv");
-    fragShaderModule = read_shader("../shaders/frag.spv");
-
     VkPipelineShaderStageCreateInfo vertShaderStageInfo = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
         .stage = VK_SHADER_STAGE_VERTEX_BIT,
         .module = vertShaderModule,
-        .pName = "main"
+        .pName = "main",
+        .pSpecializationInfo = &vertSpecialization
     };
 
     VkPipelineShaderStageCreateInfo fragShaderStageInfo = {
@@ -397,13 +870,7 @@ int main() {
         .pDynamicStates = &dynamicStates[0]
     };
 
-    VkPipelineVertexInputStateCreateInfo vertexInputInfo = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-        .vertexBindingDescriptionCount = 0,
-        .pVertexBindingDescriptions = NULL,
-        .vertexAttributeDescriptionCount = 0,
-        .pVertexAttributeDescriptions = NULL
-    };
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo = vertex_layout_input_state(&vertexLayout, false);
 
     VkPipelineInputAssemblyStateCreateInfo inputAssembly = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
@@ -411,26 +878,13 @@ int main() {
         .primitiveRestartEnable = VK_FALSE
     };
 
-    VkViewport viewport = {
-        .x = 0.0f,
-        .y = 0.0f,
-        .width = (float) swapChainExtent.width,
-        .height = (float) swapChainExtent.height,
-        .minDepth = 0.0f,
-        .maxDepth = 1.0f
-    };
-
-    VkRect2D scissor = {
-        .offset = {0, 0},
-        .extent = swapChainExtent
-    };
-
+    // viewport and scissor are dynamic so the pipeline survives swapchain resizes
     VkPipelineViewportStateCreateInfo viewportState = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
         .viewportCount = 1,
-        .pViewports = &viewport,
+        .pViewports = NULL,
         .scissorCount = 1,
-        .pScissors = &scissor
+        .pScissors = NULL
     };
 
     VkPipelineRasterizationStateCreateInfo rasterizer = {
@@ -458,56 +912,23 @@ int main() {
         .alphaBlendOp = VK_BLEND_OP_ADD
     };
 
+    VkPushConstantRange pushConstantRange = {
+        .stageFlags = drawPushConstantStages,
+        .offset = 0,
+        .size = sizeof(DrawPushConstants)
+    };
+
     VkPipelineLayoutCreateInfo pipelineLayoutInfo = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-        .setLayoutCount = 0,
-        .pSetLayouts = NULL,
-        .pushConstantRangeCount = 0,
-        .pPushConstantRanges = NULL
+        .setLayoutCount = 1,
+        .pSetLayouts = &bindlessSetLayout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &pushConstantRange
     };
 
     VK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, NULL, &pipelineLayout));
 
-    VkAttachmentDescription colorAttachment = {
-        .format = swapChainImageFormat,
-        .samples = VK_SAMPLE_COUNT_1_BIT,
-        .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-        .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-        .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-        .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-    };
-
-    VkAttachmentReference colorAttachmentRef = {
-        .attachment = 0,
-        .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
-    };
-
-    VkSubpassDescription subpass = {
-        .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
-        .colorAttachmentCount = 1,
-        .pColorAttachments = &colorAttachmentRef
-    };
-
-    VkSubpassDependency dependency = {
-        .srcSubpass = VK_SUBPASS_EXTERNAL,
-        .dstSubpass = 0,
-        .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-        .srcAccessMask = 0,
-        .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-        .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
-    };
-    VkRenderPassCreateInfo renderPassInfo = {
-        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
-        .attachmentCount = 1,
-        .pAttachments = &colorAttachment,
-        .subpassCount = 1,
-        .pSubpasses = &subpass,
-        .dependencyCount = 1,
-        .pDependencies = &dependency
-    };
-    VK(vkCreateRenderPass(device, &renderPassInfo, NULL, &renderPass));
+    rendering_init();
 
     VkPipelineMultisampleStateCreateInfo multisampling = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
@@ -532,6 +953,13 @@ int main() {
 
     };
 
+    VkPipelineDepthStencilStateCreateInfo depthStencil = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+        .depthTestEnable = VK_TRUE,
+        .depthWriteEnable = VK_TRUE,
+        .depthCompareOp = VK_COMPARE_OP_LESS
+    };
+
     VkPipelineShaderStageCreateInfo stages[] = {vertShaderStageInfo, fragShaderStageInfo};
     VkGraphicsPipelineCreateInfo pipelineInfo = {
         .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
@@ -542,132 +970,244 @@ int main() {
         .pViewportState = &viewportState,
         .pRasterizationState = &rasterizer,
         .pMultisampleState = &multisampling,
-        .pDepthStencilState = NULL,
+        .pDepthStencilState = &depthStencil,
         .pColorBlendState = &colorBlending,
         .pDynamicState = &dynamicState,
         .layout = pipelineLayout,
-        .renderPass = renderPass,
-        .subpass = 0,
         .basePipelineHandle = VK_NULL_HANDLE,
         .basePipelineIndex = -1,
     };
-    VK(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, NULL, &graphicsPipeline));
-
-    swapchainFramebuffers = malloc(sizeof(VkFramebuffer) * swapchainImageCount);
-    for (int i = 0; i < swapchainImageCount; i++) {
-        VkImageView attachments[] = {
-            swapchainImageViews[i]
+    rendering_pipeline_info(&pipelineInfo);
+
+    // both pipelines compile in parallel, each into its own cache
+    VkPipelineCache workerCaches[2];
+    PipelineJob pipelineJobs[2];
+    uint32_t pipelineJobCount = 1;
+    JobCounter pipelineCounter = {0};
+    workerCaches[0] = pipeline_cache_create_worker();
+    pipelineJobs[0] = (PipelineJob) {&pipelineInfo, workerCaches[0], &graphicsPipeline};
+    jobs_run(&(Job) {create_pipeline_job, &pipelineJobs[0]}, 1, &pipelineCounter);
+
+    // the mesh shader fetches the vertices itself, PACKED_VERTICES and SPLIT_POSITIONS pick
+    // the layout it decodes
+    if (sceneMeshShading) {
+        VkBool32 meshConstants[2] = {packedVertices, splitVertexStreams};
+        VkSpecializationMapEntry meshSpecializationEntries[2] = {
+            {.constantID = 0, .offset = 0, .size = sizeof(VkBool32)},
+            {.constantID = 1, .offset = sizeof(VkBool32), .size = sizeof(VkBool32)}
         };
-
-        VkFramebufferCreateInfo framebufferInfo = {
-            .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
-            .renderPass = renderPass,
-            .attachmentCount = 1,
-            .pAttachments = attachments,
-            .width = swapChainExtent.width,
-            .height = swapChainExtent.height,
-            .layers = 1
+        VkSpecializationInfo meshSpecialization = {
+            .mapEntryCount = 2,
+            .pMapEntries = meshSpecializationEntries,
+            .dataSize = sizeof(meshConstants),
+            .pData = meshConstants
         };
+        VkPipelineShaderStageCreateInfo meshStages[] = {
+            {
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .stage = VK_SHADER_STAGE_MESH_BIT_EXT,
+                .module = meshShaderModule,
+                .pName = "main",
+                .pSpecializationInfo = &meshSpecialization
+            },
+            fragShaderStageInfo
+        };
+        VkGraphicsPipelineCreateInfo meshPipelineInfo = pipelineInfo;
+        meshPipelineInfo.pStages = meshStages;
+        meshPipelineInfo.pVertexInputState = NULL;
+        meshPipelineInfo.pInputAssemblyState = NULL;
+        workerCaches[1] = pipeline_cache_create_worker();
+        pipelineJobs[1] = (PipelineJob) {&meshPipelineInfo, workerCaches[1], &meshPipeline};
+        pipelineJobCount = 2;
+        jobs_run(&(Job) {create_pipeline_job, &pipelineJobs[1]}, 1, &pipelineCounter);
+        // the mesh pipeline's info lives in this block
+        jobs_wait(&pipelineCounter);
+    }
+    jobs_wait(&pipelineCounter);
+    pipeline_cache_merge(workerCaches, pipelineJobCount);
+
+    frames_create(requestedFramesInFlight);
+    compute_init();
+    record_init();
+    staging_init(16 * 1024 * 1024);
+
+    // copies are queued into the first frame's staging region and recorded by its flush,
+    // a mesh file streams in the background and stays mapped until it has arrived
+    if (meshPath != NULL) {
+        meshLoadStart = timer_now();
+        mesh_file_stream(&sceneMesh, &meshFile);
+    } else {
+        mesh_upload(&sceneMesh, &vertexLayout, triangleVertices, 3, triangleIndices, 3);
+    }
+    materialBuffer = allocator_create_buffer(sizeof(materials), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    StagingAlloc materialStaging = staging_alloc(sizeof(materials), 0);
+    memcpy(materialStaging.data, materials, sizeof(materials));
+    staging_copy(materialStaging, materialBuffer->buffer, 0, sizeof(materials));
+    materialBufferIndex = bindless_add_buffer(materialBuffer->buffer, 0, sizeof(materials));
+    create_scene_objects();
+    lod_init();
+    cull_init();
+    if (sceneMeshTasks) {
+        for (uint32_t i = 0; i < vertexLayout.streamCount; i++) {
+            streamBufferIndices[i] = bindless_add_buffer(sceneMesh.streams[i]->buffer, 0, VK_WHOLE_SIZE);
+        }
+        meshletDataBufferIndex = bindless_add_buffer(sceneMesh.meshletData->buffer, 0, VK_WHOLE_SIZE);
+    }
 
-        VK(vkCreateFramebuffer(device, &framebufferInfo, NULL, &swapchainFramebuffers[i]));
+    printf("vertex layout: %s %s, %u bytes per vertex\n", splitVertexStreams ? "split" : "interleaved",
+        packedVertices ? "packed" : "float", vertexLayout.strides[0] + vertexLayout.strides[1]);
+
+    if (headless) {
+        swapchain_create(headlessExtent);
+    } else {
+        glfwSetFramebufferSizeCallback(window, framebuffer_resize_callback);
+        glfwSetKeyCallback(window, key_callback);
+        recreate_swapchain(window);
     }
 
-    VkCommandPoolCreateInfo poolInfo = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
-        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
-        .queueFamilyIndex = queueFamilyIdx
-    };
-    VK(vkCreateCommandPool(device, &poolInfo, NULL, &commandPool));
+    uint32_t frameCount = 0;
+    double startTime = timer_now();
+    while(headless ? frameCount < headlessFrameCount : !glfwWindowShouldClose(window)) {
+        // input is sampled after the pacing delay, as close to the predicted acquire as possible
+        pacing_wait();
+        if (!headless) {
+            glfwPollEvents();
+        }
 
-    VkCommandBufferAllocateInfo allocInfo = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-        .commandPool = commandPool,
-        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-        .commandBufferCount = 1
-    };
+        // only the slot wait and the acquire count as blocked, the housekeeping between them is work
+        double blockStart = timer_now();
+        Frame *frame = frame_begin();
+        double blocked = timer_now() - blockStart;
+        bindless_update();
+        deletion_collect();
+        staging_begin_frame(currentFrame);
+        streaming_update();
+        if (meshFile.data != NULL && streaming_complete(sceneMesh.uploadTicket)) {
+            printf("streamed %s: %u vertices, %u indices in %.2fms\n", meshPath, sceneMesh.vertexCount,
+                sceneMesh.indexCount, (timer_now() - meshLoadStart) * 1000.0);
+            mesh_file_close(&meshFile);
+        }
 
-    VK(vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer));
+        if (headless) {
+            imageIndex = currentFrame;
+        } else {
+            blockStart = timer_now();
+            VkResult acquireResult = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, frame->imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+            if (acquireResult == VK_ERROR_OUT_OF_DATE_KHR) {
+                recreate_swapchain(window);
+                continue;
+            }
+            // suboptimal still acquired an image, present reports it again and we recreate then
+            if (acquireResult != VK_SUBOPTIMAL_KHR) {
+                VK(acquireResult);
+            }
+            blocked += timer_now() - blockStart;
+        }
+        pacing_blocked(blocked);
 
-    VkSemaphoreCreateInfo semaphoreInfo = {
-        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO
-    };
-    VkFenceCreateInfo fenceInfo = {
-        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-        .flags = VK_FENCE_CREATE_SIGNALED_BIT // initial state signaled, first frame fence passes
-    };
-    VK(vkCreateSemaphore(device, &semaphoreInfo, NULL, &imageAvailableSemaphore));
-    VK(vkCreateSemaphore(device, &semaphoreInfo, NULL, &renderFinishedSemaphore));
-    VK(vkCreateFence(device, &fenceInfo, NULL, &inFlightFence));
+        draw(frame->commandBuffer);
+        compute_submit(cull_compute_wait());
 
-    while(!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
+        // headless frames have nothing to acquire or present, so no swapchain semaphores
+        TimelineSubmit submit = {0};
+        if (!headless) {
+            timeline_submit_wait(&submit, frame->imageAvailableSemaphore, 0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+            timeline_submit_signal(&submit, renderFinishedSemaphores[imageIndex], 0);
+        }
+        streaming_submit_waits(&submit);
+        compute_submit_waits(&submit);
+        frame_submit(frame, &submit);
+
+        if (!headless) {
+            VkSwapchainKHR swapChains[] = {swapChain};
+            VkPresentInfoKHR presentInfo = {
+                .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+                .waitSemaphoreCount = 1,
+                .pWaitSemaphores = &renderFinishedSemaphores[imageIndex],
+                .swapchainCount = 1,
+                .pSwapchains = swapChains,
+                .pImageIndices = &imageIndex
+            };
+            VkResult presentResult = vkQueuePresentKHR(graphicsQueue, &presentInfo);
+            if (presentResult == VK_ERROR_OUT_OF_DATE_KHR || presentResult == VK_SUBOPTIMAL_KHR || framebufferResized) {
+                recreate_swapchain(window);
+            } else {
+                VK(presentResult);
+            }
+        }
+        pacing_presented();
+        frame_end();
+        frameCount++;
+    }
 
-        vkWaitForFences(device, 1, &inFlightFence, VK_TRUE, UINT64_MAX);
-        vkResetFences(device, 1, &inFlightFence);
+    vkDeviceWaitIdle(device);
 
-        vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+    double elapsed = timer_now() - startTime;
+    printf("%u frames in %.3fs (%.1f fps)\n", frameCount, elapsed, elapsed > 0.0 ? frameCount / elapsed : 0.0);
+    pacing_report();
+    lod_report();
+    cull_report(viewProj);
+    bool cullVerified = !cullVerify || cull_verify(viewProj);
 
-        vkResetCommandBuffer(commandBuffer, 0);
+    if (headless && capturePath != NULL && frameCount > 0) {
+        offscreen_write_ppm(imageIndex, capturePath);
+        printf("wrote %s\n", capturePath);
+    }
 
-        draw();
+    pipeline_cache_save(pipelineCachePath);
+    pipeline_cache_destroy();
 
-        VkSubmitInfo submitInfo = {
-            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO
-        };
+    // the device is idle, everything still queued can go now
+    graph_destroy();
+    deletion_flush();
 
-        VkSemaphore waitSemaphores[] = {imageAvailableSemaphore};
-        VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-        submitInfo.waitSemaphoreCount = 1;
-        submitInfo.pWaitSemaphores = waitSemaphores;
-        submitInfo.pWaitDstStageMask = waitStages;
-
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &commandBuffer;
-
-        VkSemaphore signalSemaphores[] = {renderFinishedSemaphore};
-        submitInfo.signalSemaphoreCount = 1;
-        submitInfo.pSignalSemaphores = signalSemaphores;
-
-        VK(vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFence));
-
-        VkSwapchainKHR swapChains[] = {swapChain};
-        VkPresentInfoKHR presentInfo = {
-            .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
-            .waitSemaphoreCount = 1,
-            .pWaitSemaphores = signalSemaphores,
-            .swapchainCount = 1,
-            .pSwapchains = swapChains,
-            .pImageIndices = &imageIndex
-        };
-        vkQueuePresentKHR(graphicsQueue, &presentInfo);
+    // nothing recorded holds a buffer handle anymore, and the frees above left the holes
+    if (defragmentRequested) {
+        allocator_print_stats();
+        allocator_defragment();
+        allocator_print_stats();
     }
 
-    vkDeviceWaitIdle(device);
-
-    vkDestroySemaphore(device, imageAvailableSemaphore, NULL);
-    vkDestroySemaphore(device, renderFinishedSemaphore, NULL);
-    vkDestroyFence(device, inFlightFence, NULL);
-    vkDestroyCommandPool(device, commandPool, NULL);
+    streaming_destroy();
+    mesh_file_close(&meshFile);
+    mesh_destroy(&sceneMesh);
+    allocator_free(materialBuffer);
+    cull_destroy();
+    lod_destroy();
+    scene_destroy();
+    bindless_destroy();
+    staging_destroy();
+    record_destroy();
+    compute_destroy();
+    frames_destroy();
     vkDestroyPipeline(device, graphicsPipeline, NULL);
+    if (sceneMeshShading) {
+        vkDestroyPipeline(device, meshPipeline, NULL);
+        vkDestroyShaderModule(device, meshShaderModule, NULL);
+    }
     vkDestroyPipelineLayout(device, pipelineLayout, NULL);
-    vkDestroyRenderPass(device, renderPass, NULL);
+    rendering_destroy();
     vkDestroyShaderModule(device, vertShaderModule, NULL);
     vkDestroyShaderModule(device, fragShaderModule, NULL);
     if (destroyDebugUtilsMessenger != 0) {
         destroyDebugUtilsMessenger(vk, vkDebugMessenger, NULL);
     }
-    for (int i = 0; i < swapchainImageCount; i++) {
-        vkDestroyImageView(device, swapchainImageViews[i], NULL);
-        vkDestroyFramebuffer(device, swapchainFramebuffers[i], NULL);
+    swapchain_destroy();
+    if (!headless) {
+        vkDestroySurfaceKHR(vk, surface, NULL);
     }
-    free(swapchainImages);
-    free(swapchainImageViews);
-    vkDestroySwapchainKHR(device, swapChain, NULL);
-    vkDestroySurfaceKHR(vk, surface, NULL);
+    deletion_destroy();
+    allocator_print_stats();
+    allocator_destroy();
+    timeline_destroy(&graphicsTimeline);
     vkDestroyDevice(device, NULL);
     vkDestroyInstance(vk, NULL);
-    glfwDestroyWindow(window);
-    glfwTerminate();
+    if (!headless) {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+    }
+    jobs_destroy();
 
-    return 0;
+    return cullVerified ? 0 : 1;
 }
\ No newline at end of file
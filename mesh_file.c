@@ -0,0 +1,353 @@
+#include <string.h>
+#include "mesh_file.h"
+#include "streaming.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static uint64_t align_up(uint64_t value) {
+    return (value + MESH_FILE_ALIGNMENT - 1) & ~(uint64_t) (MESH_FILE_ALIGNMENT - 1);
+}
+
+static void invalid(const char *path, const char *reason) {
+    fprintf(stderr, "Invalid mesh file %s: %s\n", path, reason);
+    exit(1);
+}
+
+static void map_file(MeshFile *file, const char *path) {
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (handle == INVALID_HANDLE_VALUE) {
+        fprintf(stderr, "Failed to open file: %s\n", path);
+        exit(1);
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle, &size) || size.QuadPart == 0) {
+        invalid(path, "empty");
+    }
+    HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    void *data = mapping != NULL ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if (data == NULL) {
+        fprintf(stderr, "Failed to map file: %s\n", path);
+        exit(1);
+    }
+    file->fileHandle = handle;
+    file->mappingHandle = mapping;
+    file->data = data;
+    file->size = (uint64_t) size.QuadPart;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to open file: %s\n", path);
+        exit(1);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        invalid(path, "empty");
+    }
+    void *data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "Failed to map file: %s\n", path);
+        exit(1);
+    }
+    // the upload reads every section front to back exactly once
+    madvise(data, (size_t) st.st_size, MADV_SEQUENTIAL);
+    madvise(data, (size_t) st.st_size, MADV_WILLNEED);
+    file->fd = fd;
+    file->data = data;
+    file->size = (uint64_t) st.st_size;
+#endif
+}
+
+void mesh_file_open(MeshFile *file, const char *path) {
+    memset(file, 0, sizeof(*file));
+    map_file(file, path);
+
+    if (file->size < sizeof(MeshFileHeader)) {
+        invalid(path, "truncated header");
+    }
+    const MeshFileHeader *header = (const MeshFileHeader *) file->data;
+    if (header->magic != MESH_FILE_MAGIC) {
+        invalid(path, "bad magic");
+    }
+    if (header->version != MESH_FILE_VERSION) {
+        invalid(path, "unsupported version");
+    }
+
+    for (uint32_t i = 0; i < MESH_SECTION_COUNT; i++) {
+        const MeshFileSection *section = &header->sections[i];
+        if (section->size == 0) {
+            continue;
+        }
+        if (section->offset % MESH_FILE_ALIGNMENT != 0) {
+            invalid(path, "misaligned section");
+        }
+        if (section->offset > file->size || section->size > file->size - section->offset) {
+            invalid(path, "section out of bounds");
+        }
+    }
+
+    // section sizes must agree with what the header says they hold
+    VertexLayout layout;
+    vertex_layout_init(&layout, header->flags & MESH_FILE_PACKED, header->flags & MESH_FILE_SPLIT_POSITIONS);
+    for (uint32_t i = 0; i < VERTEX_MAX_STREAMS; i++) {
+        if (header->strides[i] != layout.strides[i]) {
+            invalid(path, "vertex layout mismatch");
+        }
+        if (header->sections[MESH_SECTION_STREAM0 + i].size != (uint64_t) layout.strides[i] * header->vertexCount) {
+            invalid(path, "vertex stream size mismatch");
+        }
+    }
+    if (header->indexType != VK_INDEX_TYPE_UINT16 && header->indexType != VK_INDEX_TYPE_UINT32) {
+        invalid(path, "bad index type");
+    }
+    uint64_t indexSize = header->indexType == VK_INDEX_TYPE_UINT16 ? 2 : 4;
+    if (header->sections[MESH_SECTION_INDICES].size != indexSize * header->indexCount) {
+        invalid(path, "index section size mismatch");
+    }
+    // the draws fetch vertices through them without bounds
+    const uint8_t *indices = file->data + header->sections[MESH_SECTION_INDICES].offset;
+    for (uint32_t i = 0; i < header->indexCount; i++) {
+        uint32_t index = indexSize == 2 ? ((const uint16_t *) indices)[i] : ((const uint32_t *) indices)[i];
+        if (index >= header->vertexCount) {
+            invalid(path, "index out of range");
+        }
+    }
+    if (header->lodCount == 0 || header->lodCount > MESH_MAX_LODS ||
+        header->sections[MESH_SECTION_LODS].size != (uint64_t) header->lodCount * sizeof(MeshLod)) {
+        invalid(path, "lod table size mismatch");
+    }
+    if (header->sections[MESH_SECTION_MESHLETS].size != (uint64_t) header->meshletCount * sizeof(Meshlet)) {
+        invalid(path, "meshlet table size mismatch");
+    }
+    // the meshlets follow each other through both halves of the data and the index buffer
+    const Meshlet *meshlets = (const Meshlet *) (file->data + header->sections[MESH_SECTION_MESHLETS].offset);
+    uint64_t meshletVertices = 0;
+    uint64_t meshletTriangles = 0;
+    for (uint32_t i = 0; i < header->meshletCount; i++) {
+        if (meshlets[i].vertexOffset != meshletVertices || meshlets[i].triangleOffset != meshletTriangles ||
+            meshlets[i].vertexCount > MESHLET_MAX_VERTICES || meshlets[i].triangleCount > MESHLET_MAX_TRIANGLES) {
+            invalid(path, "bad meshlet");
+        }
+        meshletVertices += meshlets[i].vertexCount;
+        meshletTriangles += meshlets[i].triangleCount;
+    }
+    if (header->meshletCount > 0 && 3 * meshletTriangles != header->indexCount) {
+        invalid(path, "meshlets do not cover the indices");
+    }
+    if (header->sections[MESH_SECTION_MESHLET_DATA].size != ((4 * meshletVertices + 3 * meshletTriangles + 3) & ~3ull)) {
+        invalid(path, "meshlet data size mismatch");
+    }
+    // the mesh shader indexes the vertex streams with both, unchecked
+    const uint8_t *meshletData = file->data + header->sections[MESH_SECTION_MESHLET_DATA].offset;
+    const uint32_t *meshletVertexIndices = (const uint32_t *) meshletData;
+    const uint8_t *meshletTriangleIndices = meshletData + 4 * meshletVertices;
+    for (uint32_t i = 0; i < header->meshletCount; i++) {
+        const Meshlet *meshlet = &meshlets[i];
+        for (uint32_t v = 0; v < meshlet->vertexCount; v++) {
+            if (meshletVertexIndices[meshlet->vertexOffset + v] >= header->vertexCount) {
+                invalid(path, "meshlet vertex out of range");
+            }
+        }
+        for (uint32_t t = 0; t < 3 * meshlet->triangleCount; t++) {
+            if (meshletTriangleIndices[3 * meshlet->triangleOffset + t] >= meshlet->vertexCount) {
+                invalid(path, "meshlet triangle out of range");
+            }
+        }
+    }
+    // the levels follow each other through the indices, and through the meshlets when there are
+    // any, each level's meshlets starting where its indices do. lod_select relies on their errors
+    // never shrinking
+    const MeshLod *lods = (const MeshLod *) (file->data + header->sections[MESH_SECTION_LODS].offset);
+    uint64_t lodIndices = 0;
+    uint64_t lodMeshlets = 0;
+    float lodError = 0.0f;
+    for (uint32_t i = 0; i < header->lodCount; i++) {
+        const MeshLod *lod = &lods[i];
+        if (lod->firstIndex != lodIndices || lod->indexCount % 3 != 0 || lod->firstMeshlet != lodMeshlets ||
+            !(lod->error >= lodError) ||
+            (uint64_t) lod->firstMeshlet + lod->meshletCount > header->meshletCount ||
+            (lod->meshletCount > 0 && 3ull * meshlets[lod->firstMeshlet].triangleOffset != lod->firstIndex)) {
+            invalid(path, "bad lod");
+        }
+        lodIndices += lod->indexCount;
+        lodMeshlets += lod->meshletCount;
+        lodError = lod->error;
+    }
+    if (lodIndices != header->indexCount || lodMeshlets != header->meshletCount) {
+        invalid(path, "lods do not cover the indices");
+    }
+    file->header = header;
+}
+
+void mesh_file_close(MeshFile *file) {
+    if (file->data == NULL) {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(file->data);
+    CloseHandle(file->mappingHandle);
+    CloseHandle(file->fileHandle);
+#else
+    munmap((void *) file->data, (size_t) file->size);
+    close(file->fd);
+#endif
+    memset(file, 0, sizeof(*file));
+}
+
+const void *mesh_file_section(const MeshFile *file, MeshFileSectionId id, uint64_t *size) {
+    const MeshFileSection *section = &file->header->sections[id];
+    if (size != NULL) {
+        *size = section->size;
+    }
+    return section->size > 0 ? file->data + section->offset : NULL;
+}
+
+static void init_mesh(Mesh *mesh, const MeshFile *file) {
+    const MeshFileHeader *header = file->header;
+    memset(mesh, 0, sizeof(*mesh));
+    vertex_layout_init(&mesh->layout, header->flags & MESH_FILE_PACKED, header->flags & MESH_FILE_SPLIT_POSITIONS);
+    mesh->vertexCount = header->vertexCount;
+    mesh->indexCount = header->indexCount;
+    mesh->indexType = (VkIndexType) header->indexType;
+    mesh->lodCount = header->lodCount;
+    memcpy(mesh->lods, mesh_file_section(file, MESH_SECTION_LODS, NULL), sizeof(MeshLod) * header->lodCount);
+    memcpy(mesh->boundsMin, header->boundsMin, sizeof(mesh->boundsMin));
+    memcpy(mesh->boundsMax, header->boundsMax, sizeof(mesh->boundsMax));
+    memcpy(mesh->positionScale, header->positionScale, sizeof(mesh->positionScale));
+    memcpy(mesh->positionOffset, header->positionOffset, sizeof(mesh->positionOffset));
+
+    // culling needs the table on the CPU before the upload lands
+    mesh->meshletCount = header->meshletCount;
+    mesh->meshlets = malloc(sizeof(Meshlet) * header->meshletCount);
+    memcpy(mesh->meshlets, mesh_file_section(file, MESH_SECTION_MESHLETS, NULL), sizeof(Meshlet) * header->meshletCount);
+    for (uint32_t i = 0; i < header->meshletCount; i++) {
+        mesh->meshletVertexCount += mesh->meshlets[i].vertexCount;
+    }
+}
+
+static Allocation *stream_section(const MeshFile *file, MeshFileSectionId id, VkBufferUsageFlags usage,
+    uint64_t *ticket) {
+    uint64_t size;
+    const void *src = mesh_file_section(file, id, &size);
+    if (src == NULL) {
+        return NULL;
+    }
+    Allocation *allocation = allocator_create_buffer(size, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    *ticket = streaming_upload(src, size, allocation->buffer, 0);
+    return allocation;
+}
+
+void mesh_file_stream(Mesh *mesh, const MeshFile *file) {
+    init_mesh(mesh, file);
+    // requests complete in order, the last ticket covers the whole mesh
+    for (uint32_t i = 0; i < mesh->layout.streamCount; i++) {
+        mesh->streams[i] = stream_section(file, MESH_SECTION_STREAM0 + i,
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &mesh->uploadTicket);
+    }
+    mesh->indices = stream_section(file, MESH_SECTION_INDICES, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, &mesh->uploadTicket);
+    mesh->meshletData = stream_section(file, MESH_SECTION_MESHLET_DATA, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        &mesh->uploadTicket);
+}
+
+void mesh_file_write(const char *path, const VertexLayout *layout, const SourceVertex *vertices, uint32_t vertexCount,
+    const uint32_t *indices, uint32_t indexCount) {
+    MeshFileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = MESH_FILE_MAGIC;
+    header.version = MESH_FILE_VERSION;
+    header.flags = (layout->encodings[VERTEX_POSITION] == VERTEX_SNORM16 ? MESH_FILE_PACKED : 0) |
+        (layout->splitPositions ? MESH_FILE_SPLIT_POSITIONS : 0);
+    header.vertexCount = vertexCount;
+
+    bool narrow = vertexCount <= UINT16_MAX + 1;
+    header.indexType = narrow ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+
+    vec3 boundsMin, boundsMax;
+    vec4 positionScale, positionOffset;
+    vertex_quantization(layout, vertices, vertexCount, boundsMin, boundsMax, positionScale, positionOffset);
+    memcpy(header.boundsMin, boundsMin, sizeof(header.boundsMin));
+    memcpy(header.boundsMax, boundsMax, sizeof(header.boundsMax));
+    memcpy(header.positionScale, positionScale, sizeof(header.positionScale));
+    memcpy(header.positionOffset, positionOffset, sizeof(header.positionOffset));
+
+    MeshGeometry geometry;
+    mesh_geometry_build(&geometry, vertices, vertexCount, indices, indexCount,
+        vertex_quantization_error(layout, positionScale));
+    const MeshletBuild *meshlets = &geometry.meshlets;
+    // from here on the indices are every level's
+    indices = geometry.chain.indices;
+    indexCount = geometry.chain.indexCount;
+    header.indexCount = indexCount;
+    header.lodCount = geometry.chain.lodCount;
+    header.meshletCount = meshlets->meshletCount;
+    uint64_t meshletVerticesSize = sizeof(uint32_t) * (uint64_t) meshlets->vertexCount;
+
+    for (uint32_t i = 0; i < VERTEX_MAX_STREAMS; i++) {
+        header.strides[i] = layout->strides[i];
+        header.sections[MESH_SECTION_STREAM0 + i].size = (uint64_t) layout->strides[i] * vertexCount;
+    }
+    header.sections[MESH_SECTION_INDICES].size = (uint64_t) indexCount * (narrow ? 2 : 4);
+    header.sections[MESH_SECTION_LODS].size = sizeof(MeshLod) * (uint64_t) header.lodCount;
+    header.sections[MESH_SECTION_MESHLETS].size = sizeof(Meshlet) * (uint64_t) meshlets->meshletCount;
+    header.sections[MESH_SECTION_MESHLET_DATA].size = (meshletVerticesSize + 3ull * meshlets->triangleCount + 3) & ~3ull;
+
+    uint64_t offset = align_up(sizeof(MeshFileHeader));
+    for (uint32_t i = 0; i < MESH_SECTION_COUNT; i++) {
+        if (header.sections[i].size > 0) {
+            header.sections[i].offset = offset;
+            offset = align_up(offset + header.sections[i].size);
+        }
+    }
+
+    // padding between sections stays zeroed
+    uint8_t *data = calloc(1, offset);
+    memcpy(data, &header, sizeof(header));
+
+    void *streams[VERTEX_MAX_STREAMS];
+    for (uint32_t i = 0; i < VERTEX_MAX_STREAMS; i++) {
+        MeshFileSection *section = &header.sections[MESH_SECTION_STREAM0 + i];
+        streams[i] = section->size > 0 ? data + section->offset : NULL;
+    }
+    vertex_encode(layout, vertices, vertexCount, positionScale, positionOffset, streams);
+
+    uint8_t *indexData = data + header.sections[MESH_SECTION_INDICES].offset;
+    if (narrow) {
+        for (uint32_t i = 0; i < indexCount; i++) {
+            uint16_t index = (uint16_t) indices[i];
+            memcpy(indexData + i * sizeof(index), &index, sizeof(index));
+        }
+    } else {
+        memcpy(indexData, indices, (size_t) indexCount * sizeof(uint32_t));
+    }
+
+    memcpy(data + header.sections[MESH_SECTION_LODS].offset, geometry.chain.lods, sizeof(MeshLod) * header.lodCount);
+
+    if (meshlets->meshletCount > 0) {
+        uint8_t *meshletData = data + header.sections[MESH_SECTION_MESHLET_DATA].offset;
+        memcpy(data + header.sections[MESH_SECTION_MESHLETS].offset, meshlets->meshlets,
+            sizeof(Meshlet) * meshlets->meshletCount);
+        memcpy(meshletData, meshlets->vertices, meshletVerticesSize);
+        memcpy(meshletData + meshletVerticesSize, meshlets->triangles, 3ull * meshlets->triangleCount);
+    }
+    mesh_geometry_free(&geometry);
+
+    FILE *out = fopen(path, "wb");
+    if (out == NULL) {
+        fprintf(stderr, "Failed to open file: %s\n", path);
+        exit(1);
+    }
+    if (fwrite(data, 1, offset, out) != offset) {
+        fprintf(stderr, "Failed to write file: %s\n", path);
+        exit(1);
+    }
+    fclose(out);
+    free(data);
+}
@@ -0,0 +1,84 @@
+#ifndef VULK_MESH_FILE_H
+#define VULK_MESH_FILE_H
+
+#include "vulk.h"
+#include "vertex.h"
+
+// .vmesh: a header followed by sections already encoded the way the GPU buffers expect
+// them, so loading is a memory map plus copies from the mapping into the staging ring.
+// all fields are little endian, sections start on MESH_FILE_ALIGNMENT boundaries
+#define MESH_FILE_MAGIC 0x48534d56 // "VMSH"
+#define MESH_FILE_VERSION 3
+#define MESH_FILE_ALIGNMENT 256
+
+#define MESH_FILE_PACKED 0x1
+#define MESH_FILE_SPLIT_POSITIONS 0x2
+
+typedef enum MeshFileSectionId {
+    // vertex streams as described by vertex_layout_init(flags), stream 1 only when split
+    MESH_SECTION_STREAM0,
+    MESH_SECTION_STREAM1,
+    // every level of detail's indices, one level after the other
+    MESH_SECTION_INDICES,
+    // MeshLod entries (simplify.h), lod 0 is the full mesh
+    MESH_SECTION_LODS,
+    // Meshlet entries (meshlet.h), covering the indices in order
+    MESH_SECTION_MESHLETS,
+    // meshlet vertex indices (uint32) followed by micro triangle indices (uint8), padded to
+    // whole words
+    MESH_SECTION_MESHLET_DATA,
+    MESH_SECTION_COUNT
+} MeshFileSectionId;
+
+typedef struct MeshFileSection {
+    uint64_t offset;
+    uint64_t size;
+} MeshFileSection;
+
+typedef struct MeshFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t flags;
+    uint32_t indexType; // VkIndexType
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t lodCount;
+    uint32_t meshletCount;
+    uint32_t strides[VERTEX_MAX_STREAMS];
+    float boundsMin[3];
+    float boundsMax[3];
+    float positionScale[4];
+    float positionOffset[4];
+    MeshFileSection sections[MESH_SECTION_COUNT];
+} MeshFileHeader;
+
+typedef struct MeshFile {
+    const uint8_t *data;
+    uint64_t size;
+    const MeshFileHeader *header;
+#ifdef _WIN32
+    void *fileHandle;
+    void *mappingHandle;
+#else
+    int fd;
+#endif
+} MeshFile;
+
+// maps the file read-only and validates the header and section table, fatal on failure
+void mesh_file_open(MeshFile *file, const char *path);
+void mesh_file_close(MeshFile *file);
+
+// points into the mapping, NULL for an empty section
+const void *mesh_file_section(const MeshFile *file, MeshFileSectionId id, uint64_t *size);
+
+// creates device-local buffers and fills them in the background by streaming.c, straight from
+// the mapping through the staging ring. the mesh can be drawn once
+// streaming_complete(mesh->uploadTicket), the file has to stay mapped until then
+void mesh_file_stream(Mesh *mesh, const MeshFile *file);
+
+// encodes a mesh with the given layout into a new file, simplified into its levels of detail
+// with the meshlets of each
+void mesh_file_write(const char *path, const VertexLayout *layout, const SourceVertex *vertices, uint32_t vertexCount,
+    const uint32_t *indices, uint32_t indexCount);
+
+#endif
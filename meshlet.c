@@ -0,0 +1,158 @@
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include "meshlet.h"
+
+static void load_position(const float *positions, size_t stride, uint32_t index, vec3 dest) {
+    memcpy(dest, (const uint8_t *) positions + stride * index, sizeof(float) * 3);
+}
+
+// sphere around the center of the meshlet's box, and the cone around the mean of its normals
+static void compute_bounds(Meshlet *meshlet, const MeshletBuild *build, const float *positions, size_t stride,
+    float padding) {
+    const uint32_t *vertices = build->vertices + meshlet->vertexOffset;
+    vec3 boxMin = {FLT_MAX, FLT_MAX, FLT_MAX};
+    vec3 boxMax = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+    for (uint32_t i = 0; i < meshlet->vertexCount; i++) {
+        vec3 p;
+        load_position(positions, stride, vertices[i], p);
+        glm_vec3_minv(boxMin, p, boxMin);
+        glm_vec3_maxv(boxMax, p, boxMax);
+    }
+    vec3 center;
+    glm_vec3_center(boxMin, boxMax, center);
+    float radius = 0.0f;
+    for (uint32_t i = 0; i < meshlet->vertexCount; i++) {
+        vec3 p;
+        load_position(positions, stride, vertices[i], p);
+        radius = glm_max(radius, glm_vec3_distance(center, p));
+    }
+
+    vec3 normals[MESHLET_MAX_TRIANGLES];
+    uint32_t normalCount = 0;
+    vec3 axis = GLM_VEC3_ZERO_INIT;
+    const uint8_t *triangles = build->triangles + 3 * meshlet->triangleOffset;
+    for (uint32_t t = 0; t < meshlet->triangleCount; t++) {
+        vec3 a, b, c;
+        load_position(positions, stride, vertices[triangles[3 * t]], a);
+        load_position(positions, stride, vertices[triangles[3 * t + 1]], b);
+        load_position(positions, stride, vertices[triangles[3 * t + 2]], c);
+        vec3 ab, ac, normal;
+        glm_vec3_sub(b, a, ab);
+        glm_vec3_sub(c, a, ac);
+        glm_vec3_cross(ab, ac, normal);
+        // degenerate triangles are never rasterized, they do not constrain the cone
+        float length = glm_vec3_norm(normal);
+        if (length <= 0.0f) {
+            continue;
+        }
+        glm_vec3_scale(normal, 1.0f / length, normals[normalCount]);
+        glm_vec3_add(axis, normals[normalCount], axis);
+        normalCount++;
+    }
+
+    float cutoff = 2.0f;
+    float axisLength = glm_vec3_norm(axis);
+    if (normalCount > 0 && axisLength > 0.0f) {
+        glm_vec3_scale(axis, 1.0f / axisLength, axis);
+        float minDot = 1.0f;
+        for (uint32_t i = 0; i < normalCount; i++) {
+            minDot = glm_min(minDot, glm_vec3_dot(normals[i], axis));
+        }
+        // a cone wider than a hemisphere always shows some front face
+        if (minDot > 0.0f) {
+            cutoff = sqrtf(1.0f - minDot * minDot);
+        }
+    } else {
+        glm_vec3_zero(axis);
+    }
+
+    memcpy(meshlet->center, center, sizeof(meshlet->center));
+    meshlet->radius = radius + padding;
+    memcpy(meshlet->coneAxis, axis, sizeof(meshlet->coneAxis));
+    meshlet->coneCutoff = cutoff;
+}
+
+// vertices of the triangle not yet in the meshlet, counting repeats within it once
+static uint32_t new_vertices(const uint32_t *triangle, const int32_t *local) {
+    uint32_t count = 0;
+    for (uint32_t k = 0; k < 3; k++) {
+        bool repeated = (k > 0 && triangle[k] == triangle[0]) || (k > 1 && triangle[k] == triangle[1]);
+        count += local[triangle[k]] < 0 && !repeated;
+    }
+    return count;
+}
+
+static void finish_meshlet(MeshletBuild *build, Meshlet *meshlet, int32_t *local, const float *positions,
+    size_t stride, float padding) {
+    compute_bounds(meshlet, build, positions, stride, padding);
+    build->meshlets[build->meshletCount++] = *meshlet;
+    for (uint32_t i = 0; i < meshlet->vertexCount; i++) {
+        local[build->vertices[meshlet->vertexOffset + i]] = -1;
+    }
+    memset(meshlet, 0, sizeof(*meshlet));
+    meshlet->vertexOffset = build->vertexCount;
+    meshlet->triangleOffset = build->triangleCount;
+}
+
+void meshlet_build(MeshletBuild *build, const float *positions, size_t positionStride, uint32_t vertexCount,
+    const uint32_t *indices, uint32_t indexCount, float padding) {
+    memset(build, 0, sizeof(*build));
+    uint32_t triangleCount = indexCount / 3;
+    // every meshlet holds at least one triangle, every triangle brings at most three vertices
+    build->meshlets = malloc(sizeof(Meshlet) * (triangleCount > 0 ? triangleCount : 1));
+    build->vertices = malloc(sizeof(uint32_t) * (triangleCount > 0 ? 3 * triangleCount : 1));
+    build->triangles = malloc(triangleCount > 0 ? 3 * triangleCount : 1);
+
+    // position of each mesh vertex within the current meshlet, -1 when it is not in it
+    int32_t *local = malloc(sizeof(int32_t) * (vertexCount > 0 ? vertexCount : 1));
+    memset(local, 0xff, sizeof(int32_t) * vertexCount);
+
+    Meshlet meshlet;
+    memset(&meshlet, 0, sizeof(meshlet));
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        const uint32_t *triangle = &indices[3 * t];
+        if (meshlet.vertexCount + new_vertices(triangle, local) > MESHLET_MAX_VERTICES ||
+            meshlet.triangleCount == MESHLET_MAX_TRIANGLES) {
+            finish_meshlet(build, &meshlet, local, positions, positionStride, padding);
+        }
+        for (uint32_t k = 0; k < 3; k++) {
+            if (local[triangle[k]] < 0) {
+                local[triangle[k]] = (int32_t) meshlet.vertexCount++;
+                build->vertices[build->vertexCount++] = triangle[k];
+            }
+            build->triangles[3 * build->triangleCount + k] = (uint8_t) local[triangle[k]];
+        }
+        build->triangleCount++;
+        meshlet.triangleCount++;
+    }
+    if (meshlet.triangleCount > 0) {
+        finish_meshlet(build, &meshlet, local, positions, positionStride, padding);
+    }
+    free(local);
+}
+
+void meshlet_build_append(MeshletBuild *build, const MeshletBuild *part) {
+    uint32_t meshletCount = build->meshletCount + part->meshletCount;
+    build->meshlets = realloc(build->meshlets, sizeof(Meshlet) * (meshletCount > 0 ? meshletCount : 1));
+    build->vertices = realloc(build->vertices, sizeof(uint32_t) * (build->vertexCount + part->vertexCount + 1));
+    build->triangles = realloc(build->triangles, 3 * (build->triangleCount + part->triangleCount) + 1);
+    for (uint32_t i = 0; i < part->meshletCount; i++) {
+        Meshlet *meshlet = &build->meshlets[build->meshletCount + i];
+        *meshlet = part->meshlets[i];
+        meshlet->vertexOffset += build->vertexCount;
+        meshlet->triangleOffset += build->triangleCount;
+    }
+    memcpy(build->vertices + build->vertexCount, part->vertices, sizeof(uint32_t) * part->vertexCount);
+    memcpy(build->triangles + 3 * build->triangleCount, part->triangles, 3 * part->triangleCount);
+    build->meshletCount = meshletCount;
+    build->vertexCount += part->vertexCount;
+    build->triangleCount += part->triangleCount;
+}
+
+void meshlet_build_free(MeshletBuild *build) {
+    free(build->meshlets);
+    free(build->vertices);
+    free(build->triangles);
+    memset(build, 0, sizeof(*build));
+}
@@ -0,0 +1,51 @@
+#ifndef VULK_MESHLET_H
+#define VULK_MESHLET_H
+
+#include <cglm/cglm.h>
+#include "vulk.h"
+
+// meshlets split an indexed mesh into clusters small enough for one mesh shader workgroup,
+// each with bounds to cull it on its own. they are built offline by walking the index buffer
+// in order, so meshlet i also covers a contiguous range of it: indices 3 * triangleOffset
+// onwards, which is how the indirect draws without mesh shaders reach them. every level of
+// detail gets meshlets of its own, following the previous level's
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+// mirrored by Meshlet in shaders/scene.glsl, stored as is in .vmesh files
+typedef struct Meshlet {
+    // into the meshlet vertex indices, which index the mesh's vertices
+    uint32_t vertexOffset;
+    // into the micro indices (three uint8 per triangle, indexing the meshlet's vertices)
+    // and, times three, into the mesh's index buffer
+    uint32_t triangleOffset;
+    uint32_t vertexCount;
+    uint32_t triangleCount;
+    // bounding sphere in mesh space
+    float center[3];
+    float radius;
+    // the winding normals of all triangles lie within the cone around axis, the cluster faces
+    // away from every viewer with dot(view direction, axis) >= cutoff, see cull.c.
+    // cutoff is above 1 when no viewer sees only back faces
+    float coneAxis[3];
+    float coneCutoff;
+} Meshlet;
+
+typedef struct MeshletBuild {
+    Meshlet *meshlets;
+    uint32_t meshletCount;
+    uint32_t *vertices;
+    uint32_t vertexCount;
+    uint8_t *triangles; // three per triangle
+    uint32_t triangleCount;
+} MeshletBuild;
+
+// positions are the first three floats every positionStride bytes. padding is added to every
+// radius, to cover the error of quantized positions
+void meshlet_build(MeshletBuild *build, const float *positions, size_t positionStride, uint32_t vertexCount,
+    const uint32_t *indices, uint32_t indexCount, float padding);
+// appends part's meshlets after build's, offsets rebased. build may start zeroed
+void meshlet_build_append(MeshletBuild *build, const MeshletBuild *part);
+void meshlet_build_free(MeshletBuild *build);
+
+#endif
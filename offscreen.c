@@ -0,0 +1,143 @@
+#include <string.h>
+#include "offscreen.h"
+#include "allocator.h"
+#include "timeline.h"
+
+static Allocation **offscreenTargets;
+
+void offscreen_create(VkFormat format, VkExtent2D extent, uint32_t count) {
+    swapchainImageCount = count;
+    swapChainImageFormat = format;
+    swapChainExtent = extent;
+    swapchainImageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    swapchainImages = malloc(sizeof(VkImage) * count);
+    offscreenTargets = malloc(sizeof(Allocation *) * count);
+
+    for (uint32_t i = 0; i < count; i++) {
+        VkImageCreateInfo imageInfo = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+            .imageType = VK_IMAGE_TYPE_2D,
+            .format = format,
+            .extent = {extent.width, extent.height, 1},
+            .mipLevels = 1,
+            .arrayLayers = 1,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .tiling = VK_IMAGE_TILING_OPTIMAL,
+            .usage = swapchainImageUsage,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+        };
+        offscreenTargets[i] = allocator_create_image(&imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        swapchainImages[i] = offscreenTargets[i]->image;
+    }
+}
+
+void offscreen_destroy(void) {
+    for (uint32_t i = 0; i < swapchainImageCount; i++) {
+        allocator_free(offscreenTargets[i]);
+    }
+    free(swapchainImages);
+    free(offscreenTargets);
+    swapchainImages = NULL;
+    offscreenTargets = NULL;
+    swapchainImageCount = 0;
+}
+
+void offscreen_readback(uint32_t index, uint8_t *pixels) {
+    assert(index < swapchainImageCount);
+    VkDeviceSize size = (VkDeviceSize) swapChainExtent.width * swapChainExtent.height * 4;
+
+    Allocation *readback = allocator_create_buffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    VkBuffer readbackBuffer = readback->buffer;
+
+    VkCommandPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+        .queueFamilyIndex = queueFamilyIdx
+    };
+    VkCommandPool pool;
+    VK(vkCreateCommandPool(device, &poolInfo, NULL, &pool));
+
+    VkCommandBufferAllocateInfo cmdAllocInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1
+    };
+    VkCommandBuffer cmd;
+    VK(vkAllocateCommandBuffers(device, &cmdAllocInfo, &cmd));
+
+    VkCommandBufferBeginInfo beginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+    };
+    VK(vkBeginCommandBuffer(cmd, &beginInfo));
+
+    // the frame's graph already left the image in TRANSFER_SRC_OPTIMAL with its writes visible to transfers
+    VkBufferImageCopy region = {
+        .bufferOffset = 0,
+        .bufferRowLength = 0,
+        .bufferImageHeight = 0,
+        .imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .imageSubresource.layerCount = 1,
+        .imageOffset = {0, 0, 0},
+        .imageExtent = {swapChainExtent.width, swapChainExtent.height, 1}
+    };
+    vkCmdCopyImageToBuffer(cmd, swapchainImages[index], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffer, 1, &region);
+
+    VkBufferMemoryBarrier toHost = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = readbackBuffer,
+        .offset = 0,
+        .size = VK_WHOLE_SIZE
+    };
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+        0, 0, NULL, 1, &toHost, 0, NULL);
+
+    VK(vkEndCommandBuffer(cmd));
+
+    timeline_wait(&graphicsTimeline, timeline_submit(&graphicsTimeline, graphicsQueue, NULL, 1, &cmd));
+
+    memcpy(pixels, readback->mapped, size);
+
+    vkDestroyCommandPool(device, pool, NULL);
+    allocator_free(readback);
+}
+
+void offscreen_write_ppm(uint32_t index, const char *path) {
+    uint32_t width = swapChainExtent.width;
+    uint32_t height = swapChainExtent.height;
+    bool bgr = swapChainImageFormat == VK_FORMAT_B8G8R8A8_SRGB || swapChainImageFormat == VK_FORMAT_B8G8R8A8_UNORM;
+
+    uint8_t *pixels = malloc((size_t) width * height * 4);
+    if (pixels == NULL) {
+        fprintf(stderr, "Failed to allocate memory for readback\n");
+        exit(1);
+    }
+    offscreen_readback(index, pixels);
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "Failed to open file: %s\n", path);
+        free(pixels);
+        exit(1);
+    }
+
+    fprintf(file, "P6\n%u %u\n255\n", width, height);
+    for (size_t i = 0; i < (size_t) width * height; i++) {
+        uint8_t *texel = &pixels[i * 4];
+        uint8_t rgb[3] = {
+            bgr ? texel[2] : texel[0],
+            texel[1],
+            bgr ? texel[0] : texel[2]
+        };
+        fwrite(rgb, 1, 3, file);
+    }
+    fclose(file);
+    free(pixels);
+}
@@ -0,0 +1,16 @@
+#ifndef VULK_OFFSCREEN_H
+#define VULK_OFFSCREEN_H
+
+#include "vulk.h"
+
+// device-local color targets that stand in for swapchain images in headless mode.
+// fills swapchainImages/swapchainImageCount/swapChainImageFormat/swapChainExtent
+void offscreen_create(VkFormat format, VkExtent2D extent, uint32_t count);
+void offscreen_destroy(void);
+
+// copies a rendered target (left in TRANSFER_SRC_OPTIMAL by the frame's graph) into
+// pixels, tightly packed at 4 bytes per texel in the target format's channel order
+void offscreen_readback(uint32_t index, uint8_t *pixels);
+void offscreen_write_ppm(uint32_t index, const char *path);
+
+#endif
@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include "pacing.h"
+#include "timer.h"
+
+// blocking we aim to keep as slack against scheduling jitter
+#define PACING_TARGET_BLOCK 0.0005
+#define PACING_GAIN 0.5
+#define PACING_EMA 0.1
+
+bool pacingEnabled = false;
+
+static double delay;
+static double lastPresent;
+static double sampleTime;
+static double blocked;
+
+// exponential moving averages
+static double intervalEma;
+static double workEma;
+
+// accumulated for the report
+static double blockedSum;
+static double delaySum;
+static double inputToPresentSum;
+static unsigned long long frames;
+
+void pacing_wait(void) {
+    if (pacingEnabled && lastPresent > 0.0 && delay > 0.0) {
+        timer_sleep_until(lastPresent + delay);
+    }
+    sampleTime = timer_now();
+}
+
+void pacing_blocked(double seconds) {
+    blocked = seconds;
+}
+
+void pacing_presented(void) {
+    double now = timer_now();
+    double work = now - sampleTime - blocked;
+
+    if (lastPresent > 0.0) {
+        double interval = now - lastPresent;
+        intervalEma = intervalEma > 0.0 ? intervalEma + PACING_EMA * (interval - intervalEma) : interval;
+    }
+    workEma = workEma > 0.0 ? workEma + PACING_EMA * (work - workEma) : work;
+
+    if (pacingEnabled) {
+        // blocked too long means input was sampled too early, push the sample later
+        delay += PACING_GAIN * (blocked - PACING_TARGET_BLOCK);
+
+        double maxDelay = intervalEma - workEma;
+        if (delay > maxDelay) {
+            delay = maxDelay;
+        }
+        if (delay < 0.0) {
+            delay = 0.0;
+        }
+    }
+
+    blockedSum += blocked;
+    delaySum += delay;
+    inputToPresentSum += now - sampleTime;
+    frames++;
+
+    lastPresent = now;
+    blocked = 0.0;
+}
+
+void pacing_report(void) {
+    if (frames == 0) {
+        return;
+    }
+    printf("pacing %s: interval %.2fms, delay %.2fms, blocked %.2fms, input to present %.2fms\n",
+        pacingEnabled ? "on" : "off",
+        intervalEma * 1000.0,
+        delaySum / frames * 1000.0,
+        blockedSum / frames * 1000.0,
+        inputToPresentSum / frames * 1000.0);
+}
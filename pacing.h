@@ -0,0 +1,23 @@
+#ifndef VULK_PACING_H
+#define VULK_PACING_H
+
+#include <stdbool.h>
+
+// low-latency frame pacing. with spare time in the frame the loop would otherwise sample
+// input, then block on the frame slot or acquire with that input going stale. the
+// controller instead sleeps before input is sampled, steering the delay so that the time
+// spent blocked in frame_begin/acquire stays near a small target
+extern bool pacingEnabled;
+
+// top of the frame loop, sleeps the controlled delay then marks the input sample time
+void pacing_wait(void);
+
+// seconds spent blocked waiting for the frame slot and swapchain image this frame
+void pacing_blocked(double seconds);
+
+// after present (or submit when headless), feeds the controller
+void pacing_presented(void);
+
+void pacing_report(void);
+
+#endif
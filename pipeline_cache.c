@@ -0,0 +1,144 @@
+#include <string.h>
+#include "pipeline_cache.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+VkPipelineCache pipelineCache;
+
+static bool pipeline_cache_valid(const uint8_t *data, size_t size) {
+    VkPipelineCacheHeaderVersionOne header;
+    if (size < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    return header.headerSize >= sizeof(header) &&
+        header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+        header.vendorID == properties.vendorID &&
+        header.deviceID == properties.deviceID &&
+        memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+void pipeline_cache_load(const char *path) {
+    uint8_t *data = NULL;
+    size_t size = 0;
+
+    FILE *file = fopen(path, "rb");
+    if (file != NULL) {
+        fseek(file, 0, SEEK_END);
+        long fileSize = ftell(file);
+        rewind(file);
+
+        if (fileSize > 0) {
+            data = malloc(fileSize);
+            if (data != NULL && fread(data, 1, fileSize, file) == (size_t) fileSize) {
+                size = fileSize;
+            }
+        }
+        fclose(file);
+    }
+
+    // a blob from another driver version or GPU is ignored rather than handed to the driver
+    if (size > 0 && !pipeline_cache_valid(data, size)) {
+        printf("pipeline cache %s is stale, starting empty\n", path);
+        size = 0;
+    }
+
+    VkPipelineCacheCreateInfo cacheInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .initialDataSize = size,
+        .pInitialData = size > 0 ? data : NULL
+    };
+    VK(vkCreatePipelineCache(device, &cacheInfo, NULL, &pipelineCache));
+    if (size > 0) {
+        printf("loaded %zu byte pipeline cache\n", size);
+    }
+    free(data);
+}
+
+VkPipelineCache pipeline_cache_create_worker(void) {
+    // seeded with everything pipelineCache holds, so the workers hit what was loaded from disk
+    size_t size = 0;
+    VK(vkGetPipelineCacheData(device, pipelineCache, &size, NULL));
+    uint8_t *data = size > 0 ? malloc(size) : NULL;
+    if (data != NULL) {
+        VK(vkGetPipelineCacheData(device, pipelineCache, &size, data));
+    } else {
+        size = 0;
+    }
+
+    VkPipelineCacheCreateInfo cacheInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .initialDataSize = size,
+        .pInitialData = data
+    };
+    VkPipelineCache cache;
+    VK(vkCreatePipelineCache(device, &cacheInfo, NULL, &cache));
+    free(data);
+    return cache;
+}
+
+void pipeline_cache_merge(VkPipelineCache *workerCaches, uint32_t count) {
+    if (count == 0) {
+        return;
+    }
+    VK(vkMergePipelineCaches(device, pipelineCache, count, workerCaches));
+    for (uint32_t i = 0; i < count; i++) {
+        vkDestroyPipelineCache(device, workerCaches[i], NULL);
+        workerCaches[i] = VK_NULL_HANDLE;
+    }
+}
+
+void pipeline_cache_save(const char *path) {
+    size_t size = 0;
+    VK(vkGetPipelineCacheData(device, pipelineCache, &size, NULL));
+    if (size == 0) {
+        return;
+    }
+
+    uint8_t *data = malloc(size);
+    if (data == NULL) {
+        fprintf(stderr, "Failed to allocate memory for pipeline cache\n");
+        return;
+    }
+    VK(vkGetPipelineCacheData(device, pipelineCache, &size, data));
+
+    char tmpPath[1024];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+
+    FILE *file = fopen(tmpPath, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "Failed to open file: %s\n", tmpPath);
+        free(data);
+        return;
+    }
+    size_t written = fwrite(data, 1, size, file);
+    int closed = fclose(file);
+    free(data);
+
+    if (written != size || closed != 0) {
+        fprintf(stderr, "Failed to write file: %s\n", tmpPath);
+        remove(tmpPath);
+        return;
+    }
+
+#ifdef _WIN32
+    bool renamed = MoveFileExA(tmpPath, path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    bool renamed = rename(tmpPath, path) == 0;
+#endif
+    if (!renamed) {
+        fprintf(stderr, "Failed to replace file: %s\n", path);
+        remove(tmpPath);
+    }
+}
+
+void pipeline_cache_destroy(void) {
+    vkDestroyPipelineCache(device, pipelineCache, NULL);
+    pipelineCache = VK_NULL_HANDLE;
+}
@@ -0,0 +1,20 @@
+#ifndef VULK_PIPELINE_CACHE_H
+#define VULK_PIPELINE_CACHE_H
+
+#include "vulk.h"
+
+extern VkPipelineCache pipelineCache;
+
+// creates pipelineCache, seeded from path when the blob was written by this driver and device
+void pipeline_cache_load(const char *path);
+
+// threads compiling pipelines use their own cache, seeded from pipelineCache and folded back
+// into it when done
+VkPipelineCache pipeline_cache_create_worker(void);
+void pipeline_cache_merge(VkPipelineCache *workerCaches, uint32_t count);
+
+// writes to a temporary file and renames it over path, so a crash never leaves a torn blob
+void pipeline_cache_save(const char *path);
+void pipeline_cache_destroy(void);
+
+#endif
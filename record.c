@@ -0,0 +1,120 @@
+#include "record.h"
+#include "frame.h"
+#include "jobs.h"
+
+// one secondary per range of jobs_parallel_for
+#define RECORD_MAX_CHUNKS JOBS_MAX_RANGES
+// below this many items per chunk the secondary buffer overhead outweighs the parallelism
+#define RECORD_MIN_CHUNK_ITEMS 64
+
+// one per thread per frame slot, reset the first time the thread records in a new frame
+typedef struct RecordPool {
+    VkCommandPool pool;
+    VkCommandBuffer *buffers;
+    uint32_t bufferCount;
+    uint32_t used;
+    uint64_t resetFrame;
+} RecordPool;
+
+typedef struct RecordJob {
+    VkCommandBufferInheritanceInfo inheritance;
+    RecordFunction function;
+    void *user;
+    uint32_t chunkSize;
+    VkCommandBuffer secondaries[RECORD_MAX_CHUNKS];
+} RecordJob;
+
+static RecordPool pools[JOBS_MAX_THREADS][MAX_FRAMES_IN_FLIGHT];
+static uint32_t poolThreadCount;
+
+static VkCommandBuffer next_buffer(RecordPool *pool) {
+    if (pool->resetFrame != frameNumber) {
+        // frame_begin has waited for the slot's last submission, nothing from it is pending
+        VK(vkResetCommandPool(device, pool->pool, 0));
+        pool->used = 0;
+        pool->resetFrame = frameNumber;
+    }
+    if (pool->used == pool->bufferCount) {
+        uint32_t count = pool->bufferCount ? pool->bufferCount * 2 : 8;
+        pool->buffers = realloc(pool->buffers, sizeof(VkCommandBuffer) * count);
+        VkCommandBufferAllocateInfo allocInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = pool->pool,
+            .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+            .commandBufferCount = count - pool->bufferCount
+        };
+        VK(vkAllocateCommandBuffers(device, &allocInfo, &pool->buffers[pool->bufferCount]));
+        pool->bufferCount = count;
+    }
+    return pool->buffers[pool->used++];
+}
+
+static void record_chunk(uint32_t begin, uint32_t end, void *user) {
+    RecordJob *job = user;
+    // pools are per job thread, whichever thread picked the chunk up owns this one
+    RecordPool *pool = &pools[jobs_thread_index()][currentFrame];
+    VkCommandBuffer commandBuffer = next_buffer(pool);
+    VkCommandBufferBeginInfo beginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .pInheritanceInfo = &job->inheritance
+    };
+    VK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+    job->function(commandBuffer, begin, end, job->user);
+    VK(vkEndCommandBuffer(commandBuffer));
+    job->secondaries[begin / job->chunkSize] = commandBuffer;
+}
+
+void record_init(void) {
+    poolThreadCount = jobs_thread_count();
+    for (uint32_t t = 0; t < poolThreadCount; t++) {
+        for (uint32_t f = 0; f < framesInFlight; f++) {
+            RecordPool *pool = &pools[t][f];
+            VkCommandPoolCreateInfo poolInfo = {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+                .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+                .queueFamilyIndex = queueFamilyIdx
+            };
+            VK(vkCreateCommandPool(device, &poolInfo, NULL, &pool->pool));
+            pool->buffers = NULL;
+            pool->bufferCount = 0;
+            pool->used = 0;
+            pool->resetFrame = UINT64_MAX;
+        }
+    }
+}
+
+void record_destroy(void) {
+    for (uint32_t t = 0; t < poolThreadCount; t++) {
+        for (uint32_t f = 0; f < framesInFlight; f++) {
+            vkDestroyCommandPool(device, pools[t][f].pool, NULL);
+            free(pools[t][f].buffers);
+            pools[t][f].buffers = NULL;
+        }
+    }
+    poolThreadCount = 0;
+}
+
+void record_parallel(VkCommandBuffer primary, const VkCommandBufferInheritanceInfo *inheritance,
+    uint32_t count, RecordFunction function, void *user) {
+    if (count == 0) {
+        return;
+    }
+
+    // a few chunks per thread so uneven chunks still balance
+    uint32_t chunkCount = poolThreadCount * 4;
+    uint32_t maxChunks = (count + RECORD_MIN_CHUNK_ITEMS - 1) / RECORD_MIN_CHUNK_ITEMS;
+    chunkCount = chunkCount < maxChunks ? chunkCount : maxChunks;
+    chunkCount = chunkCount < RECORD_MAX_CHUNKS ? chunkCount : RECORD_MAX_CHUNKS;
+
+    RecordJob job = {
+        .inheritance = *inheritance,
+        .function = function,
+        .user = user,
+        .chunkSize = (count + chunkCount - 1) / chunkCount
+    };
+    chunkCount = (count + job.chunkSize - 1) / job.chunkSize;
+    jobs_parallel_for(count, job.chunkSize, record_chunk, &job);
+
+    vkCmdExecuteCommands(primary, chunkCount, job.secondaries);
+}
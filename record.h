@@ -0,0 +1,22 @@
+#ifndef VULK_RECORD_H
+#define VULK_RECORD_H
+
+#include "vulk.h"
+
+// parallel command recording on the job system. a render pass's work is split into chunks,
+// job threads record each chunk into a secondary command buffer from their own per-frame pool,
+// and the primary executes them in chunk order so the result matches single threaded recording
+// records items [begin, end) into a secondary buffer that is already begun inside the
+// render pass. nothing is inherited but the pass, so pipelines, descriptor sets and
+// dynamic state have to be set by every chunk
+typedef void (*RecordFunction)(VkCommandBuffer commandBuffer, uint32_t begin, uint32_t end, void *user);
+
+// after jobs_init and frames_create
+void record_init(void);
+void record_destroy(void);
+
+// inside a pass begun for secondary contents, inheritance describes that pass. main thread only
+void record_parallel(VkCommandBuffer primary, const VkCommandBufferInheritanceInfo *inheritance,
+    uint32_t count, RecordFunction function, void *user);
+
+#endif
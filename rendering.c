@@ -0,0 +1,326 @@
+#include "rendering.h"
+#include "deletion.h"
+
+bool dynamicRenderingRequested = true;
+bool dynamicRendering = false;
+bool renderingDepthSampled = false;
+VkRenderPass renderPass;
+VkFormat depthFormat;
+
+static VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures = {
+    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR
+};
+static PFN_vkCmdBeginRenderingKHR cmdBeginRendering;
+static PFN_vkCmdEndRenderingKHR cmdEndRendering;
+// pNext targets of rendering_pipeline_info and rendering_inheritance, they have to outlive the calls
+static VkPipelineRenderingCreateInfoKHR pipelineRenderingInfo;
+static VkCommandBufferInheritanceRenderingInfoKHR inheritanceRenderingInfo;
+// render pass path only, views are supplied at begin
+static VkFramebuffer framebuffer;
+static VkExtent2D framebufferExtent;
+static VkImageUsageFlags framebufferColorUsage;
+// the same attachments loaded instead of cleared, compatible with renderPass
+static VkRenderPass loadRenderPass;
+
+// depth that only lives through the pass can stay in tile memory on GPUs that have it
+static VkImageUsageFlags depth_usage(void) {
+    if (renderingDepthSampled) {
+        return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    }
+    return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+}
+
+static void require_imageless(const VkPhysicalDeviceVulkan12Features *supported12,
+    VkPhysicalDeviceVulkan12Features *enabled12) {
+    if (!supported12->imagelessFramebuffer) {
+        fprintf(stderr, "Fatal: device supports neither dynamic rendering nor imageless framebuffers\n");
+        exit(1);
+    }
+    enabled12->imagelessFramebuffer = VK_TRUE;
+    printf("rendering: render pass\n");
+}
+
+void rendering_require_features(const VkPhysicalDeviceVulkan12Features *supported12,
+    VkPhysicalDeviceVulkan12Features *enabled12, const char **extensions, int *extensionCount) {
+    if (!dynamicRenderingRequested || !device_extension_supported(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME)) {
+        require_imageless(supported12, enabled12);
+        return;
+    }
+
+    VkPhysicalDeviceDynamicRenderingFeaturesKHR supported = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR
+    };
+    VkPhysicalDeviceFeatures2 features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &supported
+    };
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+    if (!supported.dynamicRendering) {
+        require_imageless(supported12, enabled12);
+        return;
+    }
+
+    extensions[(*extensionCount)++] = VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME;
+    dynamicRenderingFeatures.dynamicRendering = VK_TRUE;
+    dynamicRenderingFeatures.pNext = enabled12->pNext;
+    enabled12->pNext = &dynamicRenderingFeatures;
+    dynamicRendering = true;
+    printf("rendering: dynamic\n");
+}
+
+static VkFormat choose_depth_format(void) {
+    // D16 is guaranteed to work as a sampled depth attachment, D32 is preferred for precision
+    VkFormatFeatureFlags required = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    if (renderingDepthSampled) {
+        required |= VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+    }
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, VK_FORMAT_D32_SFLOAT, &properties);
+    if ((properties.optimalTilingFeatures & required) == required) {
+        return VK_FORMAT_D32_SFLOAT;
+    }
+    return VK_FORMAT_D16_UNORM;
+}
+
+void rendering_init(void) {
+    depthFormat = choose_depth_format();
+    if (dynamicRendering) {
+        cmdBeginRendering = (PFN_vkCmdBeginRenderingKHR) vkGetDeviceProcAddr(device, "vkCmdBeginRenderingKHR");
+        cmdEndRendering = (PFN_vkCmdEndRenderingKHR) vkGetDeviceProcAddr(device, "vkCmdEndRenderingKHR");
+        renderPass = VK_NULL_HANDLE;
+        return;
+    }
+
+    // the graph moves the images in and out of the attachment layouts around the pass
+    VkAttachmentDescription attachments[] = {
+        {
+            .format = swapChainImageFormat,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+            .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+            .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+            .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            .initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            .finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        },
+        {
+            .format = depthFormat,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+            .storeOp = renderingDepthSampled ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+            .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            .initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+            .finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        }
+    };
+
+    VkAttachmentReference colorAttachmentRef = {
+        .attachment = 0,
+        .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+    };
+    VkAttachmentReference depthAttachmentRef = {
+        .attachment = 1,
+        .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+    };
+
+    VkSubpassDescription subpass = {
+        .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+        .colorAttachmentCount = 1,
+        .pColorAttachments = &colorAttachmentRef,
+        .pDepthStencilAttachment = &depthAttachmentRef
+    };
+    VkRenderPassCreateInfo renderPassInfo = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+        .attachmentCount = 2,
+        .pAttachments = attachments,
+        .subpassCount = 1,
+        .pSubpasses = &subpass
+    };
+    VK(vkCreateRenderPass(device, &renderPassInfo, NULL, &renderPass));
+
+    // load ops do not affect compatibility, so pipelines and the framebuffer work with both
+    attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    VK(vkCreateRenderPass(device, &renderPassInfo, NULL, &loadRenderPass));
+}
+
+void rendering_destroy(void) {
+    vkDestroyFramebuffer(device, framebuffer, NULL);
+    framebuffer = VK_NULL_HANDLE;
+    vkDestroyRenderPass(device, renderPass, NULL);
+    vkDestroyRenderPass(device, loadRenderPass, NULL);
+    renderPass = loadRenderPass = VK_NULL_HANDLE;
+}
+
+void rendering_pipeline_info(VkGraphicsPipelineCreateInfo *pipelineInfo) {
+    if (!dynamicRendering) {
+        pipelineInfo->renderPass = renderPass;
+        pipelineInfo->subpass = 0;
+        return;
+    }
+    VkPipelineRenderingCreateInfoKHR renderingInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR,
+        .pNext = pipelineInfo->pNext,
+        .colorAttachmentCount = 1,
+        .pColorAttachmentFormats = &swapChainImageFormat,
+        .depthAttachmentFormat = depthFormat
+    };
+    pipelineRenderingInfo = renderingInfo;
+    pipelineInfo->pNext = &pipelineRenderingInfo;
+    pipelineInfo->renderPass = VK_NULL_HANDLE;
+}
+
+GraphImageDesc rendering_depth_desc(void) {
+    GraphImageDesc desc = {
+        .format = depthFormat,
+        .extent = swapChainExtent,
+        .usage = depth_usage(),
+        .aspect = VK_IMAGE_ASPECT_DEPTH_BIT
+    };
+    return desc;
+}
+
+// rebuilt whenever the swapchain changes extent or usage, the old one may still be in flight
+static void update_framebuffer(void) {
+    if (framebuffer != VK_NULL_HANDLE && framebufferExtent.width == swapChainExtent.width &&
+        framebufferExtent.height == swapChainExtent.height && framebufferColorUsage == swapchainImageUsage) {
+        return;
+    }
+    if (framebuffer != VK_NULL_HANDLE) {
+        deletion_framebuffer(framebuffer);
+    }
+
+    VkFramebufferAttachmentImageInfo attachmentInfos[] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_ATTACHMENT_IMAGE_INFO,
+            .usage = swapchainImageUsage,
+            .width = swapChainExtent.width,
+            .height = swapChainExtent.height,
+            .layerCount = 1,
+            .viewFormatCount = 1,
+            .pViewFormats = &swapChainImageFormat
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_ATTACHMENT_IMAGE_INFO,
+            .usage = depth_usage(),
+            .width = swapChainExtent.width,
+            .height = swapChainExtent.height,
+            .layerCount = 1,
+            .viewFormatCount = 1,
+            .pViewFormats = &depthFormat
+        }
+    };
+    VkFramebufferAttachmentsCreateInfo attachmentsInfo = {
+        .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_ATTACHMENTS_CREATE_INFO,
+        .attachmentImageInfoCount = 2,
+        .pAttachmentImageInfos = attachmentInfos
+    };
+    VkFramebufferCreateInfo framebufferInfo = {
+        .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+        .pNext = &attachmentsInfo,
+        .flags = VK_FRAMEBUFFER_CREATE_IMAGELESS_BIT,
+        .renderPass = renderPass,
+        .attachmentCount = 2,
+        .width = swapChainExtent.width,
+        .height = swapChainExtent.height,
+        .layers = 1
+    };
+    VK(vkCreateFramebuffer(device, &framebufferInfo, NULL, &framebuffer));
+    framebufferExtent = swapChainExtent;
+    framebufferColorUsage = swapchainImageUsage;
+}
+
+void rendering_begin(VkCommandBuffer commandBuffer, VkImageView colorView, VkImageView depthView,
+    const VkClearValue *clearColor, bool secondary) {
+    VkRect2D renderArea = {
+        .offset = {0, 0},
+        .extent = swapChainExtent
+    };
+    // depth clears to the far plane
+    VkClearValue clearDepth = {
+        .depthStencil = {1.0f, 0}
+    };
+    // only read when clearing
+    VkClearValue clearValues[] = {clearColor != NULL ? *clearColor : clearDepth, clearDepth};
+
+    if (!dynamicRendering) {
+        update_framebuffer();
+        VkImageView views[] = {colorView, depthView};
+        VkRenderPassAttachmentBeginInfo attachmentBeginInfo = {
+            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_ATTACHMENT_BEGIN_INFO,
+            .attachmentCount = 2,
+            .pAttachments = views
+        };
+        VkRenderPassBeginInfo renderPassBeginInfo = {
+            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+            .pNext = &attachmentBeginInfo,
+            .renderPass = clearColor != NULL ? renderPass : loadRenderPass,
+            .framebuffer = framebuffer,
+            .renderArea = renderArea,
+            .clearValueCount = clearColor != NULL ? 2 : 0,
+            .pClearValues = clearColor != NULL ? clearValues : NULL
+        };
+        vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo,
+            secondary ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+        return;
+    }
+
+    VkAttachmentLoadOp loadOp = clearColor != NULL ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+    VkRenderingAttachmentInfoKHR colorAttachment = {
+        .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR,
+        .imageView = colorView,
+        .imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .loadOp = loadOp,
+        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+        .clearValue = clearValues[0]
+    };
+    VkRenderingAttachmentInfoKHR depthAttachment = {
+        .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR,
+        .imageView = depthView,
+        .imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        .loadOp = loadOp,
+        .storeOp = renderingDepthSampled ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        .clearValue = clearDepth
+    };
+    VkRenderingInfoKHR renderingInfo = {
+        .sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR,
+        .flags = secondary ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR : 0,
+        .renderArea = renderArea,
+        .layerCount = 1,
+        .colorAttachmentCount = 1,
+        .pColorAttachments = &colorAttachment,
+        .pDepthAttachment = &depthAttachment
+    };
+    cmdBeginRendering(commandBuffer, &renderingInfo);
+}
+
+void rendering_end(VkCommandBuffer commandBuffer) {
+    if (!dynamicRendering) {
+        vkCmdEndRenderPass(commandBuffer);
+        return;
+    }
+    cmdEndRendering(commandBuffer);
+}
+
+VkCommandBufferInheritanceInfo rendering_inheritance(void) {
+    VkCommandBufferInheritanceInfo inheritance = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO
+    };
+    if (!dynamicRendering) {
+        // the framebuffer is optional here
+        inheritance.renderPass = renderPass;
+        inheritance.subpass = 0;
+        return inheritance;
+    }
+    VkCommandBufferInheritanceRenderingInfoKHR renderingInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR,
+        .colorAttachmentCount = 1,
+        .pColorAttachmentFormats = &swapChainImageFormat,
+        .depthAttachmentFormat = depthFormat,
+        .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT
+    };
+    inheritanceRenderingInfo = renderingInfo;
+    inheritance.pNext = &inheritanceRenderingInfo;
+    return inheritance;
+}
@@ -0,0 +1,48 @@
+#ifndef VULK_RENDERING_H
+#define VULK_RENDERING_H
+
+#include "vulk.h"
+#include "graph.h"
+
+// the pass drawing into the swapchain image and a depth target. with VK_KHR_dynamic_rendering
+// it is begun straight on the image views and pipelines only depend on the attachment formats.
+// devices without it (or --render-pass) use renderPass and a single imageless framebuffer
+// that only has to be rebuilt when the extent changes. either way both attachments are cleared
+// on begin (or loaded, for a pass continuing a cleared one), depth is only stored when it is
+// sampled afterwards, and the graph moves the images in and out of their attachment layouts
+// around the pass
+extern bool dynamicRenderingRequested;
+// set once the device is created
+extern bool dynamicRendering;
+// set before rendering_init when later passes sample depth: it is stored and gets sampled
+// usage instead of transient attachment
+extern bool renderingDepthSampled;
+// picked by rendering_init
+extern VkFormat depthFormat;
+
+// before device creation: when requested and supported, adds the extension to the list and
+// chains its feature struct onto enabled12->pNext, otherwise turns on imageless framebuffers
+void rendering_require_features(const VkPhysicalDeviceVulkan12Features *supported12,
+    VkPhysicalDeviceVulkan12Features *enabled12, const char **extensions, int *extensionCount);
+
+// after device creation and once swapChainImageFormat is known, builds renderPass if needed
+void rendering_init(void);
+void rendering_destroy(void);
+
+// points the pipeline at renderPass, or at the attachment formats of the dynamic pass
+void rendering_pipeline_info(VkGraphicsPipelineCreateInfo *pipelineInfo);
+
+// the depth target matching the current swapchain extent, for graph_create_image
+GraphImageDesc rendering_depth_desc(void);
+
+// clears color to clearColor and depth to the far plane, or keeps both when clearColor is NULL.
+// secondary means the pass contents are recorded into secondary command buffers begun
+// with rendering_inheritance
+void rendering_begin(VkCommandBuffer commandBuffer, VkImageView colorView, VkImageView depthView,
+    const VkClearValue *clearColor, bool secondary);
+void rendering_end(VkCommandBuffer commandBuffer);
+
+// inheritance for secondaries recorded inside the pass begun by rendering_begin
+VkCommandBufferInheritanceInfo rendering_inheritance(void);
+
+#endif
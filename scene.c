@@ -0,0 +1,310 @@
+#include <string.h>
+#include "scene.h"
+#include "allocator.h"
+#include "bindless.h"
+#include "compute.h"
+#include "staging.h"
+
+bool sceneIndirectRequested = true;
+bool sceneIndirect = false;
+bool sceneIndirectCount = false;
+bool sceneTwoPhase = false;
+bool sceneMeshShaderRequested = true;
+bool sceneMeshShading = false;
+bool sceneMeshTasks = false;
+VkPipelineStageFlags meshShaderStage = 0;
+
+SceneObject *sceneObjects;
+uint32_t sceneObjectCount;
+uint32_t sceneObjectBufferIndex = BINDLESS_INVALID;
+Meshlet *sceneMeshlets;
+uint32_t sceneMeshletCount;
+uint32_t sceneMeshletBufferIndex = BINDLESS_INVALID;
+MeshLod *sceneLods;
+uint32_t sceneLodCount;
+uint32_t sceneLodBufferIndex = BINDLESS_INVALID;
+uint32_t sceneClusterCount;
+uint32_t *sceneClusterObjects;
+uint32_t sceneClusterBufferIndex = BINDLESS_INVALID;
+
+SceneDrawList sceneDrawLists[MAX_FRAMES_IN_FLIGHT][SCENE_PHASE_COUNT];
+
+static Allocation *objectBuffer;
+static Allocation *meshletBuffer;
+static Allocation *lodBuffer;
+static Allocation *clusterBuffer;
+static uint32_t maxDrawIndirectCount;
+static uint32_t maxMeshTasks;
+static VkPhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures = {
+    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT
+};
+static PFN_vkCmdDrawMeshTasksIndirectEXT cmdDrawMeshTasksIndirect;
+
+void scene_require_features(const VkPhysicalDeviceFeatures *supported,
+    const VkPhysicalDeviceVulkan12Features *supported12, VkPhysicalDeviceVulkan12Features *enabled12) {
+    // the object index travels in firstInstance
+    sceneIndirect = sceneIndirectRequested && supported->multiDrawIndirect && supported->drawIndirectFirstInstance;
+    sceneIndirectCount = sceneIndirect && supported12->drawIndirectCount;
+    if (sceneIndirectCount) {
+        enabled12->drawIndirectCount = VK_TRUE;
+    }
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    maxDrawIndirectCount = properties.limits.maxDrawIndirectCount;
+    printf("scene: %s\n", sceneIndirectCount ? "indirect count" : (sceneIndirect ? "multi draw indirect" : "direct draws"));
+}
+
+void scene_require_mesh_shader(VkPhysicalDeviceVulkan12Features *enabled12, const char **extensions,
+    int *extensionCount) {
+    // the task count comes out of the cull's compacted count
+    if (!sceneMeshShaderRequested || !sceneIndirectCount || !device_extension_supported(VK_EXT_MESH_SHADER_EXTENSION_NAME)) {
+        return;
+    }
+    VkPhysicalDeviceMeshShaderFeaturesEXT supported = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT
+    };
+    VkPhysicalDeviceFeatures2 features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &supported
+    };
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+    VkPhysicalDeviceMeshShaderPropertiesEXT meshProperties = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_PROPERTIES_EXT
+    };
+    VkPhysicalDeviceProperties2 properties = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext = &meshProperties
+    };
+    vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+    // a workgroup of one invocation per meshlet vertex outputs a whole meshlet
+    if (!supported.meshShader || meshProperties.maxMeshOutputVertices < MESHLET_MAX_VERTICES ||
+        meshProperties.maxMeshOutputPrimitives < MESHLET_MAX_TRIANGLES ||
+        meshProperties.maxMeshWorkGroupInvocations < MESHLET_MAX_VERTICES) {
+        return;
+    }
+    maxMeshTasks = meshProperties.maxMeshWorkGroupCount[0] < meshProperties.maxMeshWorkGroupTotalCount ?
+        meshProperties.maxMeshWorkGroupCount[0] : meshProperties.maxMeshWorkGroupTotalCount;
+
+    extensions[(*extensionCount)++] = VK_EXT_MESH_SHADER_EXTENSION_NAME;
+    meshShaderFeatures.meshShader = VK_TRUE;
+    meshShaderFeatures.pNext = enabled12->pNext;
+    enabled12->pNext = &meshShaderFeatures;
+    sceneMeshShading = true;
+    meshShaderStage = VK_PIPELINE_STAGE_MESH_SHADER_BIT_EXT;
+}
+
+// staged when it fits the frame's region, otherwise written in place. shared buffers are
+// concurrent between the graphics and compute families
+static Allocation *upload(const void *data, VkDeviceSize size, VkBufferUsageFlags usage, bool shared) {
+    uint32_t families[] = {(uint32_t) queueFamilyIdx, (uint32_t) computeQueueFamilyIdx};
+    uint32_t familyCount = shared && computeQueueFamilyIdx >= 0 ? 2 : 0;
+    StagingAlloc staging = staging_alloc(size, 16);
+    if (staging.data == NULL) {
+        Allocation *allocation = allocator_create_shared_buffer(size, usage,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, families, familyCount);
+        memcpy(allocation->mapped, data, size);
+        return allocation;
+    }
+    Allocation *allocation = allocator_create_shared_buffer(size, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        families, familyCount);
+    memcpy(staging.data, data, size);
+    staging_copy(staging, allocation->buffer, 0, size);
+    return allocation;
+}
+
+bool scene_cluster_in_level(uint32_t cluster, uint32_t level) {
+    const SceneObject *object = &sceneObjects[sceneClusterObjects[cluster]];
+    if (object->lodCount == 0 || object->meshletCount == 0) {
+        return true;
+    }
+    const MeshLod *lod = &sceneLods[object->firstLod + level];
+    return cluster - object->firstCluster - lod->firstMeshlet < lod->meshletCount;
+}
+
+void scene_create(const SceneObject *objects, uint32_t count, const Meshlet *meshlets, uint32_t meshletCount,
+    const MeshLod *lods, uint32_t lodCount) {
+    sceneObjectCount = count;
+    sceneObjects = malloc(sizeof(SceneObject) * count);
+    memcpy(sceneObjects, objects, sizeof(SceneObject) * count);
+    sceneMeshletCount = meshletCount;
+    sceneMeshlets = malloc(sizeof(Meshlet) * meshletCount);
+    memcpy(sceneMeshlets, meshlets, sizeof(Meshlet) * meshletCount);
+    sceneLodCount = lodCount;
+    sceneLods = malloc(sizeof(MeshLod) * lodCount);
+    memcpy(sceneLods, lods, sizeof(MeshLod) * lodCount);
+
+    // objects without meshlets are a cluster of their own, mesh shaders need them all split
+    sceneClusterCount = 0;
+    bool allMeshlets = count > 0;
+    for (uint32_t i = 0; i < count; i++) {
+        sceneObjects[i].firstCluster = sceneClusterCount;
+        sceneClusterCount += sceneObjects[i].meshletCount > 0 ? sceneObjects[i].meshletCount : 1;
+        allMeshlets = allMeshlets && sceneObjects[i].meshletCount > 0;
+    }
+    sceneClusterObjects = malloc(sizeof(uint32_t) * (sceneClusterCount > 0 ? sceneClusterCount : 1));
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t clusters = sceneObjects[i].meshletCount > 0 ? sceneObjects[i].meshletCount : 1;
+        for (uint32_t c = 0; c < clusters; c++) {
+            sceneClusterObjects[sceneObjects[i].firstCluster + c] = i;
+        }
+    }
+    sceneMeshTasks = sceneMeshShading && sceneIndirect && allMeshlets && sceneClusterCount <= maxMeshTasks;
+    // a count draw takes at most maxDrawIndirectCount, past it the lists are drawn in chunks and
+    // the cull has to keep every cluster in its slot
+    if (sceneIndirectCount && !sceneMeshTasks && sceneClusterCount > maxDrawIndirectCount) {
+        sceneIndirectCount = false;
+        printf("scene: %u clusters exceed maxDrawIndirectCount %u, multi draw indirect\n", sceneClusterCount,
+            maxDrawIndirectCount);
+    }
+
+    VkDeviceSize objectSize = sizeof(SceneObject) * count;
+    objectBuffer = upload(sceneObjects, objectSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, true);
+    sceneObjectBufferIndex = bindless_add_buffer(objectBuffer->buffer, 0, objectSize);
+    if (meshletCount > 0) {
+        VkDeviceSize meshletSize = sizeof(Meshlet) * meshletCount;
+        meshletBuffer = upload(meshlets, meshletSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, true);
+        sceneMeshletBufferIndex = bindless_add_buffer(meshletBuffer->buffer, 0, meshletSize);
+    }
+    if (lodCount > 0) {
+        VkDeviceSize lodSize = sizeof(MeshLod) * lodCount;
+        lodBuffer = upload(lods, lodSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, true);
+        sceneLodBufferIndex = bindless_add_buffer(lodBuffer->buffer, 0, lodSize);
+    }
+    printf("scene: %u objects, %u clusters%s\n", count, sceneClusterCount, sceneMeshTasks ? ", mesh shaders" : "");
+    if (!sceneIndirect || sceneClusterCount == 0) {
+        return;
+    }
+    VkDeviceSize clusterSize = sizeof(uint32_t) * sceneClusterCount;
+    clusterBuffer = upload(sceneClusterObjects, clusterSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, true);
+    sceneClusterBufferIndex = bindless_add_buffer(clusterBuffer->buffer, 0, clusterSize);
+    if (sceneMeshTasks) {
+        cmdDrawMeshTasksIndirect = (PFN_vkCmdDrawMeshTasksIndirectEXT) vkGetDeviceProcAddr(device,
+            "vkCmdDrawMeshTasksIndirectEXT");
+    }
+
+    // sized for the larger entry either way. cluster entries are packed at their own stride,
+    // the late list's are never read before the late cull writes them. only level 0 is listed
+    VkDrawIndexedIndirectCommand *commands = malloc(sizeof(VkDrawIndexedIndirectCommand) * sceneClusterCount);
+    VkDrawIndexedIndirectCommand *lateCommands = malloc(sizeof(VkDrawIndexedIndirectCommand) * sceneClusterCount);
+    SceneClusterDraw *clusterDraws = (SceneClusterDraw *) commands;
+    uint32_t taskCount = 0;
+    for (uint32_t i = 0; i < sceneClusterCount; i++) {
+        const SceneObject *object = &sceneObjects[sceneClusterObjects[i]];
+        uint32_t meshlet = object->firstMeshlet + i - object->firstCluster;
+        bool listed = scene_cluster_in_level(i, 0);
+        VkDrawIndexedIndirectCommand command = {
+            .indexCount = object->indexCount,
+            .instanceCount = listed ? 1 : 0,
+            .firstIndex = object->firstIndex,
+            .vertexOffset = object->vertexOffset,
+            .firstInstance = sceneClusterObjects[i]
+        };
+        if (object->meshletCount > 0) {
+            command.indexCount = 3 * meshlets[meshlet].triangleCount;
+            command.firstIndex = object->firstIndex + 3 * meshlets[meshlet].triangleOffset;
+        } else if (object->lodCount > 0) {
+            command.indexCount = lods[object->firstLod].indexCount;
+            command.firstIndex = object->firstIndex + lods[object->firstLod].firstIndex;
+        }
+        if (sceneMeshTasks && listed) {
+            clusterDraws[taskCount++] = (SceneClusterDraw) {
+                .object = sceneClusterObjects[i],
+                .meshlet = meshlet
+            };
+        } else if (!sceneMeshTasks) {
+            commands[i] = command;
+        }
+        command.instanceCount = 0;
+        lateCommands[i] = command;
+    }
+    // written by compute with ownership transfers, see cull.c. the indexed lists keep the other
+    // levels' clusters in their slots with instanceCount 0
+    VkDeviceSize drawsSize = sizeof(VkDrawIndexedIndirectCommand) * sceneClusterCount;
+    VkDrawMeshTasksIndirectCommandEXT count = {sceneMeshTasks ? taskCount : sceneClusterCount, 1, 1};
+    VkDrawMeshTasksIndirectCommandEXT lateCount = {0, 1, 1};
+    for (uint32_t i = 0; i < framesInFlight; i++) {
+        for (uint32_t phase = 0; phase < (sceneTwoPhase ? SCENE_PHASE_COUNT : 1); phase++) {
+            SceneDrawList *list = &sceneDrawLists[i][phase];
+            list->draws = upload(phase == SCENE_EARLY ? commands : lateCommands, drawsSize,
+                VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, false);
+            list->count = upload(phase == SCENE_EARLY ? &count : &lateCount, sizeof(count),
+                VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, false);
+            list->drawsIndex = bindless_add_buffer(list->draws->buffer, 0, drawsSize);
+            list->countIndex = bindless_add_buffer(list->count->buffer, 0, sizeof(count));
+        }
+    }
+    free(commands);
+    free(lateCommands);
+}
+
+void scene_destroy(void) {
+    if (sceneObjectBufferIndex != BINDLESS_INVALID) {
+        bindless_release(BINDLESS_BUFFER, sceneObjectBufferIndex);
+        sceneObjectBufferIndex = BINDLESS_INVALID;
+    }
+    allocator_free(objectBuffer);
+    objectBuffer = NULL;
+    if (sceneMeshletBufferIndex != BINDLESS_INVALID) {
+        bindless_release(BINDLESS_BUFFER, sceneMeshletBufferIndex);
+        sceneMeshletBufferIndex = BINDLESS_INVALID;
+    }
+    allocator_free(meshletBuffer);
+    meshletBuffer = NULL;
+    if (sceneLodBufferIndex != BINDLESS_INVALID) {
+        bindless_release(BINDLESS_BUFFER, sceneLodBufferIndex);
+        sceneLodBufferIndex = BINDLESS_INVALID;
+    }
+    allocator_free(lodBuffer);
+    lodBuffer = NULL;
+    if (sceneClusterBufferIndex != BINDLESS_INVALID) {
+        bindless_release(BINDLESS_BUFFER, sceneClusterBufferIndex);
+        sceneClusterBufferIndex = BINDLESS_INVALID;
+    }
+    allocator_free(clusterBuffer);
+    clusterBuffer = NULL;
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT * SCENE_PHASE_COUNT; i++) {
+        SceneDrawList *list = &sceneDrawLists[i / SCENE_PHASE_COUNT][i % SCENE_PHASE_COUNT];
+        if (list->draws == NULL) {
+            continue;
+        }
+        bindless_release(BINDLESS_BUFFER, list->drawsIndex);
+        bindless_release(BINDLESS_BUFFER, list->countIndex);
+        allocator_free(list->draws);
+        allocator_free(list->count);
+        list->draws = list->count = NULL;
+    }
+    free(sceneObjects);
+    sceneObjects = NULL;
+    sceneObjectCount = 0;
+    free(sceneMeshlets);
+    sceneMeshlets = NULL;
+    sceneMeshletCount = 0;
+    free(sceneLods);
+    sceneLods = NULL;
+    sceneLodCount = 0;
+    free(sceneClusterObjects);
+    sceneClusterObjects = NULL;
+    sceneClusterCount = 0;
+    sceneMeshTasks = false;
+}
+
+void scene_draw(VkCommandBuffer commandBuffer, ScenePhase phase) {
+    VkBuffer drawBuffer = sceneDrawLists[currentFrame][phase].draws->buffer;
+    VkBuffer countBuffer = sceneDrawLists[currentFrame][phase].count->buffer;
+    uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+    if (sceneMeshTasks) {
+        cmdDrawMeshTasksIndirect(commandBuffer, countBuffer, 0, 1, sizeof(VkDrawMeshTasksIndirectCommandEXT));
+        return;
+    }
+    if (sceneIndirectCount) {
+        vkCmdDrawIndexedIndirectCount(commandBuffer, drawBuffer, 0, countBuffer, 0,
+            sceneClusterCount, stride);
+        return;
+    }
+    // the limit is usually 2^32 - 1, but the spec only guarantees 2^16 - 1
+    for (uint32_t first = 0; first < sceneClusterCount; first += maxDrawIndirectCount) {
+        uint32_t count = sceneClusterCount - first < maxDrawIndirectCount ? sceneClusterCount - first : maxDrawIndirectCount;
+        vkCmdDrawIndexedIndirect(commandBuffer, drawBuffer, (VkDeviceSize) first * stride, count, stride);
+    }
+}
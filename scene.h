@@ -0,0 +1,138 @@
+#ifndef VULK_SCENE_H
+#define VULK_SCENE_H
+
+#include <cglm/cglm.h>
+#include "vulk.h"
+#include "allocator.h"
+#include "frame.h"
+#include "meshlet.h"
+#include "simplify.h"
+
+// the scene's objects and their draw list, resident on the GPU. each object has an entry in
+// a storage buffer that shaders read by index, and a VkDrawIndexedIndirectCommand whose
+// firstInstance is that index. the whole list goes out in one vkCmdDrawIndexedIndirectCount
+// per pipeline, so recording cost does not grow with the object count. devices without
+// drawIndirectCount use vkCmdDrawIndexedIndirect over the full list, and devices without
+// multiDrawIndirect or drawIndirectFirstInstance (or --direct-draws) one draw per object.
+// every frame slot has a draw list of its own, so cull.c can rewrite the next frame's on the
+// compute queue while the current one is drawn. they start out listing every object. with
+// two-phase occlusion culling each slot has a second, late list drawn after the depth pyramid
+// is built, it starts out empty.
+//
+// objects with meshlets are drawn and culled per meshlet: every (object, meshlet) pair is a
+// cluster with its own entry in the lists, drawing the meshlet's range of the index buffer.
+// objects without are a single cluster covering the whole object. with VK_EXT_mesh_shader
+// (and every object split into meshlets) the entries name the clusters instead and a single
+// vkCmdDrawMeshTasksIndirectEXT runs a mesh shader workgroup per listed cluster.
+//
+// objects with levels of detail hold every level's clusters, the cull lists only those of the
+// level lod.c selected for the object. objects drawn whole draw that level's index range. the
+// lists start out with level 0
+
+// mirrored by Object in shaders/scene.glsl
+typedef struct SceneObject {
+    // position = attribute * positionScale + positionOffset
+    vec4 positionScale;
+    vec4 positionOffset;
+    uint32_t indexCount;
+    uint32_t firstIndex;
+    int32_t vertexOffset;
+    uint32_t materialIndex;
+    // world space AABB for culling, w unused
+    vec4 boundsMin;
+    vec4 boundsMax;
+    // mesh space to world, xyz translation and w uniform scale. places the meshlet bounds
+    vec4 transform;
+    // the object's range of sceneMeshlets, none draws it whole. covers all of its levels
+    uint32_t firstMeshlet;
+    uint32_t meshletCount;
+    // set by scene_create, the object's first cluster
+    uint32_t firstCluster;
+    // the object's range of sceneLods, none always draws indexCount from firstIndex. the
+    // levels' index and meshlet ranges are relative to firstIndex and firstMeshlet
+    uint32_t firstLod;
+    uint32_t lodCount;
+    uint32_t reserved[3];
+} SceneObject;
+
+// a list entry with sceneMeshTasks, mirrored by ClusterDraw in the shaders
+typedef struct SceneClusterDraw {
+    uint32_t object;
+    uint32_t meshlet; // into sceneMeshlets
+} SceneClusterDraw;
+
+typedef enum ScenePhase {
+    SCENE_EARLY, // the only list without two-phase culling
+    SCENE_LATE,
+    SCENE_PHASE_COUNT
+} ScenePhase;
+
+typedef struct SceneDrawList {
+    // VkDrawIndexedIndirectCommand per cluster, or SceneClusterDraw with sceneMeshTasks
+    Allocation *draws;
+    // a VkDrawMeshTasksIndirectCommandEXT whose groupCountX is the draw count
+    Allocation *count;
+    // bindless indices of both, for writing them from shaders
+    uint32_t drawsIndex;
+    uint32_t countIndex;
+} SceneDrawList;
+
+extern bool sceneIndirectRequested;
+// set by scene_require_features
+extern bool sceneIndirect;
+// cleared by scene_create when the clusters exceed maxDrawIndirectCount
+extern bool sceneIndirectCount;
+// set before scene_create to get the late draw lists
+extern bool sceneTwoPhase;
+// --no-mesh-shader clears it
+extern bool sceneMeshShaderRequested;
+// set by scene_require_mesh_shader, the device runs mesh shaders
+extern bool sceneMeshShading;
+// set by scene_create, the lists are drawn with mesh shaders
+extern bool sceneMeshTasks;
+
+// CPU copy of the uploaded objects
+extern SceneObject *sceneObjects;
+extern uint32_t sceneObjectCount;
+// bindless index of the object buffer, which graphics and compute both read
+extern uint32_t sceneObjectBufferIndex;
+// CPU copy of the meshlet table and the bindless index of the uploaded one
+extern Meshlet *sceneMeshlets;
+extern uint32_t sceneMeshletCount;
+extern uint32_t sceneMeshletBufferIndex;
+// CPU copy of the level of detail table and the bindless index of the uploaded one
+extern MeshLod *sceneLods;
+extern uint32_t sceneLodCount;
+extern uint32_t sceneLodBufferIndex;
+// every object's clusters in order, and the object of each (CPU copy and bindless index)
+extern uint32_t sceneClusterCount;
+extern uint32_t *sceneClusterObjects;
+extern uint32_t sceneClusterBufferIndex;
+// per frame slot and phase, only with sceneIndirect
+extern SceneDrawList sceneDrawLists[MAX_FRAMES_IN_FLIGHT][SCENE_PHASE_COUNT];
+
+// before device creation (all core features are enabled when supported): picks the draw path
+// and turns on drawIndirectCount if it is used
+void scene_require_features(const VkPhysicalDeviceFeatures *supported,
+    const VkPhysicalDeviceVulkan12Features *supported12, VkPhysicalDeviceVulkan12Features *enabled12);
+
+// before device creation, after scene_require_features: adds VK_EXT_mesh_shader to the list
+// and chains its features onto enabled12->pNext when requested and the device can draw a
+// meshlet per workgroup
+void scene_require_mesh_shader(VkPhysicalDeviceVulkan12Features *enabled12, const char **extensions,
+    int *extensionCount);
+
+// after frames_create and compute_init: copies the objects, meshlets and levels of detail and
+// queues the uploads of them and their draw lists into staging
+void scene_create(const SceneObject *objects, uint32_t count, const Meshlet *meshlets, uint32_t meshletCount,
+    const MeshLod *lods, uint32_t lodCount);
+void scene_destroy(void);
+
+// whether the cluster belongs to the object's level, always for objects without levels
+bool scene_cluster_in_level(uint32_t cluster, uint32_t level);
+
+// the indirect draw of the current frame slot's list for the phase, with pipeline (the mesh
+// shader one with sceneMeshTasks), descriptors and mesh already bound
+void scene_draw(VkCommandBuffer commandBuffer, ScenePhase phase);
+
+#endif
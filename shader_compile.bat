@@ -1,3 +1,6 @@
 @echo off
 "C:\VulkanSDK\1.3.275.0\Bin\glslc.exe" shaders/shader.frag -o shaders/frag.spv
-"C:\VulkanSDK\1.3.275.0\Bin\glslc.exe" shaders/shader.vert -o shaders/vert.spv
\ No newline at end of file
+"C:\VulkanSDK\1.3.275.0\Bin\glslc.exe" shaders/shader.vert -o shaders/vert.spv
+"C:\VulkanSDK\1.3.275.0\Bin\glslc.exe" shaders/cull.comp -o shaders/cull.spv
+"C:\VulkanSDK\1.3.275.0\Bin\glslc.exe" shaders/hiz.comp -o shaders/hiz.spv
+"C:\VulkanSDK\1.3.275.0\Bin\glslc.exe" --target-env=vulkan1.2 shaders/meshlet.mesh -o shaders/mesh.spv
\ No newline at end of file
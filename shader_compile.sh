@@ -0,0 +1,6 @@
+#!/bin/sh
+glslc shaders/shader.frag -o shaders/frag.spv
+glslc shaders/shader.vert -o shaders/vert.spv
+glslc shaders/cull.comp -o shaders/cull.spv
+glslc shaders/hiz.comp -o shaders/hiz.spv
+glslc --target-env=vulkan1.2 shaders/meshlet.mesh -o shaders/mesh.spv
@@ -0,0 +1,20 @@
+// the global descriptor table from bindless.c, the binding is the BindlessKind
+#extension GL_EXT_nonuniform_qualifier : require
+
+#define BINDLESS_INVALID 0xffffffffu
+
+struct Material {
+    vec4 baseColor;
+    uint texture;
+    uint sampler;
+    uint pad0;
+    uint pad1;
+};
+
+// every storage buffer lives in binding 0, each view of it declares its own block type
+layout(set = 0, binding = 0, std430) readonly buffer MaterialBuffer {
+    Material materials[];
+} materialBuffers[];
+
+layout(set = 0, binding = 1) uniform texture2D textures[];
+layout(set = 0, binding = 2) uniform sampler samplers[];
@@ -0,0 +1,59 @@
+// the per object data from scene.c, shaders index it with the draw's firstInstance.
+// needs bindless.glsl for the descriptor table
+struct Object {
+    vec4 positionScale;
+    vec4 positionOffset;
+    uint indexCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint materialIndex;
+    // world space AABB, w unused
+    vec4 boundsMin;
+    vec4 boundsMax;
+    // mesh space to world, xyz translation and w uniform scale
+    vec4 transform;
+    uint firstMeshlet;
+    uint meshletCount; // 0 for objects drawn whole
+    uint firstCluster;
+    // range of the Lod table, 0 for objects without levels of detail
+    uint firstLod;
+    uint lodCount;
+    uint reserved[3];
+};
+
+// mirrored by Meshlet in meshlet.h
+struct Meshlet {
+    uint vertexOffset;
+    uint triangleOffset;
+    uint vertexCount;
+    uint triangleCount;
+    vec4 sphere; // mesh space center and radius
+    vec4 cone; // axis and cutoff
+};
+
+// mirrored by MeshLod in simplify.h, index and meshlet ranges relative to the object's
+struct Lod {
+    uint firstIndex;
+    uint indexCount;
+    uint firstMeshlet;
+    uint meshletCount;
+    float error;
+};
+
+// a list entry when the scene is drawn with mesh shaders
+struct ClusterDraw {
+    uint object;
+    uint meshlet;
+};
+
+layout(set = 0, binding = 0, std430) readonly buffer ObjectBuffer {
+    Object objects[];
+} objectBuffers[];
+
+layout(set = 0, binding = 0, std430) readonly buffer MeshletBuffer {
+    Meshlet meshlets[];
+} meshletBuffers[];
+
+layout(set = 0, binding = 0, std430) readonly buffer LodBuffer {
+    Lod lods[];
+} lodBuffers[];
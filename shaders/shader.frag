@@ -1,9 +1,29 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "bindless.glsl"
 
 layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec3 fragNormal;
+layout(location = 2) in vec2 fragUV;
+layout(location = 3) flat in uint fragMaterial;
+
+layout(push_constant) uniform PushConstants {
+    mat4 viewProj;
+    uint objectBuffer;
+    uint materialBuffer;
+} pc;
 
 layout(location = 0) out vec4 outColor;
 
 void main() {
-    outColor = vec4(fragColor, 1.0);
-}
\ No newline at end of file
+    Material material = materialBuffers[nonuniformEXT(pc.materialBuffer)].materials[fragMaterial];
+    vec3 color = fragColor * material.baseColor.rgb;
+    if (material.texture != BINDLESS_INVALID) {
+        color *= texture(sampler2D(textures[nonuniformEXT(material.texture)], samplers[nonuniformEXT(material.sampler)]), fragUV).rgb;
+    }
+
+    // headlight, surfaces facing the viewer keep their full vertex color
+    float shade = 0.25 + 0.75 * abs(normalize(fragNormal).z);
+    outColor = vec4(color * shade, 1.0);
+}
@@ -1,20 +1,43 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
 
-layout(location = 0) out vec3 fragColor;
+#include "bindless.glsl"
+#include "scene.glsl"
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec4 inNormal;
+layout(location = 2) in vec2 inUV;
+layout(location = 3) in vec4 inColor;
+
+// packed layouts store normals as two octahedral snorm components
+layout(constant_id = 0) const bool OCTAHEDRAL_NORMALS = false;
 
-vec2 positions[3] = vec2[](
-    vec2(0.0, -0.5),
-    vec2(0.5, 0.5),
-    vec2(-0.5, 0.5)
-);
+layout(push_constant) uniform PushConstants {
+    mat4 viewProj;
+    uint objectBuffer;
+    uint materialBuffer;
+} pc;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 fragNormal;
+layout(location = 2) out vec2 fragUV;
+layout(location = 3) flat out uint fragMaterial;
 
-vec3 colors[3] = vec3[](
-    vec3(1.0, 0.0, 0.0),
-    vec3(0.0, 1.0, 0.0),
-    vec3(0.0, 0.0, 1.0)
-);
+vec3 octahedral_decode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
 
 void main() {
-    gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
-    fragColor = colors[gl_VertexIndex];
-}
\ No newline at end of file
+    // gl_InstanceIndex starts at the draw's firstInstance, the object index
+    Object object = objectBuffers[nonuniformEXT(pc.objectBuffer)].objects[gl_InstanceIndex];
+    vec3 position = inPosition * object.positionScale.xyz + object.positionOffset.xyz;
+    gl_Position = pc.viewProj * vec4(position, 1.0);
+    fragColor = inColor.rgb;
+    fragUV = inUV;
+    fragMaterial = object.materialIndex;
+    fragNormal = OCTAHEDRAL_NORMALS ? octahedral_decode(inNormal.xy) : inNormal.xyz;
+}
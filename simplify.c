@@ -0,0 +1,483 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "simplify.h"
+
+// levels below this many triangles are not worth a draw of their own
+#define SIMPLIFY_MIN_TRIANGLES 32
+// border planes are weighted up so borders stay in place rather than shrink
+#define SIMPLIFY_BORDER_WEIGHT 10.0
+// a collapse may turn a triangle's normal by at most about 75 degrees
+#define SIMPLIFY_MAX_TURN 0.25
+
+// sum of area weighted squared plane distances, p^T A p + 2 b.p + c
+typedef struct Quadric {
+    double a00, a11, a22, a01, a02, a12;
+    double b0, b1, b2;
+    double c;
+    double weight;
+} Quadric;
+
+typedef enum VertexKind {
+    VERTEX_KIND_MANIFOLD,
+    VERTEX_KIND_BORDER,
+    VERTEX_KIND_LOCKED
+} VertexKind;
+
+typedef struct Collapse {
+    uint32_t from;
+    uint32_t to;
+    double error;
+} Collapse;
+
+// the triangles around each vertex, by the position it shares with others
+typedef struct Adjacency {
+    uint32_t *offsets;
+    uint32_t *triangles;
+} Adjacency;
+
+static const float *position(const float *positions, size_t stride, uint32_t index) {
+    return (const float *) ((const uint8_t *) positions + stride * index);
+}
+
+static void quadric_add_plane(Quadric *q, const double n[3], double d, double weight) {
+    q->a00 += weight * n[0] * n[0];
+    q->a11 += weight * n[1] * n[1];
+    q->a22 += weight * n[2] * n[2];
+    q->a01 += weight * n[0] * n[1];
+    q->a02 += weight * n[0] * n[2];
+    q->a12 += weight * n[1] * n[2];
+    q->b0 += weight * n[0] * d;
+    q->b1 += weight * n[1] * d;
+    q->b2 += weight * n[2] * d;
+    q->c += weight * d * d;
+    q->weight += weight;
+}
+
+static void quadric_add(Quadric *q, const Quadric *other) {
+    q->a00 += other->a00;
+    q->a11 += other->a11;
+    q->a22 += other->a22;
+    q->a01 += other->a01;
+    q->a02 += other->a02;
+    q->a12 += other->a12;
+    q->b0 += other->b0;
+    q->b1 += other->b1;
+    q->b2 += other->b2;
+    q->c += other->c;
+    q->weight += other->weight;
+}
+
+// the mean squared distance of p from the planes
+static double quadric_error(const Quadric *q, const float *p) {
+    double x = p[0], y = p[1], z = p[2];
+    double e = q->a00 * x * x + q->a11 * y * y + q->a22 * z * z
+        + 2.0 * (q->a01 * x * y + q->a02 * x * z + q->a12 * y * z)
+        + 2.0 * (q->b0 * x + q->b1 * y + q->b2 * z) + q->c;
+    return q->weight > 0.0 ? fabs(e) / q->weight : 0.0;
+}
+
+static void triangle_normal(const float *a, const float *b, const float *c, double n[3]) {
+    double ab[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+    double ac[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+    n[0] = ab[1] * ac[2] - ab[2] * ac[1];
+    n[1] = ab[2] * ac[0] - ab[0] * ac[2];
+    n[2] = ab[0] * ac[1] - ab[1] * ac[0];
+}
+
+static uint32_t hash_position(const float *p) {
+    uint32_t bits[3];
+    memcpy(bits, p, sizeof(bits));
+    return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+}
+
+// shared[v] is the first vertex at v's position
+static void find_shared_positions(const float *positions, size_t stride, uint32_t vertexCount, uint32_t *shared) {
+    uint32_t tableSize = 1;
+    while (tableSize < 2 * vertexCount) {
+        tableSize *= 2;
+    }
+    uint32_t *table = malloc(sizeof(uint32_t) * tableSize);
+    memset(table, 0xff, sizeof(uint32_t) * tableSize);
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        const float *p = position(positions, stride, v);
+        uint32_t slot = hash_position(p) & (tableSize - 1);
+        while (table[slot] != UINT32_MAX && memcmp(position(positions, stride, table[slot]), p, 3 * sizeof(float)) != 0) {
+            slot = (slot + 1) & (tableSize - 1);
+        }
+        if (table[slot] == UINT32_MAX) {
+            table[slot] = v;
+        }
+        shared[v] = table[slot];
+    }
+    free(table);
+}
+
+static void build_adjacency(Adjacency *adjacency, const uint32_t *indices, uint32_t indexCount, const uint32_t *shared,
+    uint32_t vertexCount) {
+    memset(adjacency->offsets, 0, sizeof(uint32_t) * (vertexCount + 1));
+    for (uint32_t i = 0; i < indexCount; i++) {
+        adjacency->offsets[shared[indices[i]]]++;
+    }
+    // offsets become where each vertex's triangles end, then filling back to front moves them
+    // to where they start
+    for (uint32_t v = 1; v <= vertexCount; v++) {
+        adjacency->offsets[v] += adjacency->offsets[v - 1];
+    }
+    for (uint32_t i = indexCount; i-- > 0;) {
+        adjacency->triangles[--adjacency->offsets[shared[indices[i]]]] = i / 3;
+    }
+}
+
+// whether a triangle winds from a to b, both shared positions
+static bool has_half_edge(const Adjacency *adjacency, const uint32_t *indices, const uint32_t *shared, uint32_t a,
+    uint32_t b) {
+    for (uint32_t k = adjacency->offsets[a]; k < adjacency->offsets[a + 1]; k++) {
+        const uint32_t *t = &indices[3 * adjacency->triangles[k]];
+        for (uint32_t e = 0; e < 3; e++) {
+            if (shared[t[e]] == a && shared[t[(e + 1) % 3]] == b) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// moves the collapse that sorts nth into place, cheaper ones before it and the rest after
+static void select_collapse(Collapse *collapses, uint32_t count, uint32_t nth) {
+    int64_t low = 0;
+    int64_t high = (int64_t) count - 1;
+    while (low < high) {
+        double pivot = collapses[low + (high - low) / 2].error;
+        int64_t i = low;
+        int64_t j = high;
+        while (i <= j) {
+            while (collapses[i].error < pivot) {
+                i++;
+            }
+            while (collapses[j].error > pivot) {
+                j--;
+            }
+            if (i <= j) {
+                Collapse swap = collapses[i];
+                collapses[i++] = collapses[j];
+                collapses[j--] = swap;
+            }
+        }
+        if (nth <= j) {
+            high = j;
+        } else if (nth >= i) {
+            low = i;
+        } else {
+            return;
+        }
+    }
+}
+
+static int compare_collapses(const void *a, const void *b) {
+    double ea = ((const Collapse *) a)->error;
+    double eb = ((const Collapse *) b)->error;
+    return ea < eb ? -1 : (ea > eb ? 1 : 0);
+}
+
+// the vertex quadrics from the triangle planes, plus the planes through border edges
+// perpendicular to their triangle
+static void compute_quadrics(Quadric *quadrics, const uint32_t *indices, uint32_t indexCount, const float *positions,
+    size_t stride, const uint32_t *shared, const Adjacency *adjacency) {
+    for (uint32_t i = 0; i < indexCount; i += 3) {
+        const float *p[3];
+        for (uint32_t k = 0; k < 3; k++) {
+            p[k] = position(positions, stride, indices[i + k]);
+        }
+        double n[3];
+        triangle_normal(p[0], p[1], p[2], n);
+        double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length == 0.0) {
+            continue;
+        }
+        n[0] /= length;
+        n[1] /= length;
+        n[2] /= length;
+        double d = -(n[0] * p[0][0] + n[1] * p[0][1] + n[2] * p[0][2]);
+        // the cross product is twice the area
+        for (uint32_t k = 0; k < 3; k++) {
+            quadric_add_plane(&quadrics[indices[i + k]], n, d, 0.5 * length);
+        }
+
+        for (uint32_t k = 0; k < 3; k++) {
+            uint32_t a = shared[indices[i + k]];
+            uint32_t b = shared[indices[i + (k + 1) % 3]];
+            if (has_half_edge(adjacency, indices, shared, b, a)) {
+                continue;
+            }
+            const float *pa = p[k];
+            const float *pb = p[(k + 1) % 3];
+            double edge[3] = {pb[0] - pa[0], pb[1] - pa[1], pb[2] - pa[2]};
+            double edgeLengthSquared = edge[0] * edge[0] + edge[1] * edge[1] + edge[2] * edge[2];
+            double side[3] = {
+                edge[1] * n[2] - edge[2] * n[1],
+                edge[2] * n[0] - edge[0] * n[2],
+                edge[0] * n[1] - edge[1] * n[0]
+            };
+            double sideLength = sqrt(side[0] * side[0] + side[1] * side[1] + side[2] * side[2]);
+            if (sideLength == 0.0) {
+                continue;
+            }
+            side[0] /= sideLength;
+            side[1] /= sideLength;
+            side[2] /= sideLength;
+            double sideD = -(side[0] * pa[0] + side[1] * pa[1] + side[2] * pa[2]);
+            quadric_add_plane(&quadrics[indices[i + k]], side, sideD, SIMPLIFY_BORDER_WEIGHT * edgeLengthSquared);
+            quadric_add_plane(&quadrics[indices[i + (k + 1) % 3]], side, sideD,
+                SIMPLIFY_BORDER_WEIGHT * edgeLengthSquared);
+        }
+    }
+}
+
+// moving from onto to must not turn any triangle that keeps from around too far
+static bool collapse_flips(const Collapse *collapse, const uint32_t *indices, const float *positions, size_t stride,
+    const Adjacency *adjacency) {
+    const float *target = position(positions, stride, collapse->to);
+    for (uint32_t k = adjacency->offsets[collapse->from]; k < adjacency->offsets[collapse->from + 1]; k++) {
+        const uint32_t *t = &indices[3 * adjacency->triangles[k]];
+        if (t[0] == collapse->to || t[1] == collapse->to || t[2] == collapse->to) {
+            continue;
+        }
+        const float *before[3];
+        const float *after[3];
+        for (uint32_t e = 0; e < 3; e++) {
+            before[e] = position(positions, stride, t[e]);
+            after[e] = t[e] == collapse->from ? target : before[e];
+        }
+        double n0[3], n1[3];
+        triangle_normal(before[0], before[1], before[2], n0);
+        triangle_normal(after[0], after[1], after[2], n1);
+        double dot = n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2];
+        double lengths = sqrt((n0[0] * n0[0] + n0[1] * n0[1] + n0[2] * n0[2]) * (n1[0] * n1[0] + n1[1] * n1[1] + n1[2] * n1[2]));
+        if (dot < SIMPLIFY_MAX_TURN * lengths) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t simplify(uint32_t *destination, const uint32_t *indices, uint32_t indexCount, const float *positions,
+    size_t positionStride, uint32_t vertexCount, uint32_t targetIndexCount, float *error) {
+    memcpy(destination, indices, sizeof(uint32_t) * indexCount);
+    *error = 0.0f;
+    if (indexCount <= targetIndexCount || vertexCount == 0) {
+        return indexCount;
+    }
+
+    uint32_t *shared = malloc(sizeof(uint32_t) * vertexCount);
+    find_shared_positions(positions, positionStride, vertexCount, shared);
+    // seams keep one copy per set of attributes, moving one would tear the surface open
+    bool *locked = calloc(vertexCount, sizeof(bool));
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        if (shared[v] != v) {
+            locked[v] = locked[shared[v]] = true;
+        }
+    }
+
+    Adjacency adjacency = {
+        .offsets = malloc(sizeof(uint32_t) * (vertexCount + 1)),
+        .triangles = malloc(sizeof(uint32_t) * indexCount)
+    };
+    build_adjacency(&adjacency, destination, indexCount, shared, vertexCount);
+    Quadric *quadrics = calloc(vertexCount, sizeof(Quadric));
+    compute_quadrics(quadrics, destination, indexCount, positions, positionStride, shared, &adjacency);
+
+    uint8_t *kinds = malloc(vertexCount);
+    // per corner, whether the edge to the next corner of its triangle has no twin
+    bool *borders = malloc(sizeof(bool) * indexCount);
+    bool *touched = malloc(sizeof(bool) * vertexCount);
+    uint32_t *remap = malloc(sizeof(uint32_t) * vertexCount);
+    // at most one per triangle edge
+    Collapse *collapses = malloc(sizeof(Collapse) * indexCount);
+    double maxError = 0.0;
+    bool widen = false;
+
+    while (indexCount > targetIndexCount) {
+        // borders as the surface stands now
+        for (uint32_t v = 0; v < vertexCount; v++) {
+            kinds[v] = locked[v] ? VERTEX_KIND_LOCKED : VERTEX_KIND_MANIFOLD;
+        }
+        for (uint32_t i = 0; i < indexCount; i++) {
+            uint32_t a = shared[destination[i]];
+            uint32_t b = shared[destination[i - i % 3 + (i + 1) % 3]];
+            borders[i] = !has_half_edge(&adjacency, destination, shared, b, a);
+            if (borders[i]) {
+                kinds[a] = kinds[a] == VERTEX_KIND_LOCKED ? VERTEX_KIND_LOCKED : VERTEX_KIND_BORDER;
+                kinds[b] = kinds[b] == VERTEX_KIND_LOCKED ? VERTEX_KIND_LOCKED : VERTEX_KIND_BORDER;
+            }
+        }
+
+        // each interior edge is seen from both its triangles, it is taken from the one
+        // winding from the lower to the higher vertex. border edges only have the one.
+        // of the two directions only the cheaper is kept
+        uint32_t collapseCount = 0;
+        for (uint32_t i = 0; i < indexCount; i++) {
+            uint32_t a = destination[i];
+            uint32_t b = destination[i - i % 3 + (i + 1) % 3];
+            if (!borders[i] && shared[a] > shared[b]) {
+                continue;
+            }
+            Collapse best = {.error = -1.0};
+            for (uint32_t direction = 0; direction < 2; direction++) {
+                uint32_t from = direction == 0 ? a : b;
+                uint32_t to = direction == 0 ? b : a;
+                // border vertices only slide along the border
+                if (kinds[from] == VERTEX_KIND_LOCKED || (kinds[from] == VERTEX_KIND_BORDER && !borders[i])) {
+                    continue;
+                }
+                Quadric q = quadrics[from];
+                quadric_add(&q, &quadrics[to]);
+                double error = quadric_error(&q, position(positions, positionStride, to));
+                if (best.error < 0.0 || error < best.error) {
+                    best = (Collapse) {.from = from, .to = to, .error = error};
+                }
+            }
+            if (best.error >= 0.0) {
+                collapses[collapseCount++] = best;
+            }
+        }
+        if (collapseCount == 0) {
+            break;
+        }
+
+        // the pass takes the cheap end of the list, about enough to reach the target, and
+        // only sorts that. a vertex whose fan changed is left for the next pass, its flip test
+        // would be stale
+        uint32_t trianglesLeft = indexCount / 3;
+        uint32_t targetTriangles = targetIndexCount / 3;
+        uint32_t goal = (trianglesLeft - targetTriangles + 1) / 2;
+        uint32_t candidateCount = collapseCount;
+        if (!widen && goal < collapseCount) {
+            select_collapse(collapses, collapseCount, goal);
+            double passLimit = 1.5 * collapses[goal].error;
+            candidateCount = 0;
+            for (uint32_t c = 0; c < collapseCount; c++) {
+                if (collapses[c].error <= passLimit) {
+                    Collapse swap = collapses[candidateCount];
+                    collapses[candidateCount++] = collapses[c];
+                    collapses[c] = swap;
+                }
+            }
+        }
+        qsort(collapses, candidateCount, sizeof(Collapse), compare_collapses);
+
+        memset(touched, 0, sizeof(bool) * vertexCount);
+        for (uint32_t v = 0; v < vertexCount; v++) {
+            remap[v] = v;
+        }
+        uint32_t applied = 0;
+        for (uint32_t c = 0; c < candidateCount && trianglesLeft > targetTriangles; c++) {
+            const Collapse *collapse = &collapses[c];
+            if (touched[collapse->from] || touched[collapse->to]) {
+                continue;
+            }
+            bool fanTouched = false;
+            uint32_t removed = 0;
+            for (uint32_t k = adjacency.offsets[collapse->from]; k < adjacency.offsets[collapse->from + 1]; k++) {
+                const uint32_t *t = &destination[3 * adjacency.triangles[k]];
+                fanTouched = fanTouched || touched[t[0]] || touched[t[1]] || touched[t[2]];
+                removed += t[0] == collapse->to || t[1] == collapse->to || t[2] == collapse->to;
+            }
+            if (fanTouched || collapse_flips(collapse, destination, positions, positionStride, &adjacency)) {
+                continue;
+            }
+
+            remap[collapse->from] = collapse->to;
+            quadric_add(&quadrics[collapse->to], &quadrics[collapse->from]);
+            for (uint32_t k = adjacency.offsets[collapse->from]; k < adjacency.offsets[collapse->from + 1]; k++) {
+                const uint32_t *t = &destination[3 * adjacency.triangles[k]];
+                touched[t[0]] = touched[t[1]] = touched[t[2]] = true;
+            }
+            maxError = collapse->error > maxError ? collapse->error : maxError;
+            trianglesLeft = trianglesLeft > removed ? trianglesLeft - removed : 0;
+            applied++;
+        }
+        // every cheap collapse was blocked, the next pass tries them all
+        if (applied == 0 && candidateCount < collapseCount) {
+            widen = true;
+            continue;
+        }
+        widen = false;
+        if (applied == 0) {
+            break;
+        }
+
+        // collapsed edges leave triangles with a repeated position behind
+        uint32_t written = 0;
+        for (uint32_t i = 0; i < indexCount; i += 3) {
+            uint32_t a = remap[destination[i]];
+            uint32_t b = remap[destination[i + 1]];
+            uint32_t c = remap[destination[i + 2]];
+            if (shared[a] != shared[b] && shared[b] != shared[c] && shared[c] != shared[a]) {
+                destination[written++] = a;
+                destination[written++] = b;
+                destination[written++] = c;
+            }
+        }
+        indexCount = written;
+        build_adjacency(&adjacency, destination, indexCount, shared, vertexCount);
+    }
+
+    free(collapses);
+    free(remap);
+    free(touched);
+    free(borders);
+    free(kinds);
+    free(quadrics);
+    free(adjacency.offsets);
+    free(adjacency.triangles);
+    free(locked);
+    free(shared);
+    *error = (float) sqrt(maxError);
+    return indexCount;
+}
+
+void simplify_lod_chain(LodChain *chain, const float *positions, size_t positionStride, uint32_t vertexCount,
+    const uint32_t *indices, uint32_t indexCount) {
+    memset(chain, 0, sizeof(*chain));
+    // a level keeps at most 3/4 of the one before, so they add up to less than four times the
+    // full mesh
+    chain->indices = malloc(sizeof(uint32_t) * (indexCount > 0 ? 4 * (size_t) indexCount : 1));
+    memcpy(chain->indices, indices, sizeof(uint32_t) * indexCount);
+    chain->indexCount = indexCount;
+    chain->lods[0] = (MeshLod) {.firstIndex = 0, .indexCount = indexCount};
+    chain->lodCount = 1;
+
+    uint32_t *scratch = malloc(sizeof(uint32_t) * (indexCount > 0 ? indexCount : 1));
+    while (chain->lodCount < MESH_MAX_LODS) {
+        const MeshLod *previous = &chain->lods[chain->lodCount - 1];
+        uint32_t target = previous->indexCount / 6 * 3;
+        if (target < 3 * SIMPLIFY_MIN_TRIANGLES) {
+            break;
+        }
+        float error;
+        uint32_t count = simplify(scratch, chain->indices + previous->firstIndex, previous->indexCount, positions,
+            positionStride, vertexCount, target, &error);
+        // what is left is held in place by borders and seams, a coarser target would not help
+        if ((uint64_t) count * 4 > (uint64_t) previous->indexCount * 3) {
+            break;
+        }
+        memcpy(chain->indices + chain->indexCount, scratch, sizeof(uint32_t) * count);
+        chain->lods[chain->lodCount] = (MeshLod) {
+            .firstIndex = chain->indexCount,
+            .indexCount = count,
+            // the surface moved at most this far from the previous level, which was at most its
+            // error from the full one
+            .error = previous->error + error
+        };
+        chain->indexCount += count;
+        chain->lodCount++;
+    }
+    free(scratch);
+}
+
+void simplify_lod_chain_free(LodChain *chain) {
+    free(chain->indices);
+    memset(chain, 0, sizeof(*chain));
+}
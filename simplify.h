@@ -0,0 +1,46 @@
+#ifndef VULK_SIMPLIFY_H
+#define VULK_SIMPLIFY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// mesh simplification with quadric error metrics (Garland and Heckbert): edges collapse into
+// one of their endpoints in order of the squared plane distances the collapse adds, so the
+// vertices stay as they are and every level of detail is only a new index buffer over them.
+// vertices sharing a position with another (attribute seams) never move, open borders only
+// move along themselves
+#define MESH_MAX_LODS 8
+
+// a level of detail, a range of the index buffer and the meshlets covering it (none when the
+// mesh has no meshlets). stored as is in .vmesh files, mirrored by Lod in shaders/scene.glsl
+typedef struct MeshLod {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    uint32_t firstMeshlet;
+    uint32_t meshletCount;
+    // in mesh space, how far the level's surface may be from the full detail one
+    float error;
+} MeshLod;
+
+typedef struct LodChain {
+    // every level's indices one after the other, level 0 the input as is
+    uint32_t *indices;
+    uint32_t indexCount;
+    MeshLod lods[MESH_MAX_LODS];
+    uint32_t lodCount;
+} LodChain;
+
+// positions are the first three floats every positionStride bytes. writes at most indexCount
+// indices to destination and returns how many, stopping at targetIndexCount or once nothing
+// can collapse any more. error is set to the level's MeshLod.error
+uint32_t simplify(uint32_t *destination, const uint32_t *indices, uint32_t indexCount, const float *positions,
+    size_t positionStride, uint32_t vertexCount, uint32_t targetIndexCount, float *error);
+
+// halves the triangle count per level until it stops shrinking. each level is simplified from
+// the one before, which keeps the whole chain about as cheap as its first level. the meshlet
+// ranges are left for the caller
+void simplify_lod_chain(LodChain *chain, const float *positions, size_t positionStride, uint32_t vertexCount,
+    const uint32_t *indices, uint32_t indexCount);
+void simplify_lod_chain_free(LodChain *chain);
+
+#endif
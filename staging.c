@@ -0,0 +1,240 @@
+#include <string.h>
+#include "staging.h"
+#include "allocator.h"
+#include "atomics.h"
+#include "frame.h"
+#include "timeline.h"
+
+#define STAGING_MAX_COPIES 4096
+
+typedef struct StagingCopy {
+    VkBuffer dst;
+    VkDeviceSize srcOffset;
+    VkDeviceSize dstOffset;
+    VkDeviceSize size;
+} StagingCopy;
+
+typedef struct StagingRegion {
+    VkDeviceSize begin;
+    VkDeviceSize end;
+    volatile uint64_t head;
+    VkDeviceSize peak;
+    StagingCopy copies[STAGING_MAX_COPIES];
+    volatile uint32_t copyCount;
+} StagingRegion;
+
+static Allocation *ring;
+static StagingRegion *regions;
+static uint32_t regionCount;
+static uint32_t current;
+static VkDeviceSize defaultAlignment;
+static volatile uint32_t overflowed;
+
+void staging_init(VkDeviceSize size) {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    defaultAlignment = 16;
+    if (properties.limits.minUniformBufferOffsetAlignment > defaultAlignment) {
+        defaultAlignment = properties.limits.minUniformBufferOffsetAlignment;
+    }
+    if (properties.limits.minStorageBufferOffsetAlignment > defaultAlignment) {
+        defaultAlignment = properties.limits.minStorageBufferOffsetAlignment;
+    }
+
+    ring = allocator_create_buffer(size,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    regionCount = framesInFlight;
+    regions = calloc(regionCount, sizeof(StagingRegion));
+    VkDeviceSize regionSize = (size / regionCount) & ~(VkDeviceSize) 255;
+    for (uint32_t i = 0; i < regionCount; i++) {
+        regions[i].begin = regionSize * i;
+        regions[i].end = regionSize * (i + 1);
+        regions[i].head = regions[i].begin;
+    }
+    current = 0;
+}
+
+void staging_destroy(void) {
+    VkDeviceSize peak = 0;
+    for (uint32_t i = 0; i < regionCount; i++) {
+        peak = regions[i].peak > peak ? regions[i].peak : peak;
+    }
+    printf("staging: peak %llu/%llu KiB per frame\n", (unsigned long long) (peak / 1024),
+        (unsigned long long) ((regions[0].end - regions[0].begin) / 1024));
+
+    allocator_free(ring);
+    free(regions);
+    ring = NULL;
+    regions = NULL;
+    regionCount = 0;
+}
+
+void staging_begin_frame(uint32_t frameIndex) {
+    StagingRegion *region = &regions[frameIndex];
+    VkDeviceSize used = atomic_load_u64(&region->head) - region->begin;
+    region->peak = used > region->peak ? used : region->peak;
+
+    // copies queued outside a frame (load time, or a frame dropped before submit)
+    // have not been recorded yet, their source data has to survive into this frame
+    if (atomic_load_u32(&region->copyCount) == 0) {
+        atomic_store_u64(&region->head, region->begin);
+    }
+    current = frameIndex;
+}
+
+StagingAlloc staging_alloc(VkDeviceSize size, VkDeviceSize alignment) {
+    StagingRegion *region = &regions[current];
+    if (alignment == 0) {
+        alignment = defaultAlignment;
+    }
+
+    uint64_t head = atomic_load_u64(&region->head);
+    for (;;) {
+        VkDeviceSize offset = (head + alignment - 1) & ~(alignment - 1);
+        if (offset + size > region->end) {
+            if (atomic_add_u32(&overflowed, 1) == 0) {
+                fprintf(stderr, "staging ring exhausted (%llu bytes requested)\n", (unsigned long long) size);
+            }
+            StagingAlloc none = {0};
+            return none;
+        }
+        // head is refreshed on failure, retry against what the other thread left
+        if (atomic_cas_u64(&region->head, &head, offset + size)) {
+            StagingAlloc result = {
+                .data = (uint8_t *) ring->mapped + offset,
+                .buffer = ring->buffer,
+                .offset = offset
+            };
+            return result;
+        }
+    }
+}
+
+void staging_copy(StagingAlloc src, VkBuffer dst, VkDeviceSize dstOffset, VkDeviceSize size) {
+    StagingRegion *region = &regions[current];
+    uint32_t index = atomic_add_u32(&region->copyCount, 1);
+    if (index >= STAGING_MAX_COPIES) {
+        fprintf(stderr, "Fatal: more than %d staging copies in one frame\n", STAGING_MAX_COPIES);
+        exit(1);
+    }
+
+    StagingCopy copy = {
+        .dst = dst,
+        .srcOffset = src.offset,
+        .dstOffset = dstOffset,
+        .size = size
+    };
+    region->copies[index] = copy;
+}
+
+static int compare_copies(const void *a, const void *b) {
+    const StagingCopy *copyA = a;
+    const StagingCopy *copyB = b;
+    int dst = memcmp(&copyA->dst, &copyB->dst, sizeof(VkBuffer));
+    if (dst != 0) {
+        return dst;
+    }
+    return copyA->dstOffset < copyB->dstOffset ? -1 : (copyA->dstOffset > copyB->dstOffset ? 1 : 0);
+}
+
+void staging_flush(VkCommandBuffer commandBuffer) {
+    // a copy bumps the count before it writes its slot, so none may be in flight here: a
+    // racing one could be sorted half written or dropped by the reset below
+    StagingRegion *region = &regions[current];
+    uint32_t copyCount = atomic_load_u32(&region->copyCount);
+    if (copyCount == 0) {
+        return;
+    }
+
+    // grouped by destination, then uploads that are contiguous on both sides collapse into one region
+    qsort(region->copies, copyCount, sizeof(StagingCopy), compare_copies);
+
+    static VkBufferCopy regionsOut[STAGING_MAX_COPIES];
+    uint32_t start = 0;
+    while (start < copyCount) {
+        VkBuffer dst = region->copies[start].dst;
+        uint32_t regionCountOut = 0;
+
+        uint32_t i = start;
+        for (; i < copyCount && memcmp(&region->copies[i].dst, &dst, sizeof(VkBuffer)) == 0; i++) {
+            StagingCopy *copy = &region->copies[i];
+            VkBufferCopy *last = regionCountOut > 0 ? &regionsOut[regionCountOut - 1] : NULL;
+            if (last != NULL && last->srcOffset + last->size == copy->srcOffset &&
+                last->dstOffset + last->size == copy->dstOffset) {
+                last->size += copy->size;
+            } else {
+                VkBufferCopy merged = {
+                    .srcOffset = copy->srcOffset,
+                    .dstOffset = copy->dstOffset,
+                    .size = copy->size
+                };
+                regionsOut[regionCountOut++] = merged;
+            }
+        }
+
+        vkCmdCopyBuffer(commandBuffer, ring->buffer, dst, regionCountOut, regionsOut);
+        start = i;
+    }
+
+    VkMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+            VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+        meshShaderStage | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 1, &barrier, 0, NULL, 0, NULL);
+
+    atomic_store_u32(&region->copyCount, 0);
+}
+
+VkDeviceSize staging_remaining(VkDeviceSize alignment) {
+    StagingRegion *region = &regions[current];
+    if (alignment == 0) {
+        alignment = defaultAlignment;
+    }
+    VkDeviceSize offset = (atomic_load_u64(&region->head) + alignment - 1) & ~(alignment - 1);
+    return offset < region->end ? region->end - offset : 0;
+}
+
+void staging_sync(void) {
+    StagingRegion *region = &regions[current];
+    if (atomic_load_u32(&region->copyCount) > 0) {
+        VkCommandPoolCreateInfo poolInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+            .queueFamilyIndex = queueFamilyIdx
+        };
+        VkCommandPool pool;
+        VK(vkCreateCommandPool(device, &poolInfo, NULL, &pool));
+
+        VkCommandBufferAllocateInfo cmdAllocInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = pool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = 1
+        };
+        VkCommandBuffer cmd;
+        VK(vkAllocateCommandBuffers(device, &cmdAllocInfo, &cmd));
+
+        VkCommandBufferBeginInfo beginInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+        };
+        VK(vkBeginCommandBuffer(cmd, &beginInfo));
+        staging_flush(cmd);
+        VK(vkEndCommandBuffer(cmd));
+
+        timeline_wait(&graphicsTimeline, timeline_submit(&graphicsTimeline, graphicsQueue, NULL, 1, &cmd));
+        vkDestroyCommandPool(device, pool, NULL);
+    }
+
+    VkDeviceSize used = atomic_load_u64(&region->head) - region->begin;
+    region->peak = used > region->peak ? used : region->peak;
+    atomic_store_u64(&region->head, region->begin);
+}
@@ -0,0 +1,42 @@
+#ifndef VULK_STAGING_H
+#define VULK_STAGING_H
+
+#include "vulk.h"
+
+// persistently mapped ring split into one region per frame slot. any thread can
+// sub-allocate from the current frame's region with a lock-free bump pointer, and the
+// region is recycled when the slot comes round again (its submission has completed)
+typedef struct StagingAlloc {
+    void *data; // NULL when the frame's region is exhausted
+    VkBuffer buffer;
+    VkDeviceSize offset;
+} StagingAlloc;
+
+void staging_init(VkDeviceSize size);
+void staging_destroy(void);
+
+// call after frame_begin, recycles the slot's region unless copies are still queued in it
+void staging_begin_frame(uint32_t frameIndex);
+
+// usable directly as uniform, vertex, index or storage data for this frame,
+// or as the source of a staging_copy
+StagingAlloc staging_alloc(VkDeviceSize size, VkDeviceSize alignment);
+
+// queues a copy into dst, recorded by the next staging_flush. safe against other copies and
+// allocations on any thread, but not against a flush: every copy has to have returned before
+// staging_flush starts (every caller today is on the main thread)
+void staging_copy(StagingAlloc src, VkBuffer dst, VkDeviceSize dstOffset, VkDeviceSize size);
+
+// records the queued copies, merged into as few regions and vkCmdCopyBuffer calls as
+// possible, followed by one barrier making them visible to vertex input and shaders.
+// main thread only, with no staging_copy in flight
+void staging_flush(VkCommandBuffer commandBuffer);
+
+// bytes left in the current region at the given alignment, for callers that chunk large uploads
+VkDeviceSize staging_remaining(VkDeviceSize alignment);
+
+// load time only: submits the queued copies on a one-shot command buffer, waits for
+// them and rewinds the current region, so uploads larger than a region can stream through it
+void staging_sync(void);
+
+#endif
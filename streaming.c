@@ -0,0 +1,363 @@
+#include <string.h>
+#include "streaming.h"
+#include "allocator.h"
+#include "atomics.h"
+#include "staging.h"
+#include "thread.h"
+
+#define STREAMING_MAX_REQUESTS 1024
+#define STREAMING_BATCH_SIZE (8 * 1024 * 1024)
+#define STREAMING_MAX_COPIES 64
+
+// everything the graphics queue may read from a streamed buffer
+#define STREAMING_DST_STAGES (VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | \
+    VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | meshShaderStage | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | \
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT)
+#define STREAMING_DST_ACCESS (VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | \
+    VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT)
+
+typedef struct StreamingRequest {
+    const uint8_t *data;
+    VkDeviceSize size;
+    VkDeviceSize done; // bytes already handed to a batch or the staging ring
+    VkBuffer dst;
+    VkDeviceSize dstOffset;
+    uint64_t ticket;
+} StreamingRequest;
+
+typedef enum BatchState {
+    BATCH_FREE,
+    BATCH_SUBMITTED, // on the transfer queue, waiting for a frame to acquire it
+    BATCH_ACQUIRED // a frame waits on it, free once that frame has retired
+} BatchState;
+
+typedef struct StreamingBatch {
+    BatchState state;
+    VkCommandPool commandPool;
+    VkCommandBuffer commandBuffer;
+    uint64_t timelineValue; // transferTimeline value signalled by its submission
+    VkDeviceSize stagingOffset;
+    // the released ranges, acquired again on the graphics queue
+    VkBufferMemoryBarrier barriers[STREAMING_MAX_COPIES];
+    uint32_t barrierCount;
+    uint64_t completedTicket;
+    uint64_t retireValue; // graphicsTimeline value of the frame that acquired it
+} StreamingBatch;
+
+int transferQueueFamilyIdx = -1;
+VkQueue transferQueue;
+Timeline transferTimeline;
+
+static StreamingRequest requests[STREAMING_MAX_REQUESTS];
+static uint32_t requestHead;
+static uint32_t requestTail;
+static uint64_t nextTicket = 1;
+static volatile uint64_t completedTicket;
+static uint64_t acquiredValue; // transferTimeline value the current frame waits on, 0 for none
+
+static StreamingBatch batches[STREAMING_BATCHES];
+static Allocation *stagingBuffer;
+static Thread worker;
+static Mutex mutex;
+static Cond cond;
+static bool quit;
+
+bool streaming_select_queue(VkDeviceQueueCreateInfo *queueInfo) {
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, NULL);
+    VkQueueFamilyProperties families[32];
+    familyCount = familyCount < 32 ? familyCount : 32;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families);
+
+    // transfer-only families are backed by the copy engines, compute families are the next best thing
+    int dedicated = -1, shared = -1;
+    for (uint32_t i = 0; i < familyCount; i++) {
+        VkQueueFlags flags = families[i].queueFlags;
+        if ((int) i == queueFamilyIdx || families[i].queueCount == 0 || (flags & VK_QUEUE_GRAPHICS_BIT)) {
+            continue;
+        }
+        if (!(flags & VK_QUEUE_COMPUTE_BIT) && (flags & VK_QUEUE_TRANSFER_BIT) && dedicated < 0) {
+            dedicated = (int) i;
+        } else if ((flags & (VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT)) && shared < 0) {
+            shared = (int) i;
+        }
+    }
+    transferQueueFamilyIdx = dedicated >= 0 ? dedicated : shared;
+    if (transferQueueFamilyIdx < 0) {
+        return false;
+    }
+
+    static float priority = 0.5f;
+    VkDeviceQueueCreateInfo info = {
+        .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+        .queueFamilyIndex = transferQueueFamilyIdx,
+        .queueCount = 1,
+        .pQueuePriorities = &priority
+    };
+    *queueInfo = info;
+    return true;
+}
+
+// fills one batch from the front of the request queue, records and submits it
+static void submit_batch(StreamingBatch *batch, uint32_t *head, uint32_t tail) {
+    VkBuffer dsts[STREAMING_MAX_COPIES];
+    VkBufferCopy copies[STREAMING_MAX_COPIES];
+    uint32_t copyCount = 0;
+    VkDeviceSize used = 0;
+    uint64_t finished = batch->completedTicket;
+
+    while (*head != tail && copyCount < STREAMING_MAX_COPIES && used < STREAMING_BATCH_SIZE) {
+        StreamingRequest *request = &requests[*head % STREAMING_MAX_REQUESTS];
+        VkDeviceSize chunk = request->size - request->done;
+        chunk = chunk < STREAMING_BATCH_SIZE - used ? chunk : STREAMING_BATCH_SIZE - used;
+
+        memcpy((uint8_t *) stagingBuffer->mapped + batch->stagingOffset + used, request->data + request->done, chunk);
+        VkBufferCopy copy = {
+            .srcOffset = batch->stagingOffset + used,
+            .dstOffset = request->dstOffset + request->done,
+            .size = chunk
+        };
+        dsts[copyCount] = request->dst;
+        copies[copyCount++] = copy;
+
+        used = (used + chunk + 15) & ~(VkDeviceSize) 15;
+        request->done += chunk;
+        if (request->done == request->size) {
+            finished = request->ticket;
+            (*head)++;
+        }
+    }
+
+    VK(vkResetCommandPool(device, batch->commandPool, 0));
+    VkCommandBufferBeginInfo beginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+    };
+    VK(vkBeginCommandBuffer(batch->commandBuffer, &beginInfo));
+
+    for (uint32_t i = 0; i < copyCount; i++) {
+        vkCmdCopyBuffer(batch->commandBuffer, stagingBuffer->buffer, dsts[i], 1, &copies[i]);
+
+        // release half of the ownership transfer, the acquire is recorded by streaming_acquire
+        VkBufferMemoryBarrier barrier = {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = 0,
+            .srcQueueFamilyIndex = transferQueueFamilyIdx,
+            .dstQueueFamilyIndex = queueFamilyIdx,
+            .buffer = dsts[i],
+            .offset = copies[i].dstOffset,
+            .size = copies[i].size
+        };
+        batch->barriers[i] = barrier;
+    }
+    batch->barrierCount = copyCount;
+    vkCmdPipelineBarrier(batch->commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+        0, 0, NULL, copyCount, batch->barriers, 0, NULL);
+    VK(vkEndCommandBuffer(batch->commandBuffer));
+
+    // only this thread submits to the transfer queue
+    batch->timelineValue = timeline_submit(&transferTimeline, transferQueue, NULL, 1, &batch->commandBuffer);
+    batch->completedTicket = finished;
+}
+
+static void worker_main(void *arg) {
+    mutex_lock(&mutex);
+    uint64_t finished = 0;
+    for (;;) {
+        StreamingBatch *batch = NULL;
+        while (!quit) {
+            for (uint32_t i = 0; i < STREAMING_BATCHES && batch == NULL; i++) {
+                batch = batches[i].state == BATCH_FREE ? &batches[i] : NULL;
+            }
+            if (batch != NULL && requestHead != requestTail) {
+                break;
+            }
+            batch = NULL;
+            cond_wait(&cond, &mutex);
+        }
+        if (quit) {
+            break;
+        }
+
+        // slots in [head, tail) are only touched by this thread, the copies run unlocked
+        uint32_t head = requestHead;
+        uint32_t tail = requestTail;
+        mutex_unlock(&mutex);
+
+        batch->completedTicket = finished;
+        submit_batch(batch, &head, tail);
+        finished = batch->completedTicket;
+
+        mutex_lock(&mutex);
+        requestHead = head;
+        batch->state = BATCH_SUBMITTED;
+        cond_broadcast(&cond);
+    }
+    mutex_unlock(&mutex);
+}
+
+void streaming_init(void) {
+    mutex_init(&mutex);
+    cond_init(&cond);
+    quit = false;
+
+    if (transferQueueFamilyIdx < 0) {
+        printf("streaming: no transfer queue, uploading through the frame staging ring\n");
+        return;
+    }
+    vkGetDeviceQueue(device, transferQueueFamilyIdx, 0, &transferQueue);
+    timeline_create(&transferTimeline);
+
+    stagingBuffer = allocator_create_buffer((VkDeviceSize) STREAMING_BATCH_SIZE * STREAMING_BATCHES,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    for (uint32_t i = 0; i < STREAMING_BATCHES; i++) {
+        StreamingBatch *batch = &batches[i];
+        batch->state = BATCH_FREE;
+        batch->stagingOffset = (VkDeviceSize) STREAMING_BATCH_SIZE * i;
+
+        VkCommandPoolCreateInfo poolInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+            .queueFamilyIndex = transferQueueFamilyIdx
+        };
+        VK(vkCreateCommandPool(device, &poolInfo, NULL, &batch->commandPool));
+
+        VkCommandBufferAllocateInfo cmdAllocInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = batch->commandPool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = 1
+        };
+        VK(vkAllocateCommandBuffers(device, &cmdAllocInfo, &batch->commandBuffer));
+    }
+
+    thread_create(&worker, worker_main, NULL);
+    printf("streaming: transfer queue family %d\n", transferQueueFamilyIdx);
+}
+
+void streaming_destroy(void) {
+    if (transferQueueFamilyIdx >= 0) {
+        mutex_lock(&mutex);
+        quit = true;
+        cond_broadcast(&cond);
+        mutex_unlock(&mutex);
+        thread_join(&worker);
+
+        for (uint32_t i = 0; i < STREAMING_BATCHES; i++) {
+            vkDestroyCommandPool(device, batches[i].commandPool, NULL);
+        }
+        timeline_destroy(&transferTimeline);
+        allocator_free(stagingBuffer);
+        stagingBuffer = NULL;
+    }
+    mutex_destroy(&mutex);
+    cond_destroy(&cond);
+}
+
+uint64_t streaming_upload(const void *data, VkDeviceSize size, VkBuffer dst, VkDeviceSize dstOffset) {
+    assert(size > 0);
+    mutex_lock(&mutex);
+    while (requestTail - requestHead == STREAMING_MAX_REQUESTS) {
+        cond_wait(&cond, &mutex);
+    }
+    StreamingRequest request = {
+        .data = data,
+        .size = size,
+        .done = 0,
+        .dst = dst,
+        .dstOffset = dstOffset,
+        .ticket = nextTicket++
+    };
+    requests[requestTail % STREAMING_MAX_REQUESTS] = request;
+    requestTail++;
+    cond_broadcast(&cond);
+    mutex_unlock(&mutex);
+    return request.ticket;
+}
+
+bool streaming_complete(uint64_t ticket) {
+    return atomic_load_u64(&completedTicket) >= ticket;
+}
+
+void streaming_update(void) {
+    mutex_lock(&mutex);
+    if (transferQueueFamilyIdx >= 0) {
+        bool freed = false;
+        for (uint32_t i = 0; i < STREAMING_BATCHES; i++) {
+            StreamingBatch *batch = &batches[i];
+            if (batch->state == BATCH_ACQUIRED && timeline_reached(&graphicsTimeline, batch->retireValue)) {
+                batch->state = BATCH_FREE;
+                freed = true;
+            }
+        }
+        if (freed) {
+            cond_broadcast(&cond);
+        }
+        mutex_unlock(&mutex);
+        return;
+    }
+
+    // inline: whatever fits in this frame's ring region, flushed before the frame's draws
+    while (requestHead != requestTail) {
+        StreamingRequest *request = &requests[requestHead % STREAMING_MAX_REQUESTS];
+        VkDeviceSize chunk = request->size - request->done;
+        VkDeviceSize remaining = staging_remaining(16);
+        chunk = chunk < remaining ? chunk : remaining;
+        if (chunk == 0) {
+            break;
+        }
+        StagingAlloc staging = staging_alloc(chunk, 16);
+        memcpy(staging.data, request->data + request->done, chunk);
+        staging_copy(staging, request->dst, request->dstOffset + request->done, chunk);
+        request->done += chunk;
+        if (request->done < request->size) {
+            break;
+        }
+        atomic_store_u64(&completedTicket, request->ticket);
+        requestHead++;
+    }
+    cond_broadcast(&cond);
+    mutex_unlock(&mutex);
+}
+
+void streaming_acquire(VkCommandBuffer commandBuffer) {
+    acquiredValue = 0;
+    if (transferQueueFamilyIdx < 0) {
+        return;
+    }
+
+    mutex_lock(&mutex);
+    uint64_t completed = atomic_load_u64(&completedTicket);
+    for (uint32_t i = 0; i < STREAMING_BATCHES; i++) {
+        StreamingBatch *batch = &batches[i];
+        if (batch->state != BATCH_SUBMITTED) {
+            continue;
+        }
+
+        VkBufferMemoryBarrier acquires[STREAMING_MAX_COPIES];
+        for (uint32_t b = 0; b < batch->barrierCount; b++) {
+            acquires[b] = batch->barriers[b];
+            acquires[b].srcAccessMask = 0;
+            acquires[b].dstAccessMask = STREAMING_DST_ACCESS;
+        }
+        // the timeline wait covers the same stages, so the acquire is ordered after the release
+        vkCmdPipelineBarrier(commandBuffer, STREAMING_DST_STAGES, STREAMING_DST_STAGES,
+            0, 0, NULL, batch->barrierCount, acquires, 0, NULL);
+
+        // batches are submitted in order, waiting on the latest covers the others
+        acquiredValue = batch->timelineValue > acquiredValue ? batch->timelineValue : acquiredValue;
+        batch->state = BATCH_ACQUIRED;
+        batch->retireValue = timeline_pending(&graphicsTimeline);
+        completed = batch->completedTicket > completed ? batch->completedTicket : completed;
+    }
+    atomic_store_u64(&completedTicket, completed);
+    mutex_unlock(&mutex);
+}
+
+void streaming_submit_waits(TimelineSubmit *submit) {
+    if (acquiredValue > 0) {
+        timeline_submit_wait(submit, transferTimeline.semaphore, acquiredValue, STREAMING_DST_STAGES);
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef VULK_STREAMING_H
+#define VULK_STREAMING_H
+
+#include "vulk.h"
+#include "timeline.h"
+
+// background uploads on a dedicated transfer queue. a worker thread copies request data
+// into its own staging memory, records the copies on the transfer queue and releases the
+// destinations to the graphics family. the frame that picks a batch up acquires ownership
+// and waits on the batch's transferTimeline value, so neither the render queue nor the CPU
+// stalls on uploads.
+// without a separate transfer family requests go through the frame staging ring instead
+#define STREAMING_BATCHES 4
+
+extern int transferQueueFamilyIdx; // -1 when there is no separate transfer family
+extern VkQueue transferQueue;
+// work submitted to transferQueue
+extern Timeline transferTimeline;
+
+// before device creation: prefers a transfer-only family, then any other non-graphics family,
+// and fills queueInfo for it. false when the graphics family is all there is
+bool streaming_select_queue(VkDeviceQueueCreateInfo *queueInfo);
+void streaming_init(void);
+// after vkDeviceWaitIdle
+void streaming_destroy(void);
+
+// queues size bytes of data into dst, which must not be in use on the graphics queue.
+// data has to stay valid until the ticket completes. thread safe
+uint64_t streaming_upload(const void *data, VkDeviceSize size, VkBuffer dst, VkDeviceSize dstOffset);
+
+// true once the upload is visible to commands recorded after this frame's streaming_acquire
+bool streaming_complete(uint64_t ticket);
+
+// main thread after staging_begin_frame: recycles batches whose frames have finished and,
+// without a transfer queue, moves pending requests into the staging ring
+void streaming_update(void);
+
+// records the ownership acquires for batches the worker has submitted, before any draw
+// that reads them. the batches are recycled once the frame's submission has completed,
+// so the next graphicsQueue submission has to be that frame's
+void streaming_acquire(VkCommandBuffer commandBuffer);
+
+// adds the transfer timeline wait for the batches acquired this frame to the frame's submit
+void streaming_submit_waits(TimelineSubmit *submit);
+
+#endif
@@ -0,0 +1,176 @@
+#include "swapchain.h"
+#include "deletion.h"
+#include "frame.h"
+#include "offscreen.h"
+
+VkSwapchainKHR swapChain;
+VkImage *swapchainImages;
+VkImageView *swapchainImageViews;
+VkSemaphore *renderFinishedSemaphores;
+uint32_t swapchainImageCount;
+VkFormat swapChainImageFormat;
+VkImageUsageFlags swapchainImageUsage;
+VkExtent2D swapChainExtent;
+
+VkPresentModeKHR requestedPresentMode = VK_PRESENT_MODE_FIFO_KHR;
+uint32_t requestedSwapchainImageCount = 0;
+VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+
+// the swapchain handle is up to the callers, a replaced one is still needed as oldSwapchain
+static void destroy_views(bool deferred) {
+    for (uint32_t i = 0; i < swapchainImageCount; i++) {
+        if (deferred) {
+            deletion_image_view(swapchainImageViews[i]);
+            if (renderFinishedSemaphores != NULL) {
+                deletion_semaphore(renderFinishedSemaphores[i]);
+            }
+        } else {
+            vkDestroyImageView(device, swapchainImageViews[i], NULL);
+            if (renderFinishedSemaphores != NULL) {
+                vkDestroySemaphore(device, renderFinishedSemaphores[i], NULL);
+            }
+        }
+    }
+    free(swapchainImageViews);
+    free(renderFinishedSemaphores);
+}
+
+static uint32_t clamp_u32(uint32_t value, uint32_t min, uint32_t max) {
+    return value < min ? min : (value > max ? max : value);
+}
+
+static VkExtent2D choose_extent(const VkSurfaceCapabilitiesKHR *capabilities, VkExtent2D extent) {
+    if (capabilities->currentExtent.width != UINT32_MAX) {
+        return capabilities->currentExtent;
+    }
+    extent.width = clamp_u32(extent.width, capabilities->minImageExtent.width, capabilities->maxImageExtent.width);
+    extent.height = clamp_u32(extent.height, capabilities->minImageExtent.height, capabilities->maxImageExtent.height);
+    return extent;
+}
+
+static VkPresentModeKHR choose_present_mode(const VkPresentModeKHR *presentModes, uint32_t presentModeCount) {
+    for (uint32_t i = 0; i < presentModeCount; i++) {
+        if (presentModes[i] == requestedPresentMode) {
+            return requestedPresentMode;
+        }
+    }
+    return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+static uint32_t choose_image_count(const VkSurfaceCapabilitiesKHR *capabilities) {
+    uint32_t count = requestedSwapchainImageCount ? requestedSwapchainImageCount : capabilities->minImageCount + 1;
+    // maxImageCount 0 means no upper limit
+    uint32_t max = capabilities->maxImageCount ? capabilities->maxImageCount : UINT32_MAX;
+    return clamp_u32(count, capabilities->minImageCount, max);
+}
+
+static void create_surface_swapchain(VkExtent2D extent) {
+    VkSurfaceCapabilitiesKHR surfaceCapabilities;
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface, &surfaceCapabilities);
+
+    uint32_t presentModeCount;
+    vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &presentModeCount, NULL);
+    VkPresentModeKHR presentModes[32];
+    vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &presentModeCount, &presentModes[0]);
+
+    VkPresentModeKHR previousPresentMode = presentMode;
+    presentMode = choose_present_mode(presentModes, presentModeCount);
+    if (presentMode != requestedPresentMode && presentMode != previousPresentMode) {
+        printf("present mode %s unsupported, using %s\n",
+            string_VkPresentModeKHR(requestedPresentMode), string_VkPresentModeKHR(presentMode));
+    }
+
+    uint32_t minSwapchainImageCount = choose_image_count(&surfaceCapabilities);
+    swapchainImageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    VkSwapchainCreateInfoKHR swapchainCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
+        .surface = surface,
+        .minImageCount = minSwapchainImageCount,
+        .imageFormat = swapChainImageFormat,
+        .imageColorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR,
+        .imageExtent = choose_extent(&surfaceCapabilities, extent),
+        .imageArrayLayers = 1,
+        .imageUsage = swapchainImageUsage,
+        .imageSharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
+        .preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR,
+        .presentMode = presentMode,
+        .clipped = VK_TRUE,
+        .oldSwapchain = swapChain
+    };
+
+    VkSwapchainKHR oldSwapchain = swapChain;
+    VK(vkCreateSwapchainKHR(device, &swapchainCreateInfo, NULL, &swapChain));
+    if (oldSwapchain != VK_NULL_HANDLE) {
+        // frames still in flight reference the old images, destroy them once those have completed
+        deletion_swapchain(oldSwapchain);
+    }
+    swapChainExtent = swapchainCreateInfo.imageExtent;
+
+    vkGetSwapchainImagesKHR(device, swapChain, &swapchainImageCount, NULL);
+    swapchainImages = malloc(sizeof(VkImage) * swapchainImageCount);
+    vkGetSwapchainImagesKHR(device, swapChain, &swapchainImageCount, &swapchainImages[0]);
+    printf("swapchain %ux%u, %u images, %s\n", swapChainExtent.width, swapChainExtent.height,
+        swapchainImageCount, string_VkPresentModeKHR(presentMode));
+
+    VkSemaphoreCreateInfo semaphoreInfo = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO
+    };
+    renderFinishedSemaphores = malloc(sizeof(VkSemaphore) * swapchainImageCount);
+    for (uint32_t i = 0; i < swapchainImageCount; i++) {
+        VK(vkCreateSemaphore(device, &semaphoreInfo, NULL, &renderFinishedSemaphores[i]));
+    }
+}
+
+void swapchain_create(VkExtent2D extent) {
+    if (swapchainImageViews != NULL) {
+        assert(!headless); // offscreen targets are fixed size
+
+        // frames still in flight reference the old views, they go once those have completed
+        destroy_views(true);
+        free(swapchainImages);
+    }
+
+    if (headless) {
+        // one target per frame slot so in-flight frames never share an image
+        offscreen_create(swapChainImageFormat, extent, framesInFlight);
+        renderFinishedSemaphores = NULL;
+    } else {
+        create_surface_swapchain(extent);
+    }
+
+    swapchainImageViews = malloc(sizeof(VkImageView) * swapchainImageCount);
+    for (uint32_t i = 0; i < swapchainImageCount; i++) {
+        VkImageViewCreateInfo viewCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            .image = swapchainImages[i],
+            .viewType = VK_IMAGE_VIEW_TYPE_2D,
+            .format = swapChainImageFormat,
+            .components.r = VK_COMPONENT_SWIZZLE_IDENTITY,
+            .components.g = VK_COMPONENT_SWIZZLE_IDENTITY,
+            .components.b = VK_COMPONENT_SWIZZLE_IDENTITY,
+            .components.a = VK_COMPONENT_SWIZZLE_IDENTITY,
+            .subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .subresourceRange.baseMipLevel = 0,
+            .subresourceRange.levelCount = 1,
+            .subresourceRange.baseArrayLayer = 0,
+            .subresourceRange.layerCount = 1
+        };
+        VK(vkCreateImageView(device, &viewCreateInfo, NULL, &swapchainImageViews[i]));
+    }
+}
+
+void swapchain_destroy(void) {
+    destroy_views(false);
+    if (headless) {
+        offscreen_destroy();
+    } else {
+        free(swapchainImages);
+        vkDestroySwapchainKHR(device, swapChain, NULL);
+    }
+    swapChain = VK_NULL_HANDLE;
+    swapchainImages = NULL;
+    swapchainImageViews = NULL;
+    renderFinishedSemaphores = NULL;
+    swapchainImageCount = 0;
+}
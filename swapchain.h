@@ -0,0 +1,26 @@
+#ifndef VULK_SWAPCHAIN_H
+#define VULK_SWAPCHAIN_H
+
+#include "vulk.h"
+
+extern VkSwapchainKHR swapChain;
+extern VkImageView *swapchainImageViews;
+
+// signalled by the submit and waited on by present, one per swapchain image because
+// the presentation engine may still hold it when the frame slot comes round again
+extern VkSemaphore *renderFinishedSemaphores;
+
+// FIFO is always available and used whenever the requested mode is not supported
+extern VkPresentModeKHR requestedPresentMode;
+// 0 keeps the surface minimum + 1, otherwise clamped to what the surface allows
+extern uint32_t requestedSwapchainImageCount;
+extern VkPresentModeKHR presentMode;
+
+// builds images, views and present semaphores.
+// when a swapchain already exists it is passed as oldSwapchain and its resources
+// go on the deletion queue rather than being destroyed
+void swapchain_create(VkExtent2D extent);
+// after deletion_flush, a retired swapchain has to be gone before its surface
+void swapchain_destroy(void);
+
+#endif
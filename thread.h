@@ -0,0 +1,112 @@
+#ifndef VULK_THREAD_H
+#define VULK_THREAD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// threads, mutexes and condition variables for C99, which has no <threads.h>
+
+typedef void (*ThreadFunction)(void *arg);
+
+#ifdef _WIN32
+#include <windows.h>
+
+typedef struct Thread {
+    HANDLE handle;
+    ThreadFunction function;
+    void *arg;
+} Thread;
+typedef SRWLOCK Mutex;
+typedef CONDITION_VARIABLE Cond;
+
+static __inline DWORD WINAPI thread_entry(LPVOID param) {
+    Thread *thread = param;
+    thread->function(thread->arg);
+    return 0;
+}
+
+static __inline void thread_create(Thread *thread, ThreadFunction function, void *arg) {
+    thread->function = function;
+    thread->arg = arg;
+    thread->handle = CreateThread(NULL, 0, thread_entry, thread, 0, NULL);
+    if (thread->handle == NULL) {
+        fprintf(stderr, "Failed to create thread\n");
+        exit(1);
+    }
+}
+
+static __inline void thread_join(Thread *thread) {
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+}
+
+static __inline void mutex_init(Mutex *mutex) { InitializeSRWLock(mutex); }
+static __inline void mutex_destroy(Mutex *mutex) { (void) mutex; }
+static __inline void mutex_lock(Mutex *mutex) { AcquireSRWLockExclusive(mutex); }
+static __inline void mutex_unlock(Mutex *mutex) { ReleaseSRWLockExclusive(mutex); }
+
+static __inline void cond_init(Cond *cond) { InitializeConditionVariable(cond); }
+static __inline void cond_destroy(Cond *cond) { (void) cond; }
+static __inline void cond_wait(Cond *cond, Mutex *mutex) { SleepConditionVariableSRW(cond, mutex, INFINITE, 0); }
+static __inline void cond_signal(Cond *cond) { WakeConditionVariable(cond); }
+static __inline void cond_broadcast(Cond *cond) { WakeAllConditionVariable(cond); }
+
+static __inline void thread_yield(void) { SwitchToThread(); }
+
+static __inline uint32_t thread_hardware_concurrency(void) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (uint32_t) info.dwNumberOfProcessors;
+}
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+typedef struct Thread {
+    pthread_t handle;
+    ThreadFunction function;
+    void *arg;
+} Thread;
+typedef pthread_mutex_t Mutex;
+typedef pthread_cond_t Cond;
+
+static inline void *thread_entry(void *param) {
+    Thread *thread = param;
+    thread->function(thread->arg);
+    return NULL;
+}
+
+static inline void thread_create(Thread *thread, ThreadFunction function, void *arg) {
+    thread->function = function;
+    thread->arg = arg;
+    if (pthread_create(&thread->handle, NULL, thread_entry, thread) != 0) {
+        fprintf(stderr, "Failed to create thread\n");
+        exit(1);
+    }
+}
+
+static inline void thread_join(Thread *thread) { pthread_join(thread->handle, NULL); }
+
+static inline void mutex_init(Mutex *mutex) { pthread_mutex_init(mutex, NULL); }
+static inline void mutex_destroy(Mutex *mutex) { pthread_mutex_destroy(mutex); }
+static inline void mutex_lock(Mutex *mutex) { pthread_mutex_lock(mutex); }
+static inline void mutex_unlock(Mutex *mutex) { pthread_mutex_unlock(mutex); }
+
+static inline void cond_init(Cond *cond) { pthread_cond_init(cond, NULL); }
+static inline void cond_destroy(Cond *cond) { pthread_cond_destroy(cond); }
+static inline void cond_wait(Cond *cond, Mutex *mutex) { pthread_cond_wait(cond, mutex); }
+static inline void cond_signal(Cond *cond) { pthread_cond_signal(cond); }
+static inline void cond_broadcast(Cond *cond) { pthread_cond_broadcast(cond); }
+
+static inline void thread_yield(void) { sched_yield(); }
+
+static inline uint32_t thread_hardware_concurrency(void) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (uint32_t) count : 1;
+}
+#endif
+
+#endif
@@ -0,0 +1,109 @@
+#include "timeline.h"
+#include "atomics.h"
+
+Timeline graphicsTimeline;
+
+void timeline_require_features(const VkPhysicalDeviceVulkan12Features *supported, VkPhysicalDeviceVulkan12Features *enabled) {
+    if (!supported->timelineSemaphore) {
+        fprintf(stderr, "Fatal: device lacks timeline semaphores\n");
+        exit(1);
+    }
+    enabled->timelineSemaphore = VK_TRUE;
+}
+
+void timeline_create(Timeline *timeline) {
+    VkSemaphoreTypeCreateInfo typeInfo = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+        .initialValue = 0
+    };
+    VkSemaphoreCreateInfo semaphoreInfo = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = &typeInfo
+    };
+    VK(vkCreateSemaphore(device, &semaphoreInfo, NULL, &timeline->semaphore));
+    atomic_store_u64(&timeline->submitted, 0);
+    timeline->completed = 0;
+}
+
+void timeline_destroy(Timeline *timeline) {
+    vkDestroySemaphore(device, timeline->semaphore, NULL);
+    timeline->semaphore = VK_NULL_HANDLE;
+}
+
+uint64_t timeline_pending(Timeline *timeline) {
+    return atomic_load_u64(&timeline->submitted) + 1;
+}
+
+uint64_t timeline_completed(Timeline *timeline) {
+    uint64_t value;
+    VK(vkGetSemaphoreCounterValue(device, timeline->semaphore, &value));
+    atomic_store_u64(&timeline->completed, value);
+    return value;
+}
+
+bool timeline_reached(Timeline *timeline, uint64_t value) {
+    // the cached value only ever lags, so a hit skips the driver call
+    return atomic_load_u64(&timeline->completed) >= value || timeline_completed(timeline) >= value;
+}
+
+void timeline_wait(Timeline *timeline, uint64_t value) {
+    if (atomic_load_u64(&timeline->completed) >= value) {
+        return;
+    }
+    VkSemaphoreWaitInfo waitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .semaphoreCount = 1,
+        .pSemaphores = &timeline->semaphore,
+        .pValues = &value
+    };
+    VK(vkWaitSemaphores(device, &waitInfo, UINT64_MAX));
+    timeline_completed(timeline);
+}
+
+void timeline_submit_wait(TimelineSubmit *submit, VkSemaphore semaphore, uint64_t value, VkPipelineStageFlags stages) {
+    assert(submit->waitCount < TIMELINE_MAX_WAITS);
+    submit->waitSemaphores[submit->waitCount] = semaphore;
+    submit->waitValues[submit->waitCount] = value;
+    submit->waitStages[submit->waitCount] = stages;
+    submit->waitCount++;
+}
+
+void timeline_submit_signal(TimelineSubmit *submit, VkSemaphore semaphore, uint64_t value) {
+    assert(submit->signalCount < TIMELINE_MAX_SIGNALS);
+    submit->signalSemaphores[submit->signalCount] = semaphore;
+    submit->signalValues[submit->signalCount] = value;
+    submit->signalCount++;
+}
+
+uint64_t timeline_submit(Timeline *timeline, VkQueue queue, TimelineSubmit *submit,
+    uint32_t commandBufferCount, const VkCommandBuffer *commandBuffers) {
+    TimelineSubmit empty = {0};
+    submit = submit ? submit : &empty;
+    uint64_t value = timeline_pending(timeline);
+    // the arrays have a spare slot for the timeline's own signal
+    submit->signalSemaphores[submit->signalCount] = timeline->semaphore;
+    submit->signalValues[submit->signalCount] = value;
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo = {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .waitSemaphoreValueCount = submit->waitCount,
+        .pWaitSemaphoreValues = submit->waitValues,
+        .signalSemaphoreValueCount = submit->signalCount + 1,
+        .pSignalSemaphoreValues = submit->signalValues
+    };
+    VkSubmitInfo submitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = &timelineInfo,
+        .waitSemaphoreCount = submit->waitCount,
+        .pWaitSemaphores = submit->waitSemaphores,
+        .pWaitDstStageMask = submit->waitStages,
+        .commandBufferCount = commandBufferCount,
+        .pCommandBuffers = commandBuffers,
+        .signalSemaphoreCount = submit->signalCount + 1,
+        .pSignalSemaphores = submit->signalSemaphores
+    };
+    VK(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+    atomic_store_u64(&timeline->submitted, value);
+    return value;
+}
@@ -0,0 +1,58 @@
+#ifndef VULK_TIMELINE_H
+#define VULK_TIMELINE_H
+
+#include "vulk.h"
+
+// timeline semaphores, one per queue. every submission signals the next value of its
+// queue's timeline, so "has this work finished" is a single integer compare on the CPU
+// and other queues wait on a value instead of a binary semaphore per submission
+#define TIMELINE_MAX_WAITS 8
+#define TIMELINE_MAX_SIGNALS 4
+
+typedef struct Timeline {
+    VkSemaphore semaphore;
+    // value of the latest submission, only the submitting thread writes it, others read it
+    // atomically through timeline_pending
+    volatile uint64_t submitted;
+    volatile uint64_t completed; // cached counter value, refreshed by timeline_completed
+} Timeline;
+
+// semaphores one submission waits on and signals besides its own timeline.
+// binary semaphores (swapchain acquire and present) go in with value 0
+typedef struct TimelineSubmit {
+    uint32_t waitCount;
+    VkSemaphore waitSemaphores[TIMELINE_MAX_WAITS];
+    uint64_t waitValues[TIMELINE_MAX_WAITS];
+    VkPipelineStageFlags waitStages[TIMELINE_MAX_WAITS];
+    uint32_t signalCount;
+    VkSemaphore signalSemaphores[TIMELINE_MAX_SIGNALS + 1];
+    uint64_t signalValues[TIMELINE_MAX_SIGNALS + 1];
+} TimelineSubmit;
+
+// work submitted to graphicsQueue
+extern Timeline graphicsTimeline;
+
+// before device creation: turns on timelineSemaphore, fatal if missing
+void timeline_require_features(const VkPhysicalDeviceVulkan12Features *supported, VkPhysicalDeviceVulkan12Features *enabled);
+
+void timeline_create(Timeline *timeline);
+void timeline_destroy(Timeline *timeline);
+
+// the value the next submission on the timeline will signal, work retired with it is
+// safe to free once timeline_reached returns true. any thread
+uint64_t timeline_pending(Timeline *timeline);
+
+// polls the GPU's counter
+uint64_t timeline_completed(Timeline *timeline);
+bool timeline_reached(Timeline *timeline, uint64_t value);
+void timeline_wait(Timeline *timeline, uint64_t value);
+
+void timeline_submit_wait(TimelineSubmit *submit, VkSemaphore semaphore, uint64_t value, VkPipelineStageFlags stages);
+void timeline_submit_signal(TimelineSubmit *submit, VkSemaphore semaphore, uint64_t value);
+
+// submits the command buffers with submit's waits and signals (submit may be NULL) plus
+// a signal of the timeline's next value, which is returned
+uint64_t timeline_submit(Timeline *timeline, VkQueue queue, TimelineSubmit *submit,
+    uint32_t commandBufferCount, const VkCommandBuffer *commandBuffers);
+
+#endif
@@ -0,0 +1,55 @@
+#include "timer.h"
+
+#ifdef _WIN32
+#include <windows.h>
+
+// below this the OS sleep is not trusted to wake in time, Sleep rounds to the scheduler tick
+#define TIMER_SPIN_SECONDS 0.002
+
+double timer_now(void) {
+    static LARGE_INTEGER frequency;
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (double) counter.QuadPart / (double) frequency.QuadPart;
+}
+
+void timer_sleep_until(double deadline) {
+    double remaining = deadline - timer_now();
+    if (remaining > TIMER_SPIN_SECONDS) {
+        Sleep((DWORD) ((remaining - TIMER_SPIN_SECONDS) * 1000.0));
+    }
+    while (timer_now() < deadline) {
+        YieldProcessor();
+    }
+}
+#else
+#include <errno.h>
+#include <time.h>
+
+// below this the OS sleep is not trusted to wake in time
+#define TIMER_SPIN_SECONDS 0.001
+
+double timer_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+void timer_sleep_until(double deadline) {
+    // an absolute wake-up on the clock timer_now reads, so signals just resume the same sleep
+    double wake = deadline - TIMER_SPIN_SECONDS;
+    if (wake > timer_now()) {
+        struct timespec ts = {
+            .tv_sec = (time_t) wake,
+            .tv_nsec = (long) ((wake - (double) (time_t) wake) * 1e9)
+        };
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+        }
+    }
+    while (timer_now() < deadline) {
+    }
+}
+#endif
@@ -0,0 +1,10 @@
+#ifndef VULK_TIMER_H
+#define VULK_TIMER_H
+
+// monotonic wall clock in seconds, usable without a window
+double timer_now(void);
+
+// sleeps most of the way with the OS and spins the remainder, OS sleeps overshoot by a millisecond or more
+void timer_sleep_until(double deadline);
+
+#endif
@@ -0,0 +1,376 @@
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include "vertex.h"
+#include "staging.h"
+
+static uint32_t encoding_size(VertexEncoding encoding, VertexAttribute attribute) {
+    switch (encoding) {
+        case VERTEX_FLOAT32:
+            return attribute == VERTEX_UV ? 8 : (attribute == VERTEX_COLOR ? 16 : 12);
+        case VERTEX_FLOAT16:
+            return attribute == VERTEX_UV ? 4 : 8;
+        case VERTEX_SNORM16:
+            return 8;
+        case VERTEX_OCTAHEDRAL:
+            return 4;
+        case VERTEX_UNORM8:
+            return 4;
+    }
+    return 0;
+}
+
+static VkFormat encoding_format(VertexEncoding encoding, VertexAttribute attribute) {
+    switch (encoding) {
+        case VERTEX_FLOAT32:
+            return attribute == VERTEX_UV ? VK_FORMAT_R32G32_SFLOAT
+                : (attribute == VERTEX_COLOR ? VK_FORMAT_R32G32B32A32_SFLOAT : VK_FORMAT_R32G32B32_SFLOAT);
+        // three component 16 bit formats are rarely supported for vertex fetch, pad to four
+        case VERTEX_FLOAT16:
+            return attribute == VERTEX_UV ? VK_FORMAT_R16G16_SFLOAT : VK_FORMAT_R16G16B16A16_SFLOAT;
+        case VERTEX_SNORM16:
+            return VK_FORMAT_R16G16B16A16_SNORM;
+        case VERTEX_OCTAHEDRAL:
+            return VK_FORMAT_R16G16_SNORM;
+        case VERTEX_UNORM8:
+            return VK_FORMAT_R8G8B8A8_UNORM;
+    }
+    return VK_FORMAT_UNDEFINED;
+}
+
+void vertex_layout_init(VertexLayout *layout, bool packed, bool splitPositions) {
+    memset(layout, 0, sizeof(*layout));
+    layout->encodings[VERTEX_POSITION] = packed ? VERTEX_SNORM16 : VERTEX_FLOAT32;
+    layout->encodings[VERTEX_NORMAL] = packed ? VERTEX_OCTAHEDRAL : VERTEX_FLOAT32;
+    layout->encodings[VERTEX_UV] = packed ? VERTEX_FLOAT16 : VERTEX_FLOAT32;
+    layout->encodings[VERTEX_COLOR] = packed ? VERTEX_UNORM8 : VERTEX_FLOAT32;
+    layout->splitPositions = splitPositions;
+    layout->streamCount = splitPositions ? 2 : 1;
+
+    for (uint32_t i = 0; i < VERTEX_ATTRIBUTE_COUNT; i++) {
+        uint32_t binding = splitPositions && i != VERTEX_POSITION ? 1 : 0;
+        VkVertexInputAttributeDescription attribute = {
+            .location = i,
+            .binding = binding,
+            .format = encoding_format(layout->encodings[i], i),
+            .offset = layout->strides[binding]
+        };
+        layout->attributes[i] = attribute;
+        layout->strides[binding] += encoding_size(layout->encodings[i], i);
+    }
+
+    for (uint32_t i = 0; i < layout->streamCount; i++) {
+        VkVertexInputBindingDescription binding = {
+            .binding = i,
+            .stride = layout->strides[i],
+            .inputRate = VK_VERTEX_INPUT_RATE_VERTEX
+        };
+        layout->bindings[i] = binding;
+    }
+}
+
+VkPipelineVertexInputStateCreateInfo vertex_layout_input_state(const VertexLayout *layout, bool positionsOnly) {
+    VkPipelineVertexInputStateCreateInfo info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+        .vertexBindingDescriptionCount = positionsOnly ? 1 : layout->streamCount,
+        .pVertexBindingDescriptions = layout->bindings,
+        .vertexAttributeDescriptionCount = positionsOnly ? 1 : VERTEX_ATTRIBUTE_COUNT,
+        .pVertexAttributeDescriptions = layout->attributes
+    };
+    return info;
+}
+
+uint16_t vertex_float_to_half(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t exponentBits = (bits >> 23) & 0xff;
+    uint32_t mantissa = bits & 0x7fffff;
+    int32_t exponent = (int32_t) exponentBits - 127 + 15;
+
+    if (exponentBits == 0xff) {
+        return (uint16_t) (sign | 0x7c00 | (mantissa ? 0x200 : 0));
+    }
+    if (exponent >= 31) {
+        return (uint16_t) (sign | 0x7c00);
+    }
+    if (exponent <= 0) {
+        // subnormal half, or zero when even that underflows
+        if (exponent < -10) {
+            return (uint16_t) sign;
+        }
+        mantissa |= 0x800000;
+        uint32_t shift = (uint32_t) (14 - exponent);
+        uint32_t half = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half & 1))) {
+            half++;
+        }
+        return (uint16_t) (sign | half);
+    }
+
+    // round to nearest even, a mantissa carry correctly bumps the exponent
+    uint32_t half = sign | ((uint32_t) exponent << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1fff;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+        half++;
+    }
+    return (uint16_t) half;
+}
+
+int16_t vertex_float_to_snorm16(float value) {
+    value = value < -1.0f ? -1.0f : (value > 1.0f ? 1.0f : value);
+    return (int16_t) roundf(value * 32767.0f);
+}
+
+void vertex_octahedral_encode(const vec3 normal, int16_t out[2]) {
+    float l1 = fabsf(normal[0]) + fabsf(normal[1]) + fabsf(normal[2]);
+    float x = l1 > 0.0f ? normal[0] / l1 : 0.0f;
+    float y = l1 > 0.0f ? normal[1] / l1 : 0.0f;
+
+    // lower hemisphere folds over the diagonals
+    if (normal[2] < 0.0f) {
+        float foldedX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float foldedY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = foldedX;
+        y = foldedY;
+    }
+    out[0] = vertex_float_to_snorm16(x);
+    out[1] = vertex_float_to_snorm16(y);
+}
+
+static void encode_attribute(VertexEncoding encoding, VertexAttribute attribute, const SourceVertex *vertex,
+    const vec4 positionScale, const vec4 positionOffset, uint8_t *dst) {
+    const float *src;
+    uint32_t components;
+    switch (attribute) {
+        case VERTEX_POSITION: src = vertex->position; components = 3; break;
+        case VERTEX_NORMAL: src = vertex->normal; components = 3; break;
+        case VERTEX_UV: src = vertex->uv; components = 2; break;
+        default: src = vertex->color; components = 4; break;
+    }
+
+    switch (encoding) {
+        case VERTEX_FLOAT32:
+            memcpy(dst, src, components * sizeof(float));
+            break;
+        case VERTEX_FLOAT16: {
+            uint16_t half[4] = {0, 0, 0, vertex_float_to_half(1.0f)};
+            for (uint32_t c = 0; c < components; c++) {
+                half[c] = vertex_float_to_half(src[c]);
+            }
+            memcpy(dst, half, encoding_size(encoding, attribute));
+            break;
+        }
+        case VERTEX_SNORM16: {
+            int16_t snorm[4] = {0, 0, 0, 32767};
+            for (uint32_t c = 0; c < components && c < 3; c++) {
+                float value = src[c];
+                if (attribute == VERTEX_POSITION) {
+                    value = (value - positionOffset[c]) / positionScale[c];
+                }
+                snorm[c] = vertex_float_to_snorm16(value);
+            }
+            memcpy(dst, snorm, sizeof(snorm));
+            break;
+        }
+        case VERTEX_OCTAHEDRAL: {
+            int16_t oct[2];
+            vertex_octahedral_encode(src, oct);
+            memcpy(dst, oct, sizeof(oct));
+            break;
+        }
+        case VERTEX_UNORM8: {
+            uint8_t unorm[4] = {0, 0, 0, 255};
+            for (uint32_t c = 0; c < components; c++) {
+                float value = src[c] < 0.0f ? 0.0f : (src[c] > 1.0f ? 1.0f : src[c]);
+                unorm[c] = (uint8_t) roundf(value * 255.0f);
+            }
+            memcpy(dst, unorm, sizeof(unorm));
+            break;
+        }
+    }
+}
+
+void vertex_encode(const VertexLayout *layout, const SourceVertex *vertices, uint32_t count,
+    const vec4 positionScale, const vec4 positionOffset, void *streams[VERTEX_MAX_STREAMS]) {
+    for (uint32_t v = 0; v < count; v++) {
+        for (uint32_t i = 0; i < VERTEX_ATTRIBUTE_COUNT; i++) {
+            const VkVertexInputAttributeDescription *attribute = &layout->attributes[i];
+            uint8_t *dst = (uint8_t *) streams[attribute->binding] +
+                (size_t) v * layout->strides[attribute->binding] + attribute->offset;
+            encode_attribute(layout->encodings[i], i, &vertices[v], positionScale, positionOffset, dst);
+        }
+    }
+}
+
+void vertex_quantization(const VertexLayout *layout, const SourceVertex *vertices, uint32_t count,
+    vec3 boundsMin, vec3 boundsMax, vec4 positionScale, vec4 positionOffset) {
+    glm_vec3_zero(boundsMin);
+    glm_vec3_zero(boundsMax);
+    if (count > 0) {
+        glm_vec3_fill(boundsMin, FLT_MAX);
+        glm_vec3_fill(boundsMax, -FLT_MAX);
+    }
+    for (uint32_t v = 0; v < count; v++) {
+        for (uint32_t c = 0; c < 3; c++) {
+            boundsMin[c] = glm_min(boundsMin[c], vertices[v].position[c]);
+            boundsMax[c] = glm_max(boundsMax[c], vertices[v].position[c]);
+        }
+    }
+
+    glm_vec4_one(positionScale);
+    glm_vec4_zero(positionOffset);
+    if (layout->encodings[VERTEX_POSITION] == VERTEX_SNORM16 && count > 0) {
+        for (uint32_t c = 0; c < 3; c++) {
+            positionOffset[c] = (boundsMin[c] + boundsMax[c]) * 0.5f;
+            float halfExtent = (boundsMax[c] - boundsMin[c]) * 0.5f;
+            positionScale[c] = halfExtent > 0.0f ? halfExtent : 1.0f;
+        }
+    }
+}
+
+float vertex_quantization_error(const VertexLayout *layout, const vec4 positionScale) {
+    if (layout->encodings[VERTEX_POSITION] != VERTEX_SNORM16) {
+        return 0.0f;
+    }
+    // half a snorm16 step on every axis
+    vec3 step;
+    glm_vec3_scale((float *) positionScale, 0.5f / 32767.0f, step);
+    return glm_vec3_norm(step);
+}
+
+void mesh_geometry_build(MeshGeometry *geometry, const SourceVertex *vertices, uint32_t vertexCount,
+    const uint32_t *indices, uint32_t indexCount, float padding) {
+    const float *positions = vertexCount > 0 ? vertices[0].position : NULL;
+    simplify_lod_chain(&geometry->chain, positions, sizeof(SourceVertex), vertexCount, indices, indexCount);
+    memset(&geometry->meshlets, 0, sizeof(geometry->meshlets));
+    for (uint32_t i = 0; i < geometry->chain.lodCount; i++) {
+        MeshLod *lod = &geometry->chain.lods[i];
+        MeshletBuild part;
+        meshlet_build(&part, positions, sizeof(SourceVertex), vertexCount, geometry->chain.indices + lod->firstIndex,
+            lod->indexCount, padding);
+        lod->firstMeshlet = geometry->meshlets.meshletCount;
+        lod->meshletCount = part.meshletCount;
+        meshlet_build_append(&geometry->meshlets, &part);
+        meshlet_build_free(&part);
+    }
+}
+
+void mesh_geometry_free(MeshGeometry *geometry) {
+    simplify_lod_chain_free(&geometry->chain);
+    meshlet_build_free(&geometry->meshlets);
+}
+
+// device-local destination filled through the staging ring, or host-visible memory
+// written in place when the upload does not fit in this frame's ring region
+static Allocation *upload_buffer(VkDeviceSize size, VkBufferUsageFlags usage, void **data, StagingAlloc *staging) {
+    *staging = staging_alloc(size, 16);
+    if (staging->data != NULL) {
+        *data = staging->data;
+        return allocator_create_buffer(size, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    }
+    Allocation *allocation = allocator_create_buffer(size, usage,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    *data = allocation->mapped;
+    return allocation;
+}
+
+void mesh_upload(Mesh *mesh, const VertexLayout *layout, const SourceVertex *vertices, uint32_t vertexCount,
+    const uint32_t *indices, uint32_t indexCount) {
+    memset(mesh, 0, sizeof(*mesh));
+    mesh->layout = *layout;
+    mesh->vertexCount = vertexCount;
+
+    vertex_quantization(layout, vertices, vertexCount, mesh->boundsMin, mesh->boundsMax,
+        mesh->positionScale, mesh->positionOffset);
+    MeshGeometry geometry;
+    mesh_geometry_build(&geometry, vertices, vertexCount, indices, indexCount,
+        vertex_quantization_error(layout, mesh->positionScale));
+    // from here on the indices are every level's
+    indices = geometry.chain.indices;
+    indexCount = geometry.chain.indexCount;
+    mesh->indexCount = indexCount;
+    memcpy(mesh->lods, geometry.chain.lods, sizeof(mesh->lods));
+    mesh->lodCount = geometry.chain.lodCount;
+
+    void *streamData[VERTEX_MAX_STREAMS];
+    StagingAlloc streamStaging[VERTEX_MAX_STREAMS];
+    for (uint32_t i = 0; i < layout->streamCount; i++) {
+        VkDeviceSize size = (VkDeviceSize) layout->strides[i] * vertexCount;
+        mesh->streams[i] = upload_buffer(size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            &streamData[i], &streamStaging[i]);
+    }
+    vertex_encode(layout, vertices, vertexCount, mesh->positionScale, mesh->positionOffset, streamData);
+    for (uint32_t i = 0; i < layout->streamCount; i++) {
+        if (streamStaging[i].data != NULL) {
+            staging_copy(streamStaging[i], mesh->streams[i]->buffer, 0, (VkDeviceSize) layout->strides[i] * vertexCount);
+        }
+    }
+
+    bool narrow = vertexCount <= UINT16_MAX + 1;
+    mesh->indexType = narrow ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    VkDeviceSize indexSize = (VkDeviceSize) indexCount * (narrow ? 2 : 4);
+    void *indexData;
+    StagingAlloc indexStaging;
+    mesh->indices = upload_buffer(indexSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, &indexData, &indexStaging);
+    if (narrow) {
+        uint16_t *dst = indexData;
+        for (uint32_t i = 0; i < indexCount; i++) {
+            dst[i] = (uint16_t) indices[i];
+        }
+    } else {
+        memcpy(indexData, indices, indexSize);
+    }
+    if (indexStaging.data != NULL) {
+        staging_copy(indexStaging, mesh->indices->buffer, 0, indexSize);
+    }
+
+    const MeshletBuild *build = &geometry.meshlets;
+    mesh->meshletCount = build->meshletCount;
+    mesh->meshlets = malloc(sizeof(Meshlet) * build->meshletCount);
+    memcpy(mesh->meshlets, build->meshlets, sizeof(Meshlet) * build->meshletCount);
+    mesh->meshletVertexCount = build->vertexCount;
+    if (build->meshletCount > 0) {
+        VkDeviceSize verticesSize = sizeof(uint32_t) * build->vertexCount;
+        // whole words, shaders read the micro indices four at a time
+        VkDeviceSize meshletSize = (verticesSize + 3 * build->triangleCount + 3) & ~(VkDeviceSize) 3;
+        void *meshletData;
+        StagingAlloc meshletStaging;
+        mesh->meshletData = upload_buffer(meshletSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &meshletData, &meshletStaging);
+        memcpy(meshletData, build->vertices, verticesSize);
+        memcpy((uint8_t *) meshletData + verticesSize, build->triangles, 3 * build->triangleCount);
+        if (meshletStaging.data != NULL) {
+            staging_copy(meshletStaging, mesh->meshletData->buffer, 0, meshletSize);
+        }
+    }
+    mesh_geometry_free(&geometry);
+}
+
+void mesh_destroy(Mesh *mesh) {
+    for (uint32_t i = 0; i < mesh->layout.streamCount; i++) {
+        allocator_free(mesh->streams[i]);
+        mesh->streams[i] = NULL;
+    }
+    allocator_free(mesh->indices);
+    mesh->indices = NULL;
+    allocator_free(mesh->meshletData);
+    mesh->meshletData = NULL;
+    free(mesh->meshlets);
+    mesh->meshlets = NULL;
+    mesh->meshletCount = 0;
+    mesh->lodCount = 0;
+}
+
+void mesh_bind(VkCommandBuffer commandBuffer, const Mesh *mesh, bool positionsOnly) {
+    VkBuffer buffers[VERTEX_MAX_STREAMS];
+    VkDeviceSize offsets[VERTEX_MAX_STREAMS] = {0};
+    uint32_t streamCount = positionsOnly ? 1 : mesh->layout.streamCount;
+    for (uint32_t i = 0; i < streamCount; i++) {
+        buffers[i] = mesh->streams[i]->buffer;
+    }
+    vkCmdBindVertexBuffers(commandBuffer, 0, streamCount, buffers, offsets);
+    vkCmdBindIndexBuffer(commandBuffer, mesh->indices->buffer, 0, mesh->indexType);
+}
@@ -0,0 +1,124 @@
+#ifndef VULK_VERTEX_H
+#define VULK_VERTEX_H
+
+#include <cglm/cglm.h>
+#include "vulk.h"
+#include "allocator.h"
+#include "meshlet.h"
+#include "simplify.h"
+
+// attribute i is always shader location i
+typedef enum VertexAttribute {
+    VERTEX_POSITION,
+    VERTEX_NORMAL,
+    VERTEX_UV,
+    VERTEX_COLOR,
+    VERTEX_ATTRIBUTE_COUNT
+} VertexAttribute;
+
+typedef enum VertexEncoding {
+    VERTEX_FLOAT32,
+    VERTEX_FLOAT16,
+    // positions are quantized against the mesh bounds, see Mesh.positionScale/positionOffset
+    VERTEX_SNORM16,
+    // unit vectors folded onto an octahedron, two snorm16 components
+    VERTEX_OCTAHEDRAL,
+    VERTEX_UNORM8
+} VertexEncoding;
+
+// with split positions, binding 0 carries positions only and binding 1 everything else,
+// so depth-only and shadow passes fetch a fraction of the vertex bytes
+#define VERTEX_MAX_STREAMS 2
+
+typedef struct VertexLayout {
+    VertexEncoding encodings[VERTEX_ATTRIBUTE_COUNT];
+    bool splitPositions;
+    uint32_t streamCount;
+    uint32_t strides[VERTEX_MAX_STREAMS];
+    VkVertexInputBindingDescription bindings[VERTEX_MAX_STREAMS];
+    // attributes[0] is always the position in binding 0
+    VkVertexInputAttributeDescription attributes[VERTEX_ATTRIBUTE_COUNT];
+} VertexLayout;
+
+// unpacked vertex as produced by importers and generators
+typedef struct SourceVertex {
+    vec3 position;
+    vec3 normal;
+    vec2 uv;
+    vec4 color;
+} SourceVertex;
+
+// what an upload or a .vmesh holds beyond the vertices: the index buffer of every level of
+// detail and the meshlets covering them
+typedef struct MeshGeometry {
+    LodChain chain;
+    MeshletBuild meshlets;
+} MeshGeometry;
+
+typedef struct Mesh {
+    VertexLayout layout;
+    Allocation *streams[VERTEX_MAX_STREAMS];
+    Allocation *indices;
+    VkIndexType indexType;
+    uint32_t vertexCount;
+    // all levels of detail, see lods
+    uint32_t indexCount;
+    MeshLod lods[MESH_MAX_LODS];
+    uint32_t lodCount;
+    vec3 boundsMin;
+    vec3 boundsMax;
+    // position = attribute * positionScale + positionOffset, pushed as constants
+    vec4 positionScale;
+    vec4 positionOffset;
+    // CPU copy of the meshlet table, see meshlet.h
+    Meshlet *meshlets;
+    uint32_t meshletCount;
+    // meshlet vertex indices (meshletVertexCount uint32) followed by the micro indices, read by
+    // mesh shaders. the vertex streams are storage buffers as well for them
+    Allocation *meshletData;
+    uint32_t meshletVertexCount;
+    // streamed meshes are drawable once streaming_complete(uploadTicket), 0 when uploaded in place
+    uint64_t uploadTicket;
+} Mesh;
+
+// the standard layouts, full precision or packed (half uvs, snorm16 positions,
+// octahedral normals, unorm8 colors)
+void vertex_layout_init(VertexLayout *layout, bool packed, bool splitPositions);
+
+// pipeline input state referencing the layout's arrays. positionsOnly describes just
+// binding 0 / location 0 for depth-only pipelines
+VkPipelineVertexInputStateCreateInfo vertex_layout_input_state(const VertexLayout *layout, bool positionsOnly);
+
+// packs count vertices into the layout's streams (one pointer per stream)
+void vertex_encode(const VertexLayout *layout, const SourceVertex *vertices, uint32_t count,
+    const vec4 positionScale, const vec4 positionOffset, void *streams[VERTEX_MAX_STREAMS]);
+
+// bounds of the positions, and the transform vertex_encode quantizes them against
+// (identity unless positions are snorm16)
+void vertex_quantization(const VertexLayout *layout, const SourceVertex *vertices, uint32_t count,
+    vec3 boundsMin, vec3 boundsMax, vec4 positionScale, vec4 positionOffset);
+
+// the meshlet radius padding covering the layout's position quantization
+float vertex_quantization_error(const VertexLayout *layout, const vec4 positionScale);
+
+uint16_t vertex_float_to_half(float value);
+int16_t vertex_float_to_snorm16(float value);
+void vertex_octahedral_encode(const vec3 normal, int16_t out[2]);
+
+// simplifies the mesh into its levels of detail and builds every level's meshlets. padding is
+// meshlet_build's
+void mesh_geometry_build(MeshGeometry *geometry, const SourceVertex *vertices, uint32_t vertexCount,
+    const uint32_t *indices, uint32_t indexCount, float padding);
+void mesh_geometry_free(MeshGeometry *geometry);
+
+// encodes straight into the staging ring and queues copies into device-local buffers,
+// indices are narrowed to 16 bits when the vertex count allows it. the levels of detail and
+// meshlets are built on the way
+void mesh_upload(Mesh *mesh, const VertexLayout *layout, const SourceVertex *vertices, uint32_t vertexCount,
+    const uint32_t *indices, uint32_t indexCount);
+void mesh_destroy(Mesh *mesh);
+
+// binds streams and index buffer, positionsOnly binds only the position stream
+void mesh_bind(VkCommandBuffer commandBuffer, const Mesh *mesh, bool positionsOnly);
+
+#endif
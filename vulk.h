@@ -0,0 +1,46 @@
+#ifndef VULK_H
+#define VULK_H
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_enum_string_helper.h>
+
+#define VK(f) { \
+    VkResult res = (f); \
+    if (res != VK_SUCCESS) { \
+        fprintf(stderr, "Fatal: %s (%d) in %s at line %d\n", \
+        string_VkResult(res), res, __FILE__, __LINE__); \
+        assert(res == VK_SUCCESS); \
+    } \
+}
+
+// shared device state, owned by main.c
+extern VkInstance vk;
+extern VkPhysicalDevice physicalDevice;
+extern VkDevice device;
+extern VkQueue graphicsQueue;
+extern int queueFamilyIdx;
+extern VkSurfaceKHR surface;
+// owned by rendering.c, VK_NULL_HANDLE with dynamic rendering
+extern VkRenderPass renderPass;
+// owned by scene.c, VK_PIPELINE_STAGE_MESH_SHADER_BIT_EXT once mesh shaders are enabled, else 0.
+// added wherever vertex shader reads are waited for
+extern VkPipelineStageFlags meshShaderStage;
+
+// presentation targets owned by swapchain.c, backed by offscreen images when headless
+extern bool headless;
+extern VkImage *swapchainImages;
+extern uint32_t swapchainImageCount;
+extern VkFormat swapChainImageFormat;
+extern VkImageUsageFlags swapchainImageUsage;
+extern VkExtent2D swapChainExtent;
+
+bool device_extension_supported(const char *name);
+// loads a SPIR-V file, fatal when it cannot be read
+VkShaderModule read_shader(const char *filename);
+
+#endif